@@ -16,28 +16,29 @@ private:
     std::set<FR> frs;
     std::map<GR, std::set<GR>> grIG;
     std::map<FR, std::set<FR>> frIG;
-    std::map<BasicBlock*, std::set<GR>> liveInI,liveOutI,defI,useI;
-    std::map<BasicBlock*, std::set<FR>> liveInF,liveOutF,defF,useF;
+    // indexed by block id
+    std::vector<std::set<GR>> liveInI,liveOutI,defI,useI;
+    std::vector<std::set<FR>> liveInF,liveOutF,defF,useF;
     std::set<GR> preColoredGR;
     std::set<FR> preColoredFR;
     std::set<GR> simplifyWorkListGR;
     std::set<FR> simplifyWorkListFR;
-    std::set<Instr*> workListMovesGR;
-    std::set<Instr*> workListMovesFR;
+    std::set<Instr*, InstrLess> workListMovesGR;
+    std::set<Instr*, InstrLess> workListMovesFR;
     std::set<GR> freezeWorkListGR;
     std::set<FR> freezeWorkListFR;
     std::set<GR> spillWorkListGR;
     std::set<FR> spillWorkListFR;
-    std::map<GR, std::set<Instr*>> moveListGR;
-    std::map<FR, std::set<Instr*>> moveListFR;
-    std::set<Instr*> activeMovesGR;
-    std::set<Instr*> activeMovesFR;
-    std::set<Instr*> coalescedMovesGR;
-    std::set<Instr*> coalescedMovesFR;
-    std::set<Instr*> constrainedMovesGR;
-    std::set<Instr*> constrainedMovesFR;
-    std::set<Instr*> frozenMovesGR;
-    std::set<Instr*> frozenMovesFR;
+    std::map<GR, std::set<Instr*, InstrLess>> moveListGR;
+    std::map<FR, std::set<Instr*, InstrLess>> moveListFR;
+    std::set<Instr*, InstrLess> activeMovesGR;
+    std::set<Instr*, InstrLess> activeMovesFR;
+    std::set<Instr*, InstrLess> coalescedMovesGR;
+    std::set<Instr*, InstrLess> coalescedMovesFR;
+    std::set<Instr*, InstrLess> constrainedMovesGR;
+    std::set<Instr*, InstrLess> constrainedMovesFR;
+    std::set<Instr*, InstrLess> frozenMovesGR;
+    std::set<Instr*, InstrLess> frozenMovesFR;
     std::set<std::pair<GR,GR>> adjSetGR;
     std::set<std::pair<FR,FR>> adjSetFR;
     std::map<GR, std::set<GR>> adjListGR;
@@ -59,6 +60,9 @@ private:
     int spillCount = 0;
     std::map<GR, int> spillMappingGR;
     std::map<FR, int> spillMappingFR;
+    // temps created by spill rewriting live only around one instruction; spilling them again never helps
+    std::set<GR> spillTempsGR;
+    std::set<FR> spillTempsFR;
 public:
     ColoringAlloc(Function* function):function(function){}
     int run();
@@ -69,8 +73,8 @@ public:
     void makeWorkList();
     bool moveRelatedGR(GR gr);
     bool moveRelatedFR(FR fr);
-    std::set<Instr*> nodeMovesGR(GR gr);
-    std::set<Instr*> nodeMovesFR(FR fr);
+    std::set<Instr*, InstrLess> nodeMovesGR(GR gr);
+    std::set<Instr*, InstrLess> nodeMovesFR(FR fr);
     std::set<GR> adjacentGR(GR gr);
     std::set<FR> adjacentFR(FR fr);
     void decrementDegreeGR(GR gr);
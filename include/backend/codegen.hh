@@ -21,9 +21,8 @@ private:
     std::map<Value *, FR> fRegMapping;
     std::map<Value*, int> stackMapping;
     std::map<Value*, int> globalMapping;
-    std::map<BasicBlock*, std::map<int, GR>> constantIntMapping;
-    std::map<BasicBlock*, std::map<float, FR>> constantFloatMapping;
-    std::map<BasicBlock*, std::map<std::string, GR>> symbolMapping;
+    // per block of the function being translated, indexed by block id
+    std::vector<std::map<int, GR>> constantIntMapping;
     std::string asm_code;
     std::ostream& out;
     int translateFunction(Function* function);
@@ -36,6 +35,9 @@ private:
     void generateFloatConst();
     void generateMemset();
     GR getConstantGR(int x, BasicBlock* block, std::vector<Instr*>& vec);
+    // signed division by a constant without sdiv; d must not be 0 or INT_MIN
+    void divByConst(GR dst, GR src, int d, BasicBlock* block, std::vector<Instr*>& vec, bool nonNegative = false);
+    static void signedMagic(int d, int& magic, int& shift);
 public:
     Codegen(IrVisitor &irVisitor, std::ostream& out) : irVisitor(irVisitor),out(out) {}
     void generateProgramCode();
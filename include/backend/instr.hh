@@ -17,20 +17,30 @@ enum COND {
 };
 class Instr {
 public:
+    // creation order, keeps sets of instructions independent of heap addresses
+    const int seq = newSeq();
     virtual void print(std::ostream& out) = 0;
     virtual std::vector<GR> getUseG() = 0;
     virtual std::vector<FR> getUseF() = 0;
     virtual std::vector<GR> getDefG() = 0;
     virtual std::vector<FR> getDefF() = 0;
     virtual void replace(std::map<GR, int> grMapping, std::map<FR, int> frMapping) = 0;
-    virtual void replaceBBName(std::map<std::string, std::string> mapping) {}
+    virtual void replaceBBName(const std::map<std::string, std::string>& mapping) {}
     virtual void setNewGR(GR old_gr, GR new_gr, bool use) {}
     virtual void setNewFR(FR old_fr, FR new_fr, bool use) {}
+private:
+    static int newSeq() {
+        static int cnt = 0;
+        return cnt++;
+    }
+};
+struct InstrLess {
+    bool operator()(Instr* lhs, Instr* rhs) const { return lhs->seq < rhs->seq; }
 };
 class GRegRegInstr: public Instr {
 public:
     enum Type {Add,Sub,Mul,Div,RSUB} op;
-    enum Shift {Nothing,LSL,LSR} shift = Nothing;
+    enum Shift {Nothing,LSL,LSR,ASR} shift = Nothing;
     int shiftNum;
     GR dst, src1, src2;
     GRegRegInstr(Type op,GR dst, GR src1,GR src2): dst(dst),src1(src1),src2(src2),op(op){}
@@ -74,6 +84,8 @@ public:
             out << ",LSL #" << shiftNum;
         } else if (shift == LSR){
             out << ",LSR #" << shiftNum;
+        } else if (shift == ASR){
+            out << ",ASR #" << shiftNum;
         }
         out << "\n";
     }
@@ -92,7 +104,7 @@ public:
 };
 class LSImmInstr: public Instr {
 public:
-    enum Type {LSL,LSR} op;
+    enum Type {LSL,LSR,ASR} op;
     int shiftNum;
     GR dst, src;
     LSImmInstr(Type op,GR dst, GR src,int shiftNum): dst(dst),src(src),op(op),shiftNum(shiftNum){}
@@ -115,6 +127,9 @@ public:
             case LSR:
                 out << "lsr ";
                 break;
+            case ASR:
+                out << "asr ";
+                break;
             default:
                 out << "wrongInstr ";
                 break;
@@ -184,7 +199,7 @@ public:
 };
 class GRegImmInstr: public Instr{
 public:
-    enum Type {Add,Sub,RSUB} op;
+    enum Type {Add,Sub,RSUB,And} op;
     GR dst, src1;
     int src2;
     COND cond = NOTHING;
@@ -212,6 +227,9 @@ public:
             case RSUB:
                 out << "rsb";
                 break;
+            case And:
+                out << "and";
+                break;
         }
         switch (cond) {
             case LT:
@@ -432,7 +450,8 @@ public:
         dst = GR(grMapping[dst]);
     }
     void setNewGR(GR old_gr, GR new_gr, bool use) {
-        if (!use) {
+        // a conditional mov also reads dst
+        if (!use || cond != NOTHING) {
             if (dst == old_gr) dst = new_gr;
         }
     }
@@ -740,6 +759,79 @@ public:
         return {};
     }
 };
+class MLS: public Instr{
+public:
+    GR dst;
+    GR mul1,mul2;
+    GR sub;
+    MLS(GR dst,GR mul1,GR mul2,GR sub): dst(dst),mul1(mul1),mul2(mul2),sub(sub){}
+    void replace(std::map<GR, int> grMapping, std::map<FR, int> frMapping) {
+        dst = GR(grMapping[dst]);
+        mul1 = GR(grMapping[mul1]);
+        mul2 = GR(grMapping[mul2]);
+        sub = GR(grMapping[sub]);
+    }
+    void setNewGR(GR old_gr, GR new_gr, bool use) {
+        if (use) {
+            if (mul1 == old_gr) mul1 = new_gr;
+            if (mul2 == old_gr) mul2 = new_gr;
+            if (sub == old_gr) sub = new_gr;
+        } else {
+            if (dst == old_gr) dst = new_gr;
+        }
+    }
+    // dst = sub - mul1 * mul2
+    void print(std::ostream& out) override final{
+        out << "mls " << dst.getName() << "," << mul1.getName() << "," << mul2.getName() << "," << sub.getName() << "\n";
+    }
+    std::vector<GR> getUseG() override final{
+        return {mul1,mul2,sub};
+    }
+    std::vector<FR> getUseF() override final{
+        return {};
+    }
+    std::vector<GR> getDefG() override final{
+        return {dst};
+    }
+    std::vector<FR> getDefF() override final{
+        return {};
+    }
+};
+class SMMUL: public Instr{
+public:
+    GR dst;
+    GR src1,src2;
+    SMMUL(GR dst,GR src1,GR src2): dst(dst),src1(src1),src2(src2){}
+    void replace(std::map<GR, int> grMapping, std::map<FR, int> frMapping) {
+        dst = GR(grMapping[dst]);
+        src1 = GR(grMapping[src1]);
+        src2 = GR(grMapping[src2]);
+    }
+    void setNewGR(GR old_gr, GR new_gr, bool use) {
+        if (use) {
+            if (src1 == old_gr) src1 = new_gr;
+            if (src2 == old_gr) src2 = new_gr;
+        } else {
+            if (dst == old_gr) dst = new_gr;
+        }
+    }
+    // high 32 bits of the signed 64-bit product
+    void print(std::ostream& out) override final{
+        out << "smmul " << dst.getName() << "," << src1.getName() << "," << src2.getName() << "\n";
+    }
+    std::vector<GR> getUseG() override final{
+        return {src1,src2};
+    }
+    std::vector<FR> getUseF() override final{
+        return {};
+    }
+    std::vector<GR> getDefG() override final{
+        return {dst};
+    }
+    std::vector<FR> getDefF() override final{
+        return {};
+    }
+};
 class VcvtSF: public Instr{
 public:
     FR dst;
@@ -922,8 +1014,9 @@ public:
     COND cond = NOTHING;
     B(std::string target):target(target){}
     void replace(std::map<GR, int> grMapping, std::map<FR, int> frMapping) {}
-    virtual void replaceBBName(std::map<std::string, std::string> mapping) override{
-        target = mapping[target];
+    virtual void replaceBBName(const std::map<std::string, std::string>& mapping) override{
+        auto it = mapping.find(target);
+        target = it == mapping.end() ? "" : it->second;
     }
     B(std::string target,COND cond):target(target),cond(cond){}
     void print(std::ostream& out) override final{
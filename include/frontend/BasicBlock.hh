@@ -8,6 +8,7 @@
 #include "Instruction.hh"
 #include <list>
 #include <set>
+#include <algorithm>
 #include "instr.hh"
 class BasicBlock{
 public:
@@ -17,7 +18,7 @@ public:
     std::string name;
     std::set<Value*> originVals;
 
-    BasicBlock(std::string name):name(name){}
+    BasicBlock(std::string name):parent(nullptr),name(name){}
     BasicBlock(BasicBlock* parent,std::string func_name,int cnt) {
         this->parent = parent;
         name = func_name + "::BB" +  std::to_string(cnt);
@@ -32,25 +33,88 @@ public:
         vars.push_back(v);
     }
     void insertDomFrontier(BasicBlock* bb) {
-        domFrontier.insert(bb);
+        if (std::find(domFrontier.begin(), domFrontier.end(), bb) == domFrontier.end()) {
+            domFrontier.push_back(bb);
+        }
     }
-    std::set<BasicBlock*> getDomFrontier() {
+    std::vector<BasicBlock*>& getDomFrontier() {
         return domFrontier;
     }
+    // dense index inside the owning function, see Function::renumberBB
+    int getId() { return id; }
+    void setId(int id) { this->id = id; }
 
     virtual void print(std::ostream& out) = 0;
     virtual void clear() = 0;
     virtual ~BasicBlock(){}
     void pushPre(BasicBlock* nb){preBBs.push_back(nb);}
     void pushSucc(BasicBlock* nb){succBBs.push_back(nb);}
-    void setPre(std::vector<BasicBlock*> pre){preBBs = pre;}
-    void setSucc(std::vector<BasicBlock*> succ){succBBs = succ;}
-    std::vector<BasicBlock*> getPre(){return preBBs;}
-    std::vector<BasicBlock*> getSucc(){return succBBs;}
+    // CFG edits keep both edge lists in sync; terminators and phis are updated separately
+    void addSucc(BasicBlock* bb) {
+        if (std::find(succBBs.begin(), succBBs.end(), bb) != succBBs.end()) return;
+        succBBs.push_back(bb);
+        bb->preBBs.push_back(this);
+    }
+    void removeSucc(BasicBlock* bb) {
+        auto it = std::find(succBBs.begin(), succBBs.end(), bb);
+        if (it == succBBs.end()) return;
+        succBBs.erase(it);
+        bb->preBBs.erase(std::find(bb->preBBs.begin(), bb->preBBs.end(), this));
+    }
+    // this->oldBB becomes this->newBB, keeping the position in both lists
+    void replaceSucc(BasicBlock* oldBB, BasicBlock* newBB) {
+        *std::find(succBBs.begin(), succBBs.end(), oldBB) = newBB;
+        oldBB->preBBs.erase(std::find(oldBB->preBBs.begin(), oldBB->preBBs.end(), this));
+        newBB->preBBs.push_back(this);
+    }
+    void replaceTarget(BasicBlock* oldBB, BasicBlock* newBB) {
+        if (ir.empty()) return;
+        if (typeid(*ir.back()) == typeid(JumpIR)) {
+            JumpIR* jumpIr = dynamic_cast<JumpIR*>(ir.back());
+            if (jumpIr->target == oldBB) jumpIr->target = newBB;
+        } else if (typeid(*ir.back()) == typeid(BranchIR)) {
+            BranchIR* branchIr = dynamic_cast<BranchIR*>(ir.back());
+            if (branchIr->trueTarget == oldBB) branchIr->trueTarget = newBB;
+            if (branchIr->falseTarget == oldBB) branchIr->falseTarget = newBB;
+        }
+    }
+    void replacePhiPre(BasicBlock* oldPre, BasicBlock* newPre) {
+        for (Instruction* instruction : ir) {
+            if (typeid(*instruction) != typeid(PhiIR)) break;
+            auto& params = dynamic_cast<PhiIR*>(instruction)->params;
+            auto it = params.find(oldPre);
+            if (it == params.end()) continue;
+            Value* v = it->second;
+            params.erase(it);
+            params[newPre] = v;
+        }
+    }
+    void setPre(const std::vector<BasicBlock*>& pre){preBBs = pre;}
+    void setSucc(const std::vector<BasicBlock*>& succ){succBBs = succ;}
+    std::vector<BasicBlock*>& getPre(){return preBBs;}
+    std::vector<BasicBlock*>& getSucc(){return succBBs;}
     void setIdom(BasicBlock* idom) { this->idom = idom; }
     BasicBlock* getIdom() { return idom; }
     void pushDomTreeSuccNode(BasicBlock* bb) { this->domTreeSuccNode.push_back(bb); }
-    std::vector<BasicBlock*> getDomTreeSuccNode() { return domTreeSuccNode; }
+    std::vector<BasicBlock*>& getDomTreeSuccNode() { return domTreeSuccNode; }
+    // dominator tree preorder/postorder numbers and depth, -1 when unreachable from the entry
+    void setDomNum(int in, int out, int level = -1) { domIn = in; domOut = out; domLevel = level; }
+    int getDomIn() { return domIn; }
+    int getDomLevel() { return domLevel; }
+    bool dominates(BasicBlock* bb) { return domIn >= 0 && bb->domIn >= domIn && bb->domOut <= domOut; }
+    // post dominator tree; postIdom is nullptr when the immediate post dominator is the virtual exit
+    void setPostIdom(BasicBlock* pidom) { this->postIdom = pidom; }
+    BasicBlock* getPostIdom() { return postIdom; }
+    void pushPostDomTreeSuccNode(BasicBlock* bb) { postDomTreeSuccNode.push_back(bb); }
+    std::vector<BasicBlock*>& getPostDomTreeSuccNode() { return postDomTreeSuccNode; }
+    void insertPostDomFrontier(BasicBlock* bb) {
+        if (std::find(postDomFrontier.begin(), postDomFrontier.end(), bb) == postDomFrontier.end()) {
+            postDomFrontier.push_back(bb);
+        }
+    }
+    std::vector<BasicBlock*>& getPostDomFrontier() { return postDomFrontier; }
+    void setPostDomNum(int in, int out) { postDomIn = in; postDomOut = out; }
+    bool postDominates(BasicBlock* bb) { return postDomIn >= 0 && bb->postDomIn >= postDomIn && bb->postDomOut <= postDomOut; }
 
     //add for codegen
     void pushInstr(Instr* instr) {instrs.push_back(instr);}
@@ -59,9 +123,15 @@ private:
     std::vector<BasicBlock*> preBBs;
     std::vector<BasicBlock*> succBBs;
     std::vector<Instr*> instrs;
-    std::set<BasicBlock*> domFrontier;
+    std::vector<BasicBlock*> domFrontier;
     BasicBlock* idom = nullptr;
+    int id = -1;
     std::vector<BasicBlock*> domTreeSuccNode;
+    int domIn = -1, domOut = -1, domLevel = -1;
+    BasicBlock* postIdom = nullptr;
+    std::vector<BasicBlock*> postDomTreeSuccNode;
+    std::vector<BasicBlock*> postDomFrontier;
+    int postDomIn = -1, postDomOut = -1;
 };
 class NormalBlock:public BasicBlock{
 public:
@@ -33,9 +33,44 @@ public:
     void pushBB(BasicBlock* basicBlock) {
         basicBlocks.push_back(basicBlock);
     }
-    std::vector<BasicBlock*> getBB() {
+    std::vector<BasicBlock*>& getBB() {
         return basicBlocks;
     }
+    // block id == position in basicBlocks, side tables are indexed by it
+    void renumberBB() {
+        for (size_t i = 0; i < basicBlocks.size(); ++i) {
+            basicBlocks[i]->setId(i);
+        }
+    }
+    // recompute pre/succ from the terminators; a block without one falls through to the next block
+    void rebuildCFG() {
+        renumberBB();
+        for (BasicBlock* bb : basicBlocks) {
+            bb->getPre().clear();
+            bb->getSucc().clear();
+        }
+        auto link = [](BasicBlock* from, BasicBlock* to) {
+            if (!to) return;
+            std::vector<BasicBlock*>& succ = from->getSucc();
+            if (std::find(succ.begin(), succ.end(), to) != succ.end()) return;
+            succ.push_back(to);
+            to->getPre().push_back(from);
+        };
+        for (size_t i = 0; i < basicBlocks.size(); ++i) {
+            BasicBlock* bb = basicBlocks[i];
+            Instruction* last = bb->ir.empty() ? nullptr : bb->ir.back();
+            if (last && typeid(*last) == typeid(JumpIR)) {
+                link(bb, dynamic_cast<JumpIR*>(last)->target);
+            } else if (last && typeid(*last) == typeid(BranchIR)) {
+                link(bb, dynamic_cast<BranchIR*>(last)->trueTarget);
+                link(bb, dynamic_cast<BranchIR*>(last)->falseTarget);
+            } else if (last && typeid(*last) == typeid(ReturnIR)) {
+                continue;
+            } else if (i + 1 < basicBlocks.size()) {
+                link(bb, basicBlocks[i + 1]);
+            }
+        }
+    }
     bool isArgs(std::string name) {
         for (size_t i = 0; i < params.size(); ++i) {
             if (params[i]->getName() == name) return true;
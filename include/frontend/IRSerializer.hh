@@ -0,0 +1,90 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_IRSERIALIZER_HH
+#define SYSY2022_BJTU_IRSERIALIZER_HH
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <stdexcept>
+#include "IrVisitor.hh"
+
+class IRFormatError : public std::runtime_error{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Binary image of the whole module (globals, .entry block, functions).
+// Layout: magic, version, flags, string table, type table, value table, body.
+// Values, types and strings are referenced by dense ids; all integers are LEB128 varints.
+class IRSerializer{
+public:
+    static const uint32_t MAGIC = 0x52495953;   // "SYIR"
+    // bump on every layout change:
+    //  2: alloca flag bit 1 and the zeroBegin/zeroEnd memset range
+    //  3: OPC_SHL
+    //  4: instruction flag bit 1 (nonNegative dividend)
+    static const uint32_t VERSION = 4;
+    // flags
+    static const uint32_t OPTIMIZED = 1;        // middle end already ran, go straight to codegen
+
+    IRSerializer(IrVisitor& irVisitor):irVisitor(irVisitor){}
+    void write(std::ostream& out, uint32_t flags = 0);
+    // replaces the module held by irVisitor, returns the flags of the image
+    uint32_t read(std::istream& in);
+    size_t getByteSize() {return byteSize;}
+    size_t getValueCnt() {return values.size();}
+    size_t getIrCnt() {return irCnt;}
+private:
+    IrVisitor& irVisitor;
+    size_t byteSize = 0;
+    size_t irCnt = 0;
+
+    // write side
+    std::vector<Value*> values;
+    std::unordered_map<Value*, uint32_t> valueIds;
+    std::vector<Type*> types;
+    std::unordered_map<Type*, uint32_t> typeIds;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> stringIds;
+    std::unordered_map<BasicBlock*, uint32_t> blockIds;
+    std::unordered_map<std::string, uint32_t> blockNameIds;
+    std::unordered_map<Function*, uint32_t> funcIds;
+
+    uint32_t getValueId(Value* v);
+    uint32_t getTypeId(Type* t);
+    uint32_t getStringId(const std::string& s);
+    uint32_t getBlockId(BasicBlock* bb);
+    void writeTempVal(std::string& buf, TempVal& t);
+    void writeValue(std::string& buf, Value* v);
+    void writeBlock(std::string& buf, BasicBlock* bb);
+    void writeInstruction(std::string& buf, Instruction* ir);
+
+    // read side
+    const uint8_t* cur = nullptr;
+    const uint8_t* end = nullptr;
+    std::vector<Value*> loadedValues;
+    std::vector<Type*> loadedTypes;
+    std::vector<std::string> loadedStrings;
+    std::vector<BasicBlock*> loadedBlocks;
+    std::vector<Function*> loadedFuncs;
+
+    uint32_t readVarint();
+    int32_t readSVarint();
+    float readFloat();
+    uint8_t readByte();
+    uint32_t readCount();
+    // readOptValueRef accepts id 0 (nullptr), the other ref readers reject it
+    Value* readOptValueRef();
+    Value* readValueRef();
+    Type* readTypeRef();
+    const std::string& readStringRef();
+    BasicBlock* readBlockRef();
+    TempVal readTempVal();
+    void readValues();
+    void readBlock(BasicBlock* bb);
+    Instruction* readInstruction();
+};
+#endif //SYSY2022_BJTU_IRSERIALIZER_HH
@@ -26,13 +26,26 @@ class MoveIR : public Instruction {
 public:
     Value* dst;
     Value* src;
-    MoveIR(Value* dst,Value* src):dst(dst),src(src){};
-    void print(std::ostream& out) override final{};
+    MoveIR(Value* dst,Value* src):dst(dst),src(src){
+        Use* use1 = new Use(dst, this, 0);
+        Use* use2 = new Use(src, this, 1);
+        this->Operands.push_back(use1);
+        this->Operands.push_back(use2);
+    };
+    void print(std::ostream& out) override final{
+        dst->print(out);
+        out << " = Move ";
+        src->print(out);
+        out << std::endl;
+    };
 };
 class AllocIR: public Instruction {
 public:
     bool isArray = false;
     int arrayLen = 1;
+    // elements [zeroBegin, zeroEnd) are cleared by memset, zeroEnd < 0 means the whole array
+    int zeroBegin = 0;
+    int zeroEnd = -1;
     Value* v;
     AllocIR(Value* v):v(v){
         Use* use = new Use(v, this, 0);
@@ -46,6 +59,12 @@ public:
         // v->addUse(use);
         this->Operands.push_back(use);
     }
+    int getZeroEnd() { return zeroEnd < 0 ? arrayLen : zeroEnd; }
+    bool zeroesAll() { return zeroBegin == 0 && getZeroEnd() == arrayLen; }
+    void printZeroRange(std::ostream& out) {
+        if(isArray && !zeroesAll())
+            out << " zero[" << zeroBegin << "," << getZeroEnd() << ")";
+    }
     virtual void print(std::ostream& out) = 0;
 };
 class AllocIIR:public AllocIR{
@@ -57,6 +76,7 @@ public:
         out << " = AllocaI";
         if(isArray)
             out << "(" << arrayLen << ")";
+        printZeroRange(out);
         out << std::endl;
     }
 };
@@ -69,6 +89,7 @@ public:
         out << " = AllocaF";
         if(isArray)
             out << "(" << arrayLen << ")";
+        printZeroRange(out);
         out << std::endl;
     }
 };
@@ -203,6 +224,8 @@ public:
     TempVal left;
     TempVal right;
     std::string op;
+    // left is known to be >= 0 (set by range analysis for DivIIR and ModIR)
+    bool nonNegative = false;
     virtual ~ArithmeticIR(){}
     virtual void print(std::ostream& out) = 0;
     ArithmeticIR(TempVal res,TempVal left,TempVal right): res(res),left(left),right(right) {
@@ -370,6 +393,19 @@ public:
         out << std::endl;
     }
 };
+// left << right, only created by the optimizer with a constant shift amount in [0, 31]
+class ShlIR:public ArithmeticIR{
+public:
+    ShlIR(TempVal res,TempVal left,TempVal right) : ArithmeticIR(res,left,right){ this->op = "<<"; }
+    void print(std::ostream& out) override final{
+        res.print(out);
+        out << " = Shl ";
+        left.print(out);
+        out << " ";
+        right.print(out);
+        out << std::endl;
+    }
+};
 class UnaryIR:public Instruction{
 public:
     TempVal res;
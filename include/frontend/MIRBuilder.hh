@@ -33,8 +33,8 @@ public:
     NormalBlock* getCondToNormal(CondBlock* cb);
     void putCondToNormal(CondBlock* cb, NormalBlock* nb);
     void removeDuplicate();
+    void resolveTargets(Function* function);
 private:
     IrVisitor irVisitor;
     std::map<CondBlock*, NormalBlock*> condToNormal;
-    std::map<CondBlock*, std::vector<NormalBlock*>> reversedSucc;
 };
\ No newline at end of file
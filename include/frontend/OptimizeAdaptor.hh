@@ -19,7 +19,12 @@ void moveBackOperand(IrVisitor* iv) {
     for(auto func : iv->getFunctions()) {
         for(auto bb : func->getBB()) {
             for(auto ir : bb->getIr()) {
-                if(dynamic_cast<AllocIR*>(ir)) {
+                if(dynamic_cast<MoveIR*>(ir)) {
+                    MoveIR* moveIr = dynamic_cast<MoveIR*>(ir);
+                    moveIr->dst = moveIr->getOperands()[0]->getVal();
+                    moveIr->src = moveIr->getOperands()[1]->getVal();
+                }
+                else if(dynamic_cast<AllocIR*>(ir)) {
                     AllocIR* allocIr = dynamic_cast<AllocIR*>(ir);
                     allocIr->v = allocIr->getOperands()[0]->getVal();
                 }
@@ -0,0 +1,375 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_ADCE_HH
+#define SYSY2022_BJTU_ADCE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "LoopInfo.hh"
+#include "AliasAnalysis.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <climits>
+
+// 基于控制依赖的激进死代码删除
+// 根: ret、调用、写到可能被读的内存的 store; 其余指令先假定为死, 从根出发标记
+// 活指令的操作数定值为活; 活指令所在块的后支配边界(控制依赖)上的分支为活; 活 phi 的前驱跳转为活
+// 写到从未被读的局部数组(未传出且没有 load 按别名分析落在它上面)的 store 不作为根
+// 不能证明有限的循环, 退出块的分支作为根, 死循环不会被删成直接退出
+// 死分支改为跳到直接后支配者, 中间的块变得不可达后删除; 最后绕过只剩跳转的空块
+class ADCE {
+private:
+    IrVisitor* irVisitor;
+    Function* function;
+    DominateTree dominateTree;
+    LoopInfo loopInfo;
+    AliasAnalysis aliasAnalysis;
+    std::unordered_set<Instruction*> live;
+    std::vector<bool> bbLive;
+    // 按块 id 索引, 可能不终止的循环的退出块
+    std::vector<bool> loopExiting;
+    std::vector<std::pair<Instruction*, BasicBlock*>> work;
+    // 按值的 num 索引的定值指令, 使用时按指针过滤
+    std::vector<std::vector<std::pair<Instruction*, BasicBlock*>>> defs;
+    // 被 load 读过的局部数组
+    std::unordered_set<Value*> loadedAllocs;
+    std::vector<Use*> uses;
+
+    int removedCnt = 0;
+    int branchCnt = 0;
+    int removedBBCnt = 0;
+
+    void init();
+    void markLoops();
+    bool isFinite(Loop* loop);
+    int getStep(Loop* loop, Value* val, std::unordered_map<Value*, Instruction*>& loopDefs);
+    void markLive(Instruction* ir, BasicBlock* bb);
+    void markBlock(BasicBlock* bb);
+    void markVal(Value* val);
+    void markTerminator(BasicBlock* bb);
+    bool isRoot(Instruction* ir, BasicBlock* bb);
+    bool sweep();
+    bool removeEmptyBB();
+public:
+    ADCE(IrVisitor* irVisitor) : irVisitor(irVisitor), dominateTree(irVisitor), aliasAnalysis(irVisitor) {;}
+    void execute();
+    int getRemovedCnt() { return removedCnt; }
+    int getBranchCnt() { return branchCnt; }
+    int getRemovedBBCnt() { return removedBBCnt; }
+};
+
+inline void ADCE::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        markLoops();
+        dominateTree.getPostIdom(func);
+        dominateTree.getPostDomFront(func);
+        init();
+
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(!ir->isDeleted() && isRoot(ir, bb)) markLive(ir, bb);
+            }
+        }
+        while(!work.empty()) {
+            Instruction* ir = work.back().first;
+            BasicBlock* bb = work.back().second;
+            work.pop_back();
+            if(typeid(*ir) == typeid(PhiIR)) {
+                auto& params = dynamic_cast<PhiIR*>(ir)->params;
+                for(BasicBlock* preBB : bb->getPre()) {
+                    auto it = params.find(preBB);
+                    if(it == params.end()) continue;
+                    TempVal* t = dynamic_cast<TempVal*>(it->second);
+                    markVal(t ? t->getVal() : it->second);
+                    markTerminator(preBB);
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                markVal(getUseVal(use));
+            }
+        }
+
+        size_t bbCnt = func->getBB().size();
+        bool changed = sweep();
+        if(removeUnreachableBB(func)) {
+            removedBBCnt += bbCnt - func->getBB().size();
+            changed = true;
+        }
+        changed = removeEmptyBB() || changed;
+        if(changed) {
+            dominateTree.getIdom(func);
+            dominateTree.getDomFront(func);
+            dominateTree.genDominateTree(func);
+        }
+    }
+}
+
+// 建立定值表, 记录 load 读到的局部数组; 传出的局部数组由别名分析统计
+inline void ADCE::init() {
+    live.clear();
+    work.clear();
+    bbLive.assign(function->getBB().size(), false);
+    defs.assign(function->varCnt, {});
+    loadedAllocs.clear();
+    aliasAnalysis.analyze(function);
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            Value* dst = getDefVal(ir);
+            if(dst && dst->getNum() >= 0 && dst->getNum() < (int) defs.size()) {
+                defs[dst->getNum()].push_back({ir, bb});
+            }
+            if(typeid(*ir) == typeid(LoadIIR) || typeid(*ir) == typeid(LoadFIR)) {
+                Value* root = aliasAnalysis.getLocation(getUseVal(ir->getOperands()[1])).root;
+                if(aliasAnalysis.isLocal(root)) loadedAllocs.insert(root);
+            }
+        }
+    }
+}
+
+inline bool ADCE::isRoot(Instruction* ir, BasicBlock* bb) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(ReturnIR) || t == typeid(CallIR)) return true;
+    if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+        Value* root = aliasAnalysis.getLocation(getUseVal(ir->getOperands()[0])).root;
+        return !aliasAnalysis.isLocal(root) || aliasAnalysis.isEscaped(root) || loadedAllocs.count(root);
+    }
+    // 走不到出口的块(死循环)和可能不终止的循环的退出块保留分支
+    return t == typeid(BranchIR) && (!bb->getPostIdom() || loopExiting[bb->getId()]);
+}
+
+inline void ADCE::markLoops() {
+    loopInfo.analyze(function);
+    loopExiting.assign(function->getBB().size(), false);
+    for(Loop* loop : loopInfo.getLoops()) {
+        if(isFinite(loop)) continue;
+        for(BasicBlock* bb : loop->exitings) {
+            loopExiting[bb->getId()] = true;
+        }
+    }
+}
+
+// 有限的循环: 某个支配所有回边的退出块按 i op n 退出, op 为 <、<=、>、>=
+// i 是首块 phi 或它加常数的结果, 每轮加同一个常数且朝退出的方向变化, n 是常数或在循环外定值
+// 有符号溢出是未定义行为, 不考虑回绕
+inline bool ADCE::isFinite(Loop* loop) {
+    std::unordered_map<Value*, Instruction*> loopDefs;
+    for(BasicBlock* bb : loop->bbs) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            Value* dst = getDefVal(ir);
+            if(dst) loopDefs[dst] = ir;
+        }
+    }
+    for(BasicBlock* bb : loop->exitings) {
+        bool dominatesLatches = true;
+        for(BasicBlock* latch : loop->latches) {
+            dominatesLatches = dominatesLatches && bb->dominates(latch);
+        }
+        auto& irs = bb->getIr();
+        if(!dominatesLatches || irs.empty() || irs.back()->isDeleted() || typeid(*irs.back()) != typeid(BranchIR)) continue;
+        BranchIR* branchIr = dynamic_cast<BranchIR*>(irs.back());
+        bool stayTrue = loop->contains(branchIr->trueTarget);
+        if(stayTrue == loop->contains(branchIr->falseTarget)) continue;
+        auto condIt = loopDefs.find(getUseVal(branchIr->getOperands()[1]));
+        if(condIt == loopDefs.end()) continue;
+        Instruction* cmp = condIt->second;
+        const std::type_info& t = typeid(*cmp);
+        if(t != typeid(LTIIR) && t != typeid(LEIIR) && t != typeid(GTIIR) && t != typeid(GEIIR)) continue;
+        for(int side(0); side < 2; side++) {
+            TempVal* iv = dynamic_cast<TempVal*>(cmp->getOperands()[1 + side]->getVal());
+            TempVal* bound = dynamic_cast<TempVal*>(cmp->getOperands()[2 - side]->getVal());
+            if(!iv || !bound || !iv->getVal() || (bound->getVal() && loopDefs.count(bound->getVal()))) continue;
+            int step = getStep(loop, iv->getVal(), loopDefs);
+            if(step == 0) continue;
+            // 留在循环内的条件归一化为 i < n 或 i > n 的方向
+            bool less = (t == typeid(LTIIR) || t == typeid(LEIIR)) != (side == 1);
+            if(!stayTrue) less = !less;
+            if(less == (step > 0)) return true;
+        }
+    }
+    return false;
+}
+
+// val 为首块 phi 或 phi 加常数时返回 phi 每轮的步长, 不是归纳变量返回 0
+inline int ADCE::getStep(Loop* loop, Value* val, std::unordered_map<Value*, Instruction*>& loopDefs) {
+    // i + c 或 i - c 中的 i 和 c
+    auto matchInc = [&](Instruction* ir, Value*& base, int& c) {
+        const std::type_info& t = typeid(*ir);
+        if(t != typeid(AddIIR) && t != typeid(SubIIR)) return false;
+        TempVal* a = dynamic_cast<TempVal*>(ir->getOperands()[1]->getVal());
+        TempVal* b = dynamic_cast<TempVal*>(ir->getOperands()[2]->getVal());
+        if(!a || !b) return false;
+        if(t == typeid(AddIIR) && !a->getVal()) std::swap(a, b);
+        if(!a->getVal() || b->getVal() || b->getType()->isFloat()) return false;
+        if(t == typeid(SubIIR) && b->getInt() == INT_MIN) return false;
+        base = a->getVal();
+        c = t == typeid(SubIIR) ? -b->getInt() : b->getInt();
+        return true;
+    };
+    auto it = loopDefs.find(val);
+    if(it == loopDefs.end()) return 0;
+    Instruction* def = it->second;
+    if(typeid(*def) != typeid(PhiIR)) {
+        Value* base;
+        int c;
+        if(!matchInc(def, base, c)) return 0;
+        it = loopDefs.find(base);
+        if(it == loopDefs.end()) return 0;
+        def = it->second;
+    }
+    if(typeid(*def) != typeid(PhiIR)) return 0;
+    bool inHeader = false;
+    for(auto ir : loop->header->getIr()) {
+        inHeader = inHeader || ir == def;
+    }
+    if(!inHeader) return 0;
+    PhiIR* phi = dynamic_cast<PhiIR*>(def);
+    int step = 0;
+    for(BasicBlock* latch : loop->latches) {
+        auto paramIt = phi->params.find(latch);
+        if(paramIt == phi->params.end()) return 0;
+        TempVal* next = dynamic_cast<TempVal*>(paramIt->second);
+        if(!next || !next->getVal() || !loopDefs.count(next->getVal())) return 0;
+        Value* base;
+        int c;
+        if(!matchInc(loopDefs[next->getVal()], base, c) || base != getDefVal(phi) || c == 0) return 0;
+        if(step != 0 && step != c) return 0;
+        step = c;
+    }
+    return step;
+}
+
+inline void ADCE::markLive(Instruction* ir, BasicBlock* bb) {
+    if(!live.insert(ir).second) return;
+    work.push_back({ir, bb});
+    markBlock(bb);
+}
+
+// 块中有活指令时, 它控制依赖的分支为活
+inline void ADCE::markBlock(BasicBlock* bb) {
+    if(bbLive[bb->getId()]) return;
+    bbLive[bb->getId()] = true;
+    for(BasicBlock* cdBB : bb->getPostDomFrontier()) {
+        markTerminator(cdBB);
+    }
+}
+
+inline void ADCE::markTerminator(BasicBlock* bb) {
+    markBlock(bb);
+    auto& irs = bb->getIr();
+    if(!irs.empty() && typeid(*irs.back()) == typeid(BranchIR)) markLive(irs.back(), bb);
+}
+
+inline void ADCE::markVal(Value* val) {
+    if(!val || val->getNum() < 0 || val->getNum() >= (int) defs.size()) return;
+    for(auto& def : defs[val->getNum()]) {
+        if(getDefVal(def.first) == val) markLive(def.first, def.second);
+    }
+}
+
+// 删除死指令, 死分支改为跳到直接后支配者; 返回 CFG 是否改变
+inline bool ADCE::sweep() {
+    bool cfgChanged = false;
+    for(BasicBlock* bb : function->getBB()) {
+        auto& irs = bb->getIr();
+        for(auto ir : irs) {
+            if(ir->isDeleted() || live.count(ir) || typeid(*ir) == typeid(JumpIR)) continue;
+            if(typeid(*ir) != typeid(BranchIR)) {
+                ir->deleteIR();
+                removedCnt++;
+            }
+        }
+        if(irs.empty() || typeid(*irs.back()) != typeid(BranchIR) || live.count(irs.back())) continue;
+        BasicBlock* target = bb->getPostIdom();
+        std::vector<BasicBlock*> succBBs = bb->getSucc();
+        for(BasicBlock* succBB : succBBs) {
+            if(succBB == target) continue;
+            bb->removeSucc(succBB);
+            for(auto phi : succBB->getIr()) {
+                if(typeid(*phi) != typeid(PhiIR)) break;
+                dynamic_cast<PhiIR*>(phi)->params.erase(bb);
+            }
+        }
+        bb->addSucc(target);
+        irs.back()->deleteIR();
+        irs.push_back(new JumpIR(target));
+        branchCnt++;
+        cfgChanged = true;
+    }
+    return cfgChanged;
+}
+
+// 绕过只有一条跳转的块, 前驱改为直接跳到目标
+// 目标有 phi 时, 要求前驱原本不是目标的前驱, phi 参数复制给每个前驱
+inline bool ADCE::removeEmptyBB() {
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    std::vector<BasicBlock*> kept{bbs[0]};
+    for(size_t i(1); i < bbs.size(); i++) {
+        BasicBlock* bb = bbs[i];
+        auto& irs = bb->getIr();
+        bool empty = !irs.empty() && typeid(*irs.back()) == typeid(JumpIR);
+        for(size_t k(0); empty && k + 1 < irs.size(); k++) {
+            empty = irs[k]->isDeleted();
+        }
+        BasicBlock* target = empty ? dynamic_cast<JumpIR*>(irs.back())->target : nullptr;
+        bool hasPhi = target && !target->getIr().empty() && typeid(*target->getIr()[0]) == typeid(PhiIR);
+        for(BasicBlock* preBB : bb->getPre()) {
+            if(!empty || target == bb) {
+                empty = false;
+                break;
+            }
+            bool isPre = std::find(target->getPre().begin(), target->getPre().end(), preBB) != target->getPre().end();
+            empty = !(hasPhi && isPre);
+        }
+        if(!empty || bb->getPre().empty()) {
+            kept.push_back(bb);
+            continue;
+        }
+        std::vector<BasicBlock*> preBBs = bb->getPre();
+        for(BasicBlock* preBB : preBBs) {
+            // 顺序落入的前驱补上跳转
+            auto& preIrs = preBB->getIr();
+            if(preIrs.empty() || (typeid(*preIrs.back()) != typeid(JumpIR) && typeid(*preIrs.back()) != typeid(BranchIR))) {
+                preIrs.push_back(new JumpIR(bb));
+            }
+            for(auto ir : target->getIr()) {
+                if(typeid(*ir) != typeid(PhiIR)) break;
+                auto& params = dynamic_cast<PhiIR*>(ir)->params;
+                if(params.count(bb)) params[preBB] = params[bb];
+            }
+            preBB->replaceTarget(bb, target);
+            if(std::find(preBB->getSucc().begin(), preBB->getSucc().end(), target) != preBB->getSucc().end()) {
+                // 两个出口指向同一块, 分支改为跳转
+                preBB->removeSucc(bb);
+                if(typeid(*preIrs.back()) == typeid(BranchIR)) {
+                    preIrs.back()->deleteIR();
+                    preIrs.push_back(new JumpIR(target));
+                }
+            } else {
+                preBB->replaceSucc(bb, target);
+            }
+        }
+        for(auto ir : target->getIr()) {
+            if(typeid(*ir) != typeid(PhiIR)) break;
+            dynamic_cast<PhiIR*>(ir)->params.erase(bb);
+        }
+        bb->removeSucc(target);
+        removedBBCnt++;
+    }
+    if(kept.size() == bbs.size()) return false;
+    bbs.swap(kept);
+    function->renumberBB();
+    return true;
+}
+
+#endif //SYSY2022_BJTU_ADCE_HH
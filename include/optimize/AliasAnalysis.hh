@@ -0,0 +1,234 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_ALIASANALYSIS_HH
+#define SYSY2022_BJTU_ALIASANALYSIS_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "PurityAnalysis.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+// 基于 GEP 链的别名分析, 在 SSA 上做, 以 4 字节的元素为单位
+// 地址 = 根对象 + 偏移, 根对象为全局变量、局部 alloca 或指针形参, 其余(phi、拷贝出来的指针)为未知
+// 偏移 = 变量 + 常数, 沿 GEP 累加, 下标中的 x + c、x - c、x * 1 拆开; 有两个变量时偏移未知
+// 不同的全局变量、alloca 互不别名; 形参指向调用者的数组或全局数组, 和本函数的 alloca 不别名;
+// 未传出(只作 load/store 地址和 GEP 基址)的 alloca 和未知地址也不别名
+// 同一根对象: 变量相同时按常数比较, 同一个 SSA 值在两处取值相同, 跨循环迭代比较时变量要是循环不变量
+// 结果按地址对缓存, CFG 不变但改了指令之后要重新 analyze
+class AliasAnalysis {
+public:
+    enum AliasResult { NoAlias, MayAlias, MustAlias };
+    struct Location {
+        // nullptr 为未知
+        Value* root = nullptr;
+        Value* var = nullptr;
+        int offset = 0;
+        bool known = true;
+    };
+private:
+    IrVisitor* irVisitor;
+    Function* function = nullptr;
+    PurityAnalysis purity;
+    bool purityDone = false;
+
+    std::unordered_map<Value*, Instruction*> defIr;
+    std::unordered_map<Value*, int> defCnt;
+    std::unordered_set<Value*> allocs;
+    std::unordered_set<Value*> params;
+    std::unordered_set<Value*> escaped;
+    std::unordered_map<Value*, Location> locCache;
+    std::map<std::pair<Value*, Value*>, AliasResult> aliasCache;
+
+    Location computeLocation(Value* addr, int depth);
+    // 下标拆成 变量 + 常数, 常数下标变量为 nullptr
+    std::pair<Value*, int> decompose(Value* index, int depth);
+    Instruction* getDef(Value* val) {
+        auto it = defIr.find(val);
+        return it != defIr.end() && defCnt[val] == 1 ? it->second : nullptr;
+    }
+    AliasResult computeAlias(Location& a, Location& b);
+public:
+    AliasAnalysis(IrVisitor* irVisitor) : irVisitor(irVisitor), purity(irVisitor) {;}
+    void analyze(Function* function);
+    Location& getLocation(Value* addr);
+    AliasResult alias(Value* a, Value* b);
+    bool isLocal(Value* root) { return root && allocs.count(root); }
+    bool isEscaped(Value* root) { return escaped.count(root) > 0; }
+    // 调用可能读写 addr 指向的内存
+    bool callMayAccess(CallIR* call, Value* addr);
+};
+
+inline void AliasAnalysis::analyze(Function* function) {
+    this->function = function;
+    if(!purityDone) {
+        purity.analyze();
+        purityDone = true;
+    }
+    defIr.clear();
+    defCnt.clear();
+    allocs.clear();
+    params.clear();
+    escaped.clear();
+    locCache.clear();
+    aliasCache.clear();
+    for(Value* param : function->params) {
+        if(param->getType()->isPointer()) params.insert(param);
+    }
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            Value* dst = getDefVal(ir);
+            if(!dst) continue;
+            defIr[dst] = ir;
+            defCnt[dst]++;
+            if(dynamic_cast<AllocIR*>(ir)) allocs.insert(dst);
+        }
+    }
+    // alloca 除了作 load/store 地址和 GEP 基址之外的使用都算传出
+    std::vector<Use*> uses;
+    auto markEscaped = [&](Value* val) {
+        if(!val) return;
+        Location& loc = getLocation(val);
+        if(isLocal(loc.root)) escaped.insert(loc.root);
+    };
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            const std::type_info& t = typeid(*ir);
+            if(t == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* tv = dynamic_cast<TempVal*>(param.second);
+                    markEscaped(tv ? tv->getVal() : param.second);
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            bool isAddrUse = t == typeid(StoreIIR) || t == typeid(StoreFIR) || t == typeid(LoadIIR)
+                             || t == typeid(LoadFIR) || t == typeid(GEPIR);
+            for(size_t i(0); i < uses.size(); i++) {
+                if(isAddrUse && i == 0) continue;
+                Value* val = getUseVal(uses[i]);
+                if(val && val->getType() && val->getType()->isPointer()) markEscaped(val);
+            }
+        }
+    }
+}
+
+inline AliasAnalysis::Location& AliasAnalysis::getLocation(Value* addr) {
+    auto it = locCache.find(addr);
+    if(it != locCache.end()) return it->second;
+    Location loc = computeLocation(addr, 0);
+    return locCache[addr] = loc;
+}
+
+inline AliasAnalysis::Location AliasAnalysis::computeLocation(Value* addr, int depth) {
+    Location loc;
+    if(!addr || depth > 64) return loc;
+    if(addr->is_Global() || allocs.count(addr) || params.count(addr)) {
+        loc.root = addr;
+        return loc;
+    }
+    auto it = locCache.find(addr);
+    if(it != locCache.end()) return it->second;
+    Instruction* def = getDef(addr);
+    if(!def || typeid(*def) != typeid(GEPIR)) return loc;
+    auto& operands = def->getOperands();
+    loc = computeLocation(getUseVal(operands[1]), depth + 1);
+    if(!loc.root || !loc.known) return loc;
+    Value* index = getUseVal(operands[2]);
+    if(!index) {
+        loc.offset += dynamic_cast<GEPIR*>(def)->arrayLen;
+        return loc;
+    }
+    auto part = decompose(index, 0);
+    loc.offset += part.second;
+    // 多次定值的变量在两处的值可能不同
+    if(part.first && (loc.var || defCnt[part.first] > 1)) {
+        loc.known = false;
+    } else if(part.first) {
+        loc.var = part.first;
+    }
+    return loc;
+}
+
+inline std::pair<Value*, int> AliasAnalysis::decompose(Value* index, int depth) {
+    Instruction* def = getDef(index);
+    if(!def || depth > 16) return {index, 0};
+    const std::type_info& t = typeid(*def);
+    auto& operands = def->getOperands();
+    auto asConst = [](Value* val, int& c) {
+        TempVal* tv = dynamic_cast<TempVal*>(val);
+        if(!tv || tv->getVal() || !tv->getType() || !tv->getType()->isInt()) return false;
+        c = tv->getInt();
+        return true;
+    };
+    int c;
+    if(t == typeid(MoveIR)) {
+        if(asConst(operands[1]->getVal(), c)) return {nullptr, c};
+        Value* src = getUseVal(operands[1]);
+        return src ? decompose(src, depth + 1) : std::make_pair(index, 0);
+    }
+    if(t == typeid(AddIIR) || t == typeid(SubIIR)) {
+        Value* left = getUseVal(operands[1]);
+        if(asConst(operands[2]->getVal(), c) && left) {
+            auto part = decompose(left, depth + 1);
+            return {part.first, part.second + (t == typeid(AddIIR) ? c : -c)};
+        }
+        Value* right = getUseVal(operands[2]);
+        if(t == typeid(AddIIR) && asConst(operands[1]->getVal(), c) && right) {
+            auto part = decompose(right, depth + 1);
+            return {part.first, part.second + c};
+        }
+    }
+    // 前端算下标时生成的 x * 1
+    if(t == typeid(MulIIR)) {
+        for(int i(1); i <= 2; i++) {
+            Value* other = getUseVal(operands[3 - i]);
+            if(asConst(operands[i]->getVal(), c) && c == 1 && other) return decompose(other, depth + 1);
+        }
+    }
+    return {index, 0};
+}
+
+inline AliasAnalysis::AliasResult AliasAnalysis::alias(Value* a, Value* b) {
+    if(a == b) return defCnt[a] > 1 ? MayAlias : MustAlias;
+    auto key = a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+    auto it = aliasCache.find(key);
+    if(it != aliasCache.end()) return it->second;
+    Location la = getLocation(a);
+    Location lb = getLocation(b);
+    return aliasCache[key] = computeAlias(la, lb);
+}
+
+inline AliasAnalysis::AliasResult AliasAnalysis::computeAlias(Location& a, Location& b) {
+    if(!a.root || !b.root) {
+        Value* root = a.root ? a.root : b.root;
+        return isLocal(root) && !isEscaped(root) ? NoAlias : MayAlias;
+    }
+    if(a.root != b.root) {
+        bool aParam = params.count(a.root), bParam = params.count(b.root);
+        if(!aParam && !bParam) return NoAlias;
+        if(aParam && bParam) return MayAlias;
+        // 形参只能指向调用者的数组和全局数组
+        Value* other = aParam ? b.root : a.root;
+        return other->is_Global() && other->is_Array() ? MayAlias : NoAlias;
+    }
+    if(!a.known || !b.known || a.var != b.var) return MayAlias;
+    return a.offset == b.offset ? MustAlias : NoAlias;
+}
+
+inline bool AliasAnalysis::callMayAccess(CallIR* call, Value* addr) {
+    Function* callee = call->func;
+    if(isMemFreeLibFunc(callee) || purity.isPure(callee)) return false;
+    Location& loc = getLocation(addr);
+    if(isLocal(loc.root) && !isEscaped(loc.root)) return false;
+    return true;
+}
+
+#endif //SYSY2022_BJTU_ALIASANALYSIS_HH
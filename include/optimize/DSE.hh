@@ -0,0 +1,213 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_DSE_HH
+#define SYSY2022_BJTU_DSE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "AliasAnalysis.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_set>
+
+// 死 store 消除, 在 SSA 上做, 需要有效的支配树, 不改 CFG
+// store 的值在被读到之前就被 MustAlias 的 store 覆盖时删除: 先看块内后面的指令, 再沿后支配树往上找覆盖它的 store,
+// 要求中间能走到的块都不读这个地址, 且这些块不支配 store 所在块(不绕回去改变地址中的变量)
+// 未传出的局部数组, 之后能走到的指令都不读它时也删除(函数返回后就没了)
+// 数组 alloca 的 memset: 从 alloca 往后沿单前驱单后继的块链, 读之前就被常量下标 store 写过的元素不用清零,
+// memset 缩成剩下元素所在的区间, 全写过则去掉
+class DSE {
+private:
+    IrVisitor* irVisitor;
+    Function* function;
+    DominateTree dominateTree;
+    AliasAnalysis aliasAnalysis;
+
+    static const int maxRegion = 128;
+    static const int maxPostDomDepth = 4;
+
+    int removedCnt = 0;
+    int shrunkCnt = 0;
+    int droppedCnt = 0;
+
+    void shrinkMemset(BasicBlock* bb, size_t pos);
+    bool isDead(BasicBlock* bb, size_t pos, Value* addr);
+    // 从 from 的后继出发不进入 stop 能走到的块, 太大时返回 false; 走回 from 或 from 的支配结点时 cyclic
+    bool getRegion(BasicBlock* from, BasicBlock* stop, std::vector<BasicBlock*>& region, bool& cyclic);
+    bool mayRead(Instruction* ir, Value* addr, bool cyclic);
+    bool regionReads(std::vector<BasicBlock*>& region, Value* addr, bool cyclic);
+    bool overwrites(Instruction* ir, Value* addr);
+public:
+    DSE(IrVisitor* irVisitor) : irVisitor(irVisitor), dominateTree(irVisitor), aliasAnalysis(irVisitor) {;}
+    void execute();
+    int getRemovedCnt() { return removedCnt; }
+    int getShrunkCnt() { return shrunkCnt; }
+    int getDroppedCnt() { return droppedCnt; }
+};
+
+inline void DSE::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        aliasAnalysis.analyze(func);
+        dominateTree.getPostIdom(func);
+        // 先缩 memset, 这时所有 store 都还在
+        for(BasicBlock* bb : func->getBB()) {
+            auto& irs = bb->getIr();
+            for(size_t i(0); i < irs.size(); i++) {
+                AllocIR* alloc = dynamic_cast<AllocIR*>(irs[i]);
+                if(alloc && !alloc->isDeleted() && alloc->isArray) shrinkMemset(bb, i);
+            }
+        }
+        for(BasicBlock* bb : func->getBB()) {
+            auto& irs = bb->getIr();
+            for(size_t i(0); i < irs.size(); i++) {
+                Instruction* ir = irs[i];
+                if(ir->isDeleted() || !dynamic_cast<StoreIR*>(ir)) continue;
+                Value* addr = getUseVal(ir->getOperands()[0]);
+                if(addr && isDead(bb, i, addr)) {
+                    ir->deleteIR();
+                    removedCnt++;
+                }
+            }
+        }
+    }
+}
+
+inline void DSE::shrinkMemset(BasicBlock* bb, size_t pos) {
+    AllocIR* alloc = dynamic_cast<AllocIR*>(bb->getIr()[pos]);
+    Value* root = getDefVal(alloc);
+    int len = alloc->arrayLen;
+    if(alloc->getZeroEnd() <= alloc->zeroBegin) return;
+    std::vector<bool> covered(len, false);
+    // 可能读到数组中未写过的元素时停下
+    auto readsUncovered = [&](Instruction* ir) {
+        const std::type_info& t = typeid(*ir);
+        if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) {
+            AliasAnalysis::Location& loc = aliasAnalysis.getLocation(getUseVal(ir->getOperands()[1]));
+            if(loc.root != root) return !loc.root && aliasAnalysis.isEscaped(root);
+            return !loc.known || loc.var || loc.offset < 0 || loc.offset >= len || !covered[loc.offset];
+        }
+        if(t == typeid(CallIR)) return aliasAnalysis.callMayAccess(dynamic_cast<CallIR*>(ir), root);
+        return t == typeid(ReturnIR) || getDefVal(ir) == root;
+    };
+    BasicBlock* cur = bb;
+    size_t start = pos + 1;
+    bool stop = false;
+    while(!stop) {
+        auto& irs = cur->getIr();
+        for(size_t i(start); i < irs.size(); i++) {
+            Instruction* ir = irs[i];
+            if(ir->isDeleted()) continue;
+            if(readsUncovered(ir)) {
+                stop = true;
+                break;
+            }
+            if(dynamic_cast<StoreIR*>(ir)) {
+                AliasAnalysis::Location& loc = aliasAnalysis.getLocation(getUseVal(ir->getOperands()[0]));
+                if(loc.root == root && loc.known && !loc.var && loc.offset >= 0 && loc.offset < len) covered[loc.offset] = true;
+            }
+        }
+        if(stop || cur->getSucc().size() != 1) break;
+        BasicBlock* next = cur->getSucc()[0];
+        if(next == bb || next->getPre().size() != 1) break;
+        cur = next;
+        start = 0;
+    }
+    int lo = alloc->zeroBegin, hi = alloc->getZeroEnd();
+    while(lo < hi && covered[lo]) lo++;
+    while(hi > lo && covered[hi - 1]) hi--;
+    if(lo == alloc->zeroBegin && hi == alloc->getZeroEnd()) return;
+    if(lo == hi) {
+        lo = hi = 0;
+        droppedCnt++;
+    } else {
+        shrunkCnt++;
+    }
+    alloc->zeroBegin = lo;
+    alloc->zeroEnd = hi;
+}
+
+inline bool DSE::isDead(BasicBlock* bb, size_t pos, Value* addr) {
+    auto& irs = bb->getIr();
+    for(size_t i(pos + 1); i < irs.size(); i++) {
+        if(irs[i]->isDeleted()) continue;
+        if(mayRead(irs[i], addr, false)) return false;
+        if(overwrites(irs[i], addr)) return true;
+    }
+    std::vector<BasicBlock*> region;
+    bool cyclic;
+    // 未传出的局部数组, 之后不再被读
+    AliasAnalysis::Location& loc = aliasAnalysis.getLocation(addr);
+    if(aliasAnalysis.isLocal(loc.root) && !aliasAnalysis.isEscaped(loc.root)) {
+        if(getRegion(bb, nullptr, region, cyclic) && !regionReads(region, addr, cyclic)) return true;
+    }
+    // 沿后支配树往上找覆盖它的 store
+    BasicBlock* post = bb->getPostIdom();
+    for(int depth(0); post && depth < maxPostDomDepth; depth++) {
+        if(post->dominates(bb) || !getRegion(bb, post, region, cyclic) || cyclic) return false;
+        if(regionReads(region, addr, false)) return false;
+        for(auto ir : post->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(mayRead(ir, addr, false)) return false;
+            if(overwrites(ir, addr)) return true;
+        }
+        post = post->getPostIdom();
+    }
+    return false;
+}
+
+inline bool DSE::getRegion(BasicBlock* from, BasicBlock* stop, std::vector<BasicBlock*>& region, bool& cyclic) {
+    region.clear();
+    cyclic = false;
+    std::unordered_set<BasicBlock*> visited;
+    std::vector<BasicBlock*> stack{from};
+    while(!stack.empty()) {
+        BasicBlock* cur = stack.back();
+        stack.pop_back();
+        for(BasicBlock* succBB : cur->getSucc()) {
+            if(succBB == stop || !visited.insert(succBB).second) continue;
+            if((int) visited.size() > maxRegion) return false;
+            if(succBB->dominates(from)) cyclic = true;
+            region.push_back(succBB);
+            stack.push_back(succBB);
+        }
+    }
+    return true;
+}
+
+// 有环时下标中的变量在两次执行间会变, 同一数组上带变量的地址都算可能读
+inline bool DSE::mayRead(Instruction* ir, Value* addr, bool cyclic) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) {
+        Value* loadAddr = getUseVal(ir->getOperands()[1]);
+        if(aliasAnalysis.alias(loadAddr, addr) != AliasAnalysis::NoAlias) return true;
+        if(!cyclic) return false;
+        AliasAnalysis::Location& a = aliasAnalysis.getLocation(loadAddr);
+        AliasAnalysis::Location& b = aliasAnalysis.getLocation(addr);
+        return a.root && a.root == b.root && (a.var || b.var);
+    }
+    if(t == typeid(CallIR)) return aliasAnalysis.callMayAccess(dynamic_cast<CallIR*>(ir), addr);
+    // 返回后全局变量和形参指向的内存仍然可见
+    if(t == typeid(ReturnIR)) return !aliasAnalysis.isLocal(aliasAnalysis.getLocation(addr).root);
+    return false;
+}
+
+inline bool DSE::regionReads(std::vector<BasicBlock*>& region, Value* addr, bool cyclic) {
+    for(BasicBlock* bb : region) {
+        for(auto ir : bb->getIr()) {
+            if(!ir->isDeleted() && mayRead(ir, addr, cyclic)) return true;
+        }
+    }
+    return false;
+}
+
+inline bool DSE::overwrites(Instruction* ir, Value* addr) {
+    if(!dynamic_cast<StoreIR*>(ir)) return false;
+    return aliasAnalysis.alias(getUseVal(ir->getOperands()[0]), addr) == AliasAnalysis::MustAlias;
+}
+
+#endif //SYSY2022_BJTU_DSE_HH
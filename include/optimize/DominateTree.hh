@@ -2,144 +2,552 @@
 // Created by hanyangchen on 22-6-30.
 //
 
+#ifndef SYSY2022_BJTU_DOMINATETREE_HH
+#define SYSY2022_BJTU_DOMINATETREE_HH
+
 #include "IrVisitor.hh"
-#include <map>
-#include <list>
-#include <set>
+#include <vector>
+#include <queue>
 
+// 支配树: semi-NCA 求立即支配点, 节点用块id编号
+// 支配树先序/后序编号写回基本块, dominates() 为 O(1) 查询
+// 后支配树在反向图上求, 多个出口和死循环都挂到虚拟出口下
+// insertEdge/deleteEdge/splitBlock/splitEdge 修改 CFG 并增量维护支配树和支配边界, 后支配树需重新计算
 class DominateTree {
 private:
     IrVisitor* irVisitor;
-    std::vector<BasicBlock*> doms;
-    std::map<BasicBlock*, int> bbMap;
-    std::list<BasicBlock*> reversePostOrder;
+    // 图, 压缩邻接表(CSR), 下标为节点编号
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> succOff, succAdj, predOff, predAdj;
+    std::vector<bool> exitEdge;     // 后支配: 块是否连到虚拟出口
+    // semi-NCA 工作数组, 除 dfn 外下标均为 dfs 先序编号
+    std::vector<int> dfn, vertex, parent, semi, label, ancestor, idomNum;
+    std::vector<int> path;
+    std::vector<std::pair<int, size_t>> work;
+
+    void buildGraph(int n);
+    void semiNCA(int root);
+    int eval(int v);
+    template<class Children, class SetNum>
+    static void numberTree(BasicBlock* root, Children children, SetNum setNum, int& cnt, int level = 0);
 public:
     DominateTree(IrVisitor* irVisitor) : irVisitor(irVisitor) {}
     void execute();
     void getIdom(Function* function);
     void getDomFront(Function* function);
-    void getPostOrder(BasicBlock* bb, std::set<BasicBlock*>& visited);
     void genDominateTree(Function* function);
-    // void genBBDom(BasicBlock* bb);
-    BasicBlock* intersect(BasicBlock* bb1, BasicBlock* bb2);
+    void getPostIdom(Function* function);
+    void getPostDomFront(Function* function);
+    void genPostDominateTree(Function* function);
+
+    // 增量更新, 只改 pre/succ, 终结指令由调用者修改
+    void insertEdge(Function* function, BasicBlock* from, BasicBlock* to);
+    void deleteEdge(Function* function, BasicBlock* from, BasicBlock* to);
+    // 以下两个会改指令, 新块紧跟在原块后面, 块id重新编号
+    BasicBlock* splitBlock(Function* function, BasicBlock* bb, size_t pos);
+    BasicBlock* splitEdge(Function* function, BasicBlock* from, BasicBlock* to);
+    static BasicBlock* findNCA(BasicBlock* bb1, BasicBlock* bb2);
+private:
+    static bool isReachable(Function* function, BasicBlock* bb) { return bb == function->getBB()[0] || bb->getIdom(); }
+    bool hasProperSupport(Function* function, BasicBlock* bb);
+    void recompute(Function* function);
+    void recomputeSubtree(Function* function, BasicBlock* root);
+    void recomputeFrontier(Function* function, BasicBlock* root);
+    NormalBlock* newBlockAfter(Function* function, BasicBlock* bb);
+    static void setTreeIdom(BasicBlock* bb, BasicBlock* idom);
+    static void renumberSubtree(BasicBlock* root);
 };
 
-void DominateTree::execute() {
+inline void DominateTree::execute() {
     for (auto function : irVisitor->getFunctions()) {
         if(function->getBB().empty()) continue;
 
-        // 清空，初始化
-        doms.clear();
-        bbMap.clear();
-        reversePostOrder.clear();
-
         getIdom(function);
         getDomFront(function);
         genDominateTree(function);
+
+        getPostIdom(function);
+        getPostDomFront(function);
+        genPostDominateTree(function);
+    }
+}
+
+inline void DominateTree::buildGraph(int n) {
+    succOff.assign(n + 1, 0);
+    predOff.assign(n + 1, 0);
+    for(auto& e : edges) {
+        succOff[e.first + 1]++;
+        predOff[e.second + 1]++;
+    }
+    for(int i(0); i < n; i++) {
+        succOff[i + 1] += succOff[i];
+        predOff[i + 1] += predOff[i];
+    }
+    succAdj.resize(edges.size());
+    predAdj.resize(edges.size());
+    std::vector<int> succPos(succOff.begin(), succOff.end() - 1);
+    std::vector<int> predPos(predOff.begin(), predOff.end() - 1);
+    for(auto& e : edges) {
+        succAdj[succPos[e.first]++] = e.second;
+        predAdj[predPos[e.second]++] = e.first;
+    }
+}
+
+// 路径压缩, label 为到森林根(不含)路径上 semi 最小的点
+inline int DominateTree::eval(int v) {
+    if(ancestor[v] < 0) return v;
+    path.clear();
+    int u = v;
+    while(ancestor[ancestor[u]] >= 0) {
+        path.push_back(u);
+        u = ancestor[u];
+    }
+    for(int k(path.size() - 1); k >= 0; k--) {
+        int x = path[k], a = ancestor[x];
+        if(semi[label[a]] < semi[label[x]]) label[x] = label[a];
+        ancestor[x] = ancestor[a];
+    }
+    return label[v];
+}
+
+// 在 CSR 图上从 root 求立即支配点, 结果在 idomNum (dfs编号) 和 vertex 中
+inline void DominateTree::semiNCA(int root) {
+    int n = succOff.size() - 1;
+    dfn.assign(n, -1);
+    vertex.clear();
+    parent.clear();
+
+    // 非递归 dfs 先序编号
+    dfn[root] = 0;
+    vertex.push_back(root);
+    parent.push_back(-1);
+    work.clear();
+    work.emplace_back(root, succOff[root]);
+    while(!work.empty()) {
+        int v = work.back().first;
+        size_t i = work.back().second;
+        if(i == (size_t)succOff[v + 1]) {
+            work.pop_back();
+            continue;
+        }
+        work.back().second++;
+        int w = succAdj[i];
+        if(dfn[w] < 0) {
+            dfn[w] = vertex.size();
+            vertex.push_back(w);
+            parent.push_back(dfn[v]);
+            work.emplace_back(w, succOff[w]);
+        }
+    }
+
+    int cnt = vertex.size();
+    semi.resize(cnt);
+    label.resize(cnt);
+    ancestor.assign(cnt, -1);
+    for(int i(0); i < cnt; i++) {
+        semi[i] = i;
+        label[i] = i;
+    }
+    // 半支配点
+    for(int i(cnt - 1); i > 0; i--) {
+        for(int k(predOff[vertex[i]]); k < predOff[vertex[i] + 1]; k++) {
+            int v = predAdj[k];
+            if(dfn[v] < 0) continue;
+            int u = eval(dfn[v]);
+            if(semi[u] < semi[i]) semi[i] = semi[u];
+        }
+        ancestor[i] = parent[i];
+    }
+    // 沿 dfs 树父链找与半支配点的最近公共祖先
+    idomNum.resize(cnt);
+    idomNum[0] = 0;
+    for(int i(1); i < cnt; i++) {
+        int d = parent[i];
+        while(d > semi[i]) d = idomNum[d];
+        idomNum[i] = d;
     }
 }
 
-// 获得立即支配集
-void DominateTree::getIdom(Function* function) {
-    // 获得逆序后续遍历
+template<class Children, class SetNum>
+void DominateTree::numberTree(BasicBlock* root, Children children, SetNum setNum, int& cnt, int level) {
+    std::vector<std::pair<BasicBlock*, size_t>> stk = {{root, 0}};
+    std::vector<int> in = {cnt++};
+    while(!stk.empty()) {
+        BasicBlock* bb = stk.back().first;
+        size_t i = stk.back().second;
+        std::vector<BasicBlock*>& next = children(bb);
+        if(i == next.size()) {
+            setNum(bb, in.back(), cnt++, level + (int)stk.size() - 1);
+            stk.pop_back();
+            in.pop_back();
+            continue;
+        }
+        stk.back().second++;
+        stk.emplace_back(next[i], 0);
+        in.push_back(cnt++);
+    }
+}
+
+// 获得立即支配点, 入口块和不可达块的 idom 为 nullptr
+inline void DominateTree::getIdom(Function* function) {
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    function->renumberBB();
+    edges.clear();
+    for(BasicBlock* bb : bbs) {
+        for(BasicBlock* succBB : bb->getSucc()) {
+            edges.emplace_back(bb->getId(), succBB->getId());
+        }
+        bb->setIdom(nullptr);
+        bb->setDomNum(-1, -1);
+    }
+    buildGraph(bbs.size());
+    semiNCA(0);
+    for(size_t i(1); i < vertex.size(); i++) {
+        bbs[vertex[i]]->setIdom(bbs[vertex[idomNum[i]]]);
+    }
+}
+
+// 获得支配前沿, 只看可达的前驱
+inline void DominateTree::getDomFront(Function* function) {
     BasicBlock* entryBB = function->getBB()[0];
-    std::set<BasicBlock*> visited = {};
-    getPostOrder(entryBB, visited);
-    reversePostOrder.reverse();
-
-    // 初始化dom
-    for(int i(0); i <= bbMap[entryBB]; i++) {
-        doms.push_back(nullptr);
-    }
-
-    // 开始迭代算法
-    doms[bbMap[entryBB]] = entryBB;
-
-    bool changed = true;
-    while(changed) {
-        changed = false;
-        for(auto bb : reversePostOrder) {
-            if(bb == entryBB) continue;
-            BasicBlock* newIdom = nullptr;
-            // 获得bb的前驱  new_idom ← first (processed) predecessor of b /* (pick one) */
-            for(auto preBB : bb->getPre()) {
-                if(doms[bbMap[preBB]] != nullptr) {
-                    newIdom = preBB;
-                    break;
-                }
+    for(BasicBlock* bb : function->getBB()) bb->getDomFrontier().clear();
+    for(BasicBlock* bb : function->getBB()) {
+        if(bb->getPre().size() < 2) continue;
+        if(bb != entryBB && !bb->getIdom()) continue;
+        for(BasicBlock* preBB : bb->getPre()) {
+            if(preBB != entryBB && !preBB->getIdom()) continue;
+            BasicBlock* runner = preBB;
+            // 同一个 bb 处理完才处理下一个, 末尾已是 bb 说明上面的链也走过了
+            while(runner && runner != bb->getIdom()) {
+                std::vector<BasicBlock*>& df = runner->getDomFrontier();
+                if(!df.empty() && df.back() == bb) break;
+                df.push_back(bb);
+                runner = runner->getIdom();
             }
+        }
+    }
+}
 
-            for(auto preBB : bb->getPre()) {
-                if(doms[bbMap[preBB]] != nullptr) {
-                    newIdom = intersect(preBB, newIdom);
-                }
-            }
+// 获得支配树, 并按支配树编号
+inline void DominateTree::genDominateTree(Function* function) {
+    for(auto bb : function->getBB()) bb->getDomTreeSuccNode().clear();
+    for(auto bb : function->getBB()) {
+        BasicBlock* idom = bb->getIdom();
+        if(idom) idom->pushDomTreeSuccNode(bb);
+    }
+    int cnt = 0;
+    numberTree(function->getBB()[0],
+               [](BasicBlock* bb) -> std::vector<BasicBlock*>& { return bb->getDomTreeSuccNode(); },
+               [](BasicBlock* bb, int in, int out, int level) { bb->setDomNum(in, out, level); }, cnt);
+}
 
-            if(newIdom != doms[bbMap[bb]]) {
-                doms[bbMap[bb]] = newIdom;
-                changed = true;
+// 后支配: 反向图, 节点 n 为虚拟出口
+// 无后继的块连到虚拟出口; 走不到出口的死循环取其中id最大的块连到虚拟出口
+inline void DominateTree::getPostIdom(Function* function) {
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    int n = bbs.size();
+    function->renumberBB();
+    exitEdge.assign(n, false);
+    std::vector<bool> reach(n, false);
+    std::vector<BasicBlock*> queue;
+    auto addRoot = [&](BasicBlock* root) {
+        exitEdge[root->getId()] = true;
+        reach[root->getId()] = true;
+        queue.push_back(root);
+        while(!queue.empty()) {
+            BasicBlock* bb = queue.back();
+            queue.pop_back();
+            for(BasicBlock* preBB : bb->getPre()) {
+                if(!reach[preBB->getId()]) {
+                    reach[preBB->getId()] = true;
+                    queue.push_back(preBB);
+                }
             }
         }
+    };
+    for(BasicBlock* bb : bbs) {
+        if(bb->getSucc().empty()) addRoot(bb);
+    }
+    for(int i(n - 1); i >= 0; i--) {
+        if(!reach[i]) addRoot(bbs[i]);
     }
 
-    for(auto bb : reversePostOrder){
-        bb->setIdom(doms[bbMap[bb]]);
+    edges.clear();
+    for(BasicBlock* bb : bbs) {
+        for(BasicBlock* succBB : bb->getSucc()) {
+            edges.emplace_back(succBB->getId(), bb->getId());
+        }
+        if(exitEdge[bb->getId()]) edges.emplace_back(n, bb->getId());
+        bb->setPostIdom(nullptr);
+        bb->setPostDomNum(-1, -1);
+    }
+    buildGraph(n + 1);
+    semiNCA(n);
+    for(size_t i(1); i < vertex.size(); i++) {
+        int d = vertex[idomNum[i]];
+        bbs[vertex[i]]->setPostIdom(d == n ? nullptr : bbs[d]);
     }
 }
 
-// 后续遍历
-void DominateTree::getPostOrder(BasicBlock* bb, std::set<BasicBlock*>& visited) {
-    visited.insert(bb);
-    std::vector<BasicBlock*> succBBs = bb->getSucc();
-    for(int i(succBBs.size() - 1); i >= 0; i--) {
-        if(!visited.count(succBBs[i])) getPostOrder(succBBs[i], visited);
+// 获得后支配边界, 反向图的前驱即原图后继加上虚拟出口边(不参与计算)
+inline void DominateTree::getPostDomFront(Function* function) {
+    for(BasicBlock* bb : function->getBB()) bb->getPostDomFrontier().clear();
+    for(BasicBlock* bb : function->getBB()) {
+        if(bb->getSucc().size() + exitEdge[bb->getId()] < 2) continue;
+        for(BasicBlock* succBB : bb->getSucc()) {
+            BasicBlock* runner = succBB;
+            while(runner && runner != bb->getPostIdom()) {
+                std::vector<BasicBlock*>& pdf = runner->getPostDomFrontier();
+                if(!pdf.empty() && pdf.back() == bb) break;
+                pdf.push_back(bb);
+                runner = runner->getPostIdom();
+            }
+        }
     }
-    bbMap[bb] = reversePostOrder.size();
-    reversePostOrder.push_back(bb);
 }
 
-// 双指针算法求交集
-BasicBlock* DominateTree::intersect(BasicBlock* bb1, BasicBlock* bb2) {
-    BasicBlock* finger1 = bb1, *finger2 = bb2;
-    while(finger1 != finger2) {
-        while(bbMap[finger1] < bbMap[finger2]) {
-            finger1 = doms[bbMap[finger1]];
+// 获得后支配树, 虚拟出口的孩子依次编号
+inline void DominateTree::genPostDominateTree(Function* function) {
+    for(auto bb : function->getBB()) bb->getPostDomTreeSuccNode().clear();
+    std::vector<BasicBlock*> roots;
+    for(auto bb : function->getBB()) {
+        BasicBlock* pidom = bb->getPostIdom();
+        if(pidom) {
+            pidom->pushPostDomTreeSuccNode(bb);
+        } else {
+            roots.push_back(bb);
         }
-        while(bbMap[finger2] < bbMap[finger1]) {
-            finger2 = doms[bbMap[finger2]];
+    }
+    int cnt = 0;
+    for(auto root : roots) {
+        numberTree(root,
+                   [](BasicBlock* bb) -> std::vector<BasicBlock*>& { return bb->getPostDomTreeSuccNode(); },
+                   [](BasicBlock* bb, int in, int out, int) { bb->setPostDomNum(in, out); }, cnt);
+    }
+}
+
+inline void DominateTree::recompute(Function* function) {
+    getIdom(function);
+    getDomFront(function);
+    genDominateTree(function);
+}
+
+// 两个可达块在支配树上的最近公共祖先
+inline BasicBlock* DominateTree::findNCA(BasicBlock* bb1, BasicBlock* bb2) {
+    while(bb1 != bb2) {
+        if(bb1->getDomLevel() < bb2->getDomLevel()) {
+            bb2 = bb2->getIdom();
+        } else {
+            bb1 = bb1->getIdom();
         }
     }
-    return finger1;
+    return bb1;
 }
 
-// 获得支配前沿
-void DominateTree::getDomFront(Function* function) {
-    for(BasicBlock* bb : function->getBB()) {
-        if(bb->getPre().size() >= 2) {
-            for(BasicBlock* preBB : bb->getPre()) {
+// 有不被 bb 支配的可达前驱, 删边后 bb 仍可达
+inline bool DominateTree::hasProperSupport(Function* function, BasicBlock* bb) {
+    for(BasicBlock* preBB : bb->getPre()) {
+        if(isReachable(function, preBB) && !bb->dominates(preBB)) return true;
+    }
+    return false;
+}
+
+// 重算 root 子树的支配边界, 子树外的边界不受影响
+// 按汇合点 y 逐个处理, 同 getDomFront 一样用末尾元素去重
+inline void DominateTree::recomputeFrontier(Function* function, BasicBlock* root) {
+    std::vector<BasicBlock*> subtree = {root};
+    for(size_t i(0); i < subtree.size(); i++) {
+        subtree[i]->getDomFrontier().clear();
+        for(BasicBlock* child : subtree[i]->getDomTreeSuccNode()) subtree.push_back(child);
+    }
+    std::vector<bool> seen(function->getBB().size(), false);
+    for(BasicBlock* bb : subtree) {
+        for(BasicBlock* y : bb->getSucc()) {
+            if(seen[y->getId()]) continue;
+            seen[y->getId()] = true;
+            for(BasicBlock* preBB : y->getPre()) {
                 BasicBlock* runner = preBB;
-                while(runner != doms[bbMap[bb]]) {
-                    runner->insertDomFrontier(bb);
-                    runner = doms[bbMap[runner]];
+                while(runner && runner != y->getIdom() && root->dominates(runner)) {
+                    std::vector<BasicBlock*>& df = runner->getDomFrontier();
+                    if(!df.empty() && df.back() == y) break;
+                    df.push_back(y);
+                    runner = runner->getIdom();
                 }
             }
         }
     }
 }
 
-// 获得支配树
-void DominateTree::genDominateTree(Function* function) {
-    for(auto bb : function->getBB()) {
-        BasicBlock* idom = bb->getIdom();
-        if(idom && idom != bb) {
-            idom->pushDomTreeSuccNode(bb);
+// 删边后只有 root 子树内的 idom 会变: 在子树上从 root 重新跑 semi-NCA
+inline void DominateTree::recomputeSubtree(Function* function, BasicBlock* root) {
+    std::vector<BasicBlock*> subtree = {root};
+    for(size_t i(0); i < subtree.size(); i++) {
+        for(BasicBlock* child : subtree[i]->getDomTreeSuccNode()) subtree.push_back(child);
+    }
+    std::vector<int> local(function->getBB().size(), -1);
+    for(size_t i(0); i < subtree.size(); i++) local[subtree[i]->getId()] = i;
+    edges.clear();
+    for(BasicBlock* bb : subtree) {
+        for(BasicBlock* succBB : bb->getSucc()) {
+            if(local[succBB->getId()] >= 0) edges.emplace_back(local[bb->getId()], local[succBB->getId()]);
         }
     }
+    buildGraph(subtree.size());
+    semiNCA(0);
+    for(size_t i(1); i < vertex.size(); i++) {
+        setTreeIdom(subtree[vertex[i]], subtree[vertex[idomNum[i]]]);
+    }
 }
 
-// void genBBDom(BasicBlock* bb) {
-//     if(!bb) return;
+// 加边 from->to, 按深度分桶找受影响的块, 它们的 idom 变为 NCA(from, to)
+inline void DominateTree::insertEdge(Function* function, BasicBlock* from, BasicBlock* to) {
+    std::vector<BasicBlock*>& succ = from->getSucc();
+    if(std::find(succ.begin(), succ.end(), to) != succ.end()) return;
+    from->addSucc(to);
+    if(!isReachable(function, from)) return;
+    if(!isReachable(function, to)) {
+        recompute(function);
+        return;
+    }
+    BasicBlock* nca = findNCA(from, to);
+    int ncaLevel = nca->getDomLevel();
+    if(ncaLevel + 1 >= to->getDomLevel()) {
+        // 支配树不变, 只把 to 加入 from 到 idom(to) 这条链的支配边界
+        for(BasicBlock* runner = from; runner && runner != to->getIdom(); runner = runner->getIdom()) {
+            runner->insertDomFrontier(to);
+        }
+        return;
+    }
+
+    auto cmp = [](BasicBlock* a, BasicBlock* b) { return a->getDomLevel() < b->getDomLevel(); };
+    std::priority_queue<BasicBlock*, std::vector<BasicBlock*>, decltype(cmp)> bucket(cmp);
+    std::vector<bool> visited(function->getBB().size(), false);
+    std::vector<BasicBlock*> affected, unaffected;
+    bucket.push(to);
+    visited[to->getId()] = true;
+    while(!bucket.empty()) {
+        BasicBlock* bb = bucket.top();
+        bucket.pop();
+        affected.push_back(bb);
+        int curLevel = bb->getDomLevel();
+        while(true) {
+            for(BasicBlock* succBB : bb->getSucc()) {
+                int level = succBB->getDomLevel();
+                if(level <= ncaLevel + 1 || visited[succBB->getId()]) continue;
+                visited[succBB->getId()] = true;
+                if(level > curLevel) {
+                    unaffected.push_back(succBB);
+                } else {
+                    bucket.push(succBB);
+                }
+            }
+            if(unaffected.empty()) break;
+            bb = unaffected.back();
+            unaffected.pop_back();
+        }
+    }
+    for(BasicBlock* bb : affected) setTreeIdom(bb, nca);
+    renumberSubtree(nca);
+    recomputeFrontier(function, nca);
+}
+
+// 删边 from->to; to 变得不可达时全量重算
+inline void DominateTree::deleteEdge(Function* function, BasicBlock* from, BasicBlock* to) {
+    std::vector<BasicBlock*>& succ = from->getSucc();
+    if(std::find(succ.begin(), succ.end(), to) == succ.end()) return;
+    from->removeSucc(to);
+    if(!isReachable(function, from) || !isReachable(function, to)) return;
+    BasicBlock* nca = findNCA(from, to);
+    if(nca == to) {
+        // to 支配 from (回边), 支配树不变
+        recomputeFrontier(function, to->getIdom() ? to->getIdom() : to);
+    } else if(from != to->getIdom() || hasProperSupport(function, to)) {
+        recomputeSubtree(function, nca);
+        renumberSubtree(nca);
+        recomputeFrontier(function, nca);
+    } else {
+        recompute(function);
+    }
+}
+
+// 改 idom 并同步支配树孩子列表
+inline void DominateTree::setTreeIdom(BasicBlock* bb, BasicBlock* idom) {
+    BasicBlock* old = bb->getIdom();
+    if(old == idom) return;
+    if(old) {
+        std::vector<BasicBlock*>& children = old->getDomTreeSuccNode();
+        children.erase(std::find(children.begin(), children.end(), bb));
+    }
+    bb->setIdom(idom);
+    idom->pushDomTreeSuccNode(bb);
+}
+
+// 子树内的块只在子树内移动时, 子树的编号区间不变, 原地重新编号即可
+inline void DominateTree::renumberSubtree(BasicBlock* root) {
+    int cnt = root->getDomIn();
+    numberTree(root,
+               [](BasicBlock* bb) -> std::vector<BasicBlock*>& { return bb->getDomTreeSuccNode(); },
+               [](BasicBlock* bb, int in, int out, int level) { bb->setDomNum(in, out, level); }, cnt,
+               root->getDomLevel());
+}
+
+inline NormalBlock* DominateTree::newBlockAfter(Function* function, BasicBlock* bb) {
+    NormalBlock* nb = new NormalBlock(nullptr, function->name, function->bbCnt++);
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    bbs.insert(bbs.begin() + bb->getId() + 1, nb);
+    function->renumberBB();
+    return nb;
+}
+
+// bb 从 pos 处一分为二, 后半段放进新块, bb 顺序落入新块
+inline BasicBlock* DominateTree::splitBlock(Function* function, BasicBlock* bb, size_t pos) {
+    NormalBlock* nb = newBlockAfter(function, bb);
+    nb->ir.assign(bb->ir.begin() + pos, bb->ir.end());
+    bb->ir.erase(bb->ir.begin() + pos, bb->ir.end());
+    std::vector<BasicBlock*> succBBs = bb->getSucc();
+    for(BasicBlock* succBB : succBBs) {
+        bb->removeSucc(succBB);
+        nb->addSucc(succBB);
+        succBB->replacePhiPre(bb, nb);
+    }
+    bb->addSucc(nb);
+    if(!isReachable(function, bb)) return nb;
+    // 原来被 bb 支配的块都改由 nb 立即支配, 边界与 bb 相同
+    std::vector<BasicBlock*> children;
+    children.swap(bb->getDomTreeSuccNode());
+    for(BasicBlock* child : children) child->setIdom(nb);
+    nb->getDomTreeSuccNode() = children;
+    setTreeIdom(nb, bb);
+    nb->getDomFrontier() = bb->getDomFrontier();
+    renumberSubtree(function->getBB()[0]);
+    return nb;
+}
+
+// 在边 from->to 上插入新块, 用于拆关键边
+inline BasicBlock* DominateTree::splitEdge(Function* function, BasicBlock* from, BasicBlock* to) {
+    NormalBlock* nb = newBlockAfter(function, from);
+    nb->ir.push_back(new JumpIR(to));
+    from->replaceTarget(to, nb);
+    from->replaceSucc(to, nb);
+    nb->addSucc(to);
+    to->replacePhiPre(from, nb);
+    if(!isReachable(function, from)) return nb;
+    // to 的其他可达前驱都被 to 支配(回边)时, nb 成为 to 的立即支配点
+    bool supported = false;
+    for(BasicBlock* preBB : to->getPre()) {
+        if(preBB != nb && isReachable(function, preBB) && !to->dominates(preBB)) supported = true;
+    }
+    setTreeIdom(nb, from);
+    if(!supported) {
+        setTreeIdom(to, nb);
+        nb->getDomFrontier() = to->getDomFrontier();
+        std::vector<BasicBlock*>& df = nb->getDomFrontier();
+        df.erase(std::remove(df.begin(), df.end(), to), df.end());
+    } else {
+        nb->insertDomFrontier(to);
+    }
+    renumberSubtree(function->getBB()[0]);
+    return nb;
+}
 
-//     bb->insertDom(bb);
-//     genBBDom(bb->getIdom());
-// }
\ No newline at end of file
+#endif //SYSY2022_BJTU_DOMINATETREE_HH
\ No newline at end of file
@@ -0,0 +1,292 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_GVN_HH
+#define SYSY2022_BJTU_GVN_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+// 基于支配树的全局值编号
+// 沿支配树先序遍历, 表达式表按作用域进出, 只有支配当前块的计算可作为代表
+// 表达式按 (操作码, 操作数) 哈希, 可交换运算按操作数排序, a>b 化为 b<a
+// 覆盖整数/浮点运算, 一元运算, 类型转换和 GEP 地址计算
+// load 只在块内合并, 遇到 store、调用和数组 alloca 清空
+// 多次定值的变量不参与编号; 被合并的指令删除, 使用处改为代表值, phi 参数最后统一改写
+class GVN {
+private:
+    struct Expr {
+        int op;
+        int tag[2];
+        uint64_t bits[2];
+        bool operator==(const Expr& e) const {
+            return op == e.op && tag[0] == e.tag[0] && tag[1] == e.tag[1] && bits[0] == e.bits[0] && bits[1] == e.bits[1];
+        }
+    };
+    struct ExprHash {
+        size_t operator()(const Expr& e) const {
+            size_t h = e.op;
+            for(int i(0); i < 2; i++) {
+                h = h * 1000003 ^ e.tag[i];
+                h = h * 1000003 ^ std::hash<uint64_t>()(e.bits[i]);
+            }
+            return h;
+        }
+    };
+    enum { VAR = 1, INT_CONST, FLOAT_CONST };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    std::unordered_map<Expr, Value*, ExprHash> table;
+    std::vector<Expr> scopeLog;
+    std::unordered_map<Value*, Value*> loads;
+    // 以下按值的 num 索引, 表项存指针校验; num 重复的局部值记为 collide, 视作多次定值
+    std::vector<std::pair<Value*, Value*>> repl;
+    std::vector<std::pair<Value*, int>> defCnt;
+    Value* const collide = reinterpret_cast<Value*>(-1);
+    bool replaced;
+    std::vector<Use*> uses;
+
+    int removedCnt = 0;
+
+    void countDefs();
+    void visitBB(BasicBlock* bb);
+    bool numberExpr(Instruction* ir, Expr& expr);
+    bool encode(Use* use, int& tag, uint64_t& bits);
+    int getNum(Value* val) {
+        return val && val->getNum() >= 0 && val->getNum() < (int) defCnt.size() ? val->getNum() : -1;
+    }
+    // 函数内没有定值的(全局变量、参数)返回 0
+    int getDefCnt(Value* val) {
+        int num = getNum(val);
+        if(num < 0) return 0;
+        if(defCnt[num].first == collide) return 2;
+        return defCnt[num].first == val ? defCnt[num].second : 0;
+    }
+    Value* getRepl(Value* val) {
+        int num = getNum(val);
+        return num >= 0 && repl[num].first == val ? repl[num].second : nullptr;
+    }
+    void setRepl(Value* val, Value* to) {
+        repl[val->getNum()] = {val, to};
+        replaced = true;
+    }
+public:
+    GVN(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void execute();
+    int getRemovedCnt() { return removedCnt; }
+};
+
+inline void GVN::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        countDefs();
+        table.clear();
+        scopeLog.clear();
+        repl.assign(defCnt.size(), {nullptr, nullptr});
+        replaced = false;
+
+        // 支配树先序遍历, 出块时撤销本块加入的表达式
+        std::vector<std::pair<BasicBlock*, size_t>> work{{func->getBB()[0], 0}};
+        std::vector<size_t> scope{0};
+        visitBB(func->getBB()[0]);
+        while(!work.empty()) {
+            BasicBlock* bb = work.back().first;
+            size_t& next = work.back().second;
+            if(next < bb->getDomTreeSuccNode().size()) {
+                BasicBlock* child = bb->getDomTreeSuccNode()[next++];
+                scope.push_back(scopeLog.size());
+                visitBB(child);
+                work.push_back({child, 0});
+                continue;
+            }
+            while(scopeLog.size() > scope.back()) {
+                table.erase(scopeLog.back());
+                scopeLog.pop_back();
+            }
+            scope.pop_back();
+            work.pop_back();
+        }
+
+        if(!replaced) continue;
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(typeid(*ir) != typeid(PhiIR)) break;
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    if(!t || !t->getVal()) continue;
+                    Value* to = getRepl(t->getVal());
+                    if(to) t->setVal(to);
+                }
+            }
+        }
+    }
+}
+
+inline void GVN::countDefs() {
+    defCnt.assign(function->varCnt, {nullptr, 0});
+    for(auto bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            int num = getNum(getDefVal(ir));
+            if(num < 0) continue;
+            auto& entry = defCnt[num];
+            if(!entry.first || entry.first == getDefVal(ir)) {
+                entry = {getDefVal(ir), entry.second + 1};
+            } else {
+                entry.first = collide;
+            }
+        }
+    }
+}
+
+inline void GVN::visitBB(BasicBlock* bb) {
+    loads.clear();
+    for(auto ir : bb->getIr()) {
+        if(ir->isDeleted()) continue;
+        getUseOperands(ir, uses);
+        for(Use* use : uses) {
+            Value* val = getUseVal(use);
+            if(!val) continue;
+            Value* to = getRepl(val);
+            if(to) setUseVal(use, to);
+        }
+
+        const std::type_info& t = typeid(*ir);
+        if(t == typeid(StoreIIR) || t == typeid(StoreFIR) || t == typeid(CallIR)
+           || (dynamic_cast<AllocIR*>(ir) && dynamic_cast<AllocIR*>(ir)->isArray)) {
+            loads.clear();
+        }
+        if(t == typeid(PhiIR)) continue;
+        Value* dst = getDefVal(ir);
+        if(!dst || getDefCnt(dst) != 1) continue;
+
+        if(t == typeid(MoveIR)) {
+            // 单次定值变量间的拷贝直接传播
+            Value* src = getUseVal(ir->getOperands()[1]);
+            if(src && getDefCnt(src) <= 1 && src->getType()->isFloat() == dst->getType()->isFloat()) {
+                setRepl(dst, src);
+                ir->deleteIR();
+                removedCnt++;
+            }
+            continue;
+        }
+        if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) {
+            Value* addr = getUseVal(ir->getOperands()[1]);
+            if(!addr || getDefCnt(addr) > 1) continue;
+            auto it = loads.find(addr);
+            if(it != loads.end()) {
+                setRepl(dst, it->second);
+                ir->deleteIR();
+                removedCnt++;
+            } else {
+                loads[addr] = dst;
+            }
+            continue;
+        }
+        Expr expr;
+        if(!numberExpr(ir, expr)) continue;
+        auto it = table.find(expr);
+        if(it != table.end()) {
+            setRepl(dst, it->second);
+            ir->deleteIR();
+            removedCnt++;
+        } else {
+            table[expr] = dst;
+            scopeLog.push_back(expr);
+        }
+    }
+}
+
+// 操作数编码, 变量为指针, 常量为值的位模式; 多次定值的变量返回 false
+inline bool GVN::encode(Use* use, int& tag, uint64_t& bits) {
+    Value* val = use ? use->getVal() : nullptr;
+    tag = 0;
+    bits = 0;
+    if(!val) return true;
+    if(typeid(*val) == typeid(TempVal) && !dynamic_cast<TempVal*>(val)->getVal()) {
+        TempVal* c = dynamic_cast<TempVal*>(val);
+        if(c->isFloat()) {
+            float f = c->getFloat();
+            uint32_t u;
+            memcpy(&u, &f, sizeof(u));
+            tag = FLOAT_CONST;
+            bits = u;
+        } else {
+            tag = INT_CONST;
+            bits = (uint32_t) c->getInt();
+        }
+        return true;
+    }
+    val = getUseVal(use);
+    if(getDefCnt(val) > 1) return false;
+    tag = VAR;
+    bits = (uint64_t) (uintptr_t) val;
+    return true;
+}
+
+// 生成表达式, 不能编号的指令返回 false
+inline bool GVN::numberExpr(Instruction* ir, Expr& expr) {
+    // 可交换的运算和可交换操作数的比较共用一个操作码
+    static const std::vector<std::pair<const std::type_info*, int>> binOps = {
+        {&typeid(AddIIR), 1}, {&typeid(SubIIR), 2}, {&typeid(MulIIR), 3}, {&typeid(DivIIR), 4},
+        {&typeid(ModIR), 5}, {&typeid(LTIIR), 6}, {&typeid(GTIIR), -6}, {&typeid(LEIIR), 7},
+        {&typeid(GEIIR), -7}, {&typeid(EQUIIR), 8}, {&typeid(NEIIR), 9},
+        {&typeid(AddFIR), 11}, {&typeid(SubFIR), 12}, {&typeid(MulFIR), 13}, {&typeid(DivFIR), 14},
+        {&typeid(LTFIR), 16}, {&typeid(GTFIR), -16}, {&typeid(LEFIR), 17}, {&typeid(GEFIR), -17},
+        {&typeid(EQUFIR), 18}, {&typeid(NEFIR), 19}, {&typeid(ShlIR), 27},
+    };
+    const std::type_info& t = typeid(*ir);
+    auto& operands = ir->getOperands();
+    if(dynamic_cast<ArithmeticIR*>(ir)) {
+        int op = 0;
+        for(auto& item : binOps) {
+            if(*item.first == t) op = item.second;
+        }
+        if(!op) return false;
+        int a = 1, b = 2;
+        if(op < 0) {
+            std::swap(a, b);
+            op = -op;
+        }
+        expr.op = op;
+        if(!encode(operands[a], expr.tag[0], expr.bits[0]) || !encode(operands[b], expr.tag[1], expr.bits[1])) return false;
+        bool commutative = op == 1 || op == 3 || op == 8 || op == 9 || op == 11 || op == 13 || op == 18 || op == 19;
+        if(commutative && std::make_pair(expr.tag[1], expr.bits[1]) < std::make_pair(expr.tag[0], expr.bits[0])) {
+            std::swap(expr.tag[0], expr.tag[1]);
+            std::swap(expr.bits[0], expr.bits[1]);
+        }
+        return true;
+    }
+    if(t == typeid(UnaryIR)) {
+        UnaryIR* unaryIr = dynamic_cast<UnaryIR*>(ir);
+        expr.op = 20 + (unaryIr->op == OP::NEG ? 0 : 1) + (unaryIr->res.isFloat() ? 2 : 0);
+        expr.tag[1] = 0;
+        expr.bits[1] = 0;
+        return encode(operands[1], expr.tag[0], expr.bits[0]);
+    }
+    if(t == typeid(CastInt2FloatIR) || t == typeid(CastFloat2IntIR)) {
+        expr.op = t == typeid(CastInt2FloatIR) ? 24 : 25;
+        expr.tag[1] = 0;
+        expr.bits[1] = 0;
+        return encode(operands[1], expr.tag[0], expr.bits[0]);
+    }
+    if(t == typeid(GEPIR)) {
+        // 下标为变量或常数偏移
+        expr.op = 26;
+        if(!encode(operands[1], expr.tag[0], expr.bits[0])) return false;
+        if(operands[2]->getVal()) return encode(operands[2], expr.tag[1], expr.bits[1]);
+        expr.tag[1] = INT_CONST;
+        expr.bits[1] = (uint32_t) dynamic_cast<GEPIR*>(ir)->arrayLen;
+        return true;
+    }
+    return false;
+}
+
+#endif //SYSY2022_BJTU_GVN_HH
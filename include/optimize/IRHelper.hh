@@ -0,0 +1,366 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_IRHELPER_HH
+#define SYSY2022_BJTU_IRHELPER_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include <vector>
+#include <unordered_map>
+
+// 优化遍共用的指令工具
+// 操作数以 Operands 为准, 修改后由 moveBackOperand 写回指令字段
+// TempVal 字段的 Use 指向字段本身, 其余 Use 保存的是拷贝
+
+// 指令定义的变量, TempVal 取其 val, 没有定义返回 nullptr
+inline Value* getDefVal(Instruction* ir) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(StoreIIR) || t == typeid(StoreFIR) || t == typeid(ReturnIR) || t == typeid(BranchIR) || t == typeid(JumpIR)
+       || ir->getOperands().empty()) {
+        return nullptr;
+    }
+    Value* val = ir->getOperands()[0]->getVal();
+    if(val && typeid(*val) == typeid(TempVal)) return dynamic_cast<TempVal*>(val)->getVal();
+    return val;
+}
+
+// 指令读取操作数的位置, 不含 phi 参数
+inline void getUseOperands(Instruction* ir, std::vector<Use*>& uses) {
+    uses.clear();
+    auto& operands = ir->getOperands();
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(PhiIR) || dynamic_cast<AllocIR*>(ir)) return;
+    size_t begin = (t == typeid(StoreIIR) || t == typeid(StoreFIR)) ? 0 : 1;
+    for(size_t i(begin); i < operands.size(); i++) {
+        uses.push_back(operands[i]);
+    }
+}
+
+// use 位置上的变量, TempVal 取其 val, 常量和空位置返回 nullptr
+inline Value* getUseVal(Use* use) {
+    Value* val = use->getVal();
+    if(val && typeid(*val) == typeid(TempVal)) return dynamic_cast<TempVal*>(val)->getVal();
+    return val;
+}
+
+// 把 use 位置上的变量换成 val (val 为变量而非常量)
+inline void setUseVal(Use* use, Value* val) {
+    Value* old = use->getVal();
+    if(old && typeid(*old) == typeid(TempVal)) {
+        dynamic_cast<TempVal*>(old)->setVal(val);
+    } else {
+        use->setVal(val);
+    }
+}
+
+// 把常量转成类型 t, 指针按 int 处理
+inline TempVal* castConst(TempVal* c, Type* t) {
+    TempVal* res = new TempVal();
+    if(t->isFloat()) {
+        res->setType(new Type(TypeID::FLOAT));
+        res->setFloat(c->getType()->isFloat() ? c->getFloat() : c->getInt());
+    } else {
+        res->setType(new Type(TypeID::INT));
+        res->setInt(c->getType()->isFloat() ? (int) c->getFloat() : c->getInt());
+    }
+    return res;
+}
+
+// 包装变量, 用作 phi 参数和 MoveIR 的源
+inline TempVal* wrapVal(Value* val) {
+    TempVal* res = new TempVal();
+    res->setVal(val);
+    res->setType(val->getType());
+    return res;
+}
+
+// 整数常量, 超出 int 的部分截断, 调用方先检查范围
+inline TempVal intConst(long long x) {
+    TempVal c;
+    c.setType(new Type(TypeID::INT));
+    c.setInt((int) x);
+    return c;
+}
+
+// 按类型新建同类的二元运算
+inline ArithmeticIR* newArithmetic(const std::type_info& t, TempVal res, TempVal left, TempVal right) {
+    if(t == typeid(AddIIR)) return new AddIIR(res, left, right);
+    if(t == typeid(AddFIR)) return new AddFIR(res, left, right);
+    if(t == typeid(SubIIR)) return new SubIIR(res, left, right);
+    if(t == typeid(SubFIR)) return new SubFIR(res, left, right);
+    if(t == typeid(MulIIR)) return new MulIIR(res, left, right);
+    if(t == typeid(MulFIR)) return new MulFIR(res, left, right);
+    if(t == typeid(DivIIR)) return new DivIIR(res, left, right);
+    if(t == typeid(DivFIR)) return new DivFIR(res, left, right);
+    if(t == typeid(ModIR)) return new ModIR(res, left, right);
+    if(t == typeid(ShlIR)) return new ShlIR(res, left, right);
+    if(t == typeid(LTIIR)) return new LTIIR(res, left, right);
+    if(t == typeid(LTFIR)) return new LTFIR(res, left, right);
+    if(t == typeid(LEIIR)) return new LEIIR(res, left, right);
+    if(t == typeid(LEFIR)) return new LEFIR(res, left, right);
+    if(t == typeid(GTIIR)) return new GTIIR(res, left, right);
+    if(t == typeid(GTFIR)) return new GTFIR(res, left, right);
+    if(t == typeid(GEIIR)) return new GEIIR(res, left, right);
+    if(t == typeid(GEFIR)) return new GEFIR(res, left, right);
+    if(t == typeid(EQUIIR)) return new EQUIIR(res, left, right);
+    if(t == typeid(EQUFIR)) return new EQUFIR(res, left, right);
+    if(t == typeid(NEIIR)) return new NEIIR(res, left, right);
+    if(t == typeid(NEFIR)) return new NEFIR(res, left, right);
+    return nullptr;
+}
+
+// 新建和 val 同类型、同数组形状的变量
+inline Value* cloneVar(Value* val, Function* function) {
+    Value* res = new VarValue("", val->getType(), false, function->varCnt++);
+    res->setArray(val->is_Array());
+    res->setArrayDims(val->getArrayDims());
+    return res;
+}
+
+// 复制指令, 操作数取自 Operands: 变量按 valMap 替换(不在表中的不变), 跳转目标和 phi 前驱按 bbMap 替换
+inline Instruction* cloneIR(Instruction* ir, std::unordered_map<Value*, Value*>& valMap,
+                            std::unordered_map<BasicBlock*, BasicBlock*>& bbMap) {
+    auto mapVar = [&](Value* val) -> Value* {
+        auto it = valMap.find(val);
+        return it == valMap.end() ? val : it->second;
+    };
+    auto mapBB = [&](BasicBlock* bb) {
+        auto it = bbMap.find(bb);
+        return it == bbMap.end() ? bb : it->second;
+    };
+    // TempVal 复制一份再替换其中的变量
+    auto mapTemp = [&](Value* val) {
+        TempVal res = *dynamic_cast<TempVal*>(val);
+        if(res.getVal()) res.setVal(mapVar(res.getVal()));
+        return res;
+    };
+    auto mapVal = [&](Value* val) -> Value* {
+        if(!val) return nullptr;
+        if(typeid(*val) == typeid(TempVal)) return new TempVal(mapTemp(val));
+        return mapVar(val);
+    };
+    auto& operands = ir->getOperands();
+    const std::type_info& t = typeid(*ir);
+    if(dynamic_cast<ArithmeticIR*>(ir)) {
+        ArithmeticIR* res = newArithmetic(t, mapTemp(operands[0]->getVal()), mapTemp(operands[1]->getVal()), mapTemp(operands[2]->getVal()));
+        res->nonNegative = dynamic_cast<ArithmeticIR*>(ir)->nonNegative;
+        return res;
+    }
+    if(t == typeid(MoveIR)) return new MoveIR(mapVal(operands[0]->getVal()), mapVal(operands[1]->getVal()));
+    if(t == typeid(AllocIIR) || t == typeid(AllocFIR)) {
+        AllocIR* allocIr = dynamic_cast<AllocIR*>(ir);
+        Value* v = mapVal(operands[0]->getVal());
+        AllocIR* res;
+        if(t == typeid(AllocIIR)) {
+            res = allocIr->isArray ? static_cast<AllocIR*>(new AllocIIR(v, allocIr->arrayLen)) : new AllocIIR(v);
+        } else {
+            res = allocIr->isArray ? static_cast<AllocIR*>(new AllocFIR(v, allocIr->arrayLen)) : new AllocFIR(v);
+        }
+        res->arrayLen = allocIr->arrayLen;
+        res->zeroBegin = allocIr->zeroBegin;
+        res->zeroEnd = allocIr->zeroEnd;
+        return res;
+    }
+    if(t == typeid(LoadIIR)) return new LoadIIR(mapVal(operands[0]->getVal()), mapVal(operands[1]->getVal()));
+    if(t == typeid(LoadFIR)) return new LoadFIR(mapVal(operands[0]->getVal()), mapVal(operands[1]->getVal()));
+    if(t == typeid(StoreIIR)) return new StoreIIR(mapVal(operands[0]->getVal()), mapTemp(operands[1]->getVal()));
+    if(t == typeid(StoreFIR)) return new StoreFIR(mapVal(operands[0]->getVal()), mapTemp(operands[1]->getVal()));
+    if(t == typeid(CastInt2FloatIR)) return new CastInt2FloatIR(mapVal(operands[0]->getVal()), mapVal(operands[1]->getVal()));
+    if(t == typeid(CastFloat2IntIR)) return new CastFloat2IntIR(mapVal(operands[0]->getVal()), mapVal(operands[1]->getVal()));
+    if(t == typeid(UnaryIR)) {
+        return new UnaryIR(mapTemp(operands[0]->getVal()), mapTemp(operands[1]->getVal()), dynamic_cast<UnaryIR*>(ir)->op);
+    }
+    if(t == typeid(ReturnIR)) {
+        ReturnIR* returnIr = dynamic_cast<ReturnIR*>(ir);
+        Value* v = operands[1]->getVal();
+        if(v) return new ReturnIR(mapVal(v));
+        if(returnIr->useInt) return new ReturnIR(returnIr->retInt);
+        if(returnIr->useFloat) return new ReturnIR(returnIr->retFloat);
+        return new ReturnIR((Value*) nullptr);
+    }
+    if(t == typeid(JumpIR)) return new JumpIR(mapBB(dynamic_cast<JumpIR*>(ir)->target));
+    if(t == typeid(BranchIR)) {
+        BranchIR* branchIr = dynamic_cast<BranchIR*>(ir);
+        return new BranchIR(mapBB(branchIr->trueTarget), mapBB(branchIr->falseTarget), mapVal(operands[1]->getVal()));
+    }
+    if(t == typeid(GEPIR)) {
+        Value* v1 = mapVal(operands[0]->getVal());
+        Value* v2 = mapVal(operands[1]->getVal());
+        if(!operands[2]->getVal()) return new GEPIR(v1, v2, dynamic_cast<GEPIR*>(ir)->arrayLen);
+        return new GEPIR(v1, v2, mapVal(operands[2]->getVal()));
+    }
+    if(t == typeid(CallIR)) {
+        CallIR* callIr = dynamic_cast<CallIR*>(ir);
+        std::vector<TempVal> args;
+        for(size_t i(1); i < operands.size(); i++) {
+            args.push_back(mapTemp(operands[i]->getVal()));
+        }
+        Value* returnVal = operands[0]->getVal();
+        return returnVal ? new CallIR(callIr->func, args, mapVal(returnVal)) : new CallIR(callIr->func, args);
+    }
+    if(t == typeid(PhiIR)) {
+        PhiIR* res = new PhiIR({}, mapVal(operands[0]->getVal()));
+        for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+            res->params[mapBB(param.first)] = mapVal(param.second);
+        }
+        return res;
+    }
+    return nullptr;
+}
+
+// 按值的 num 索引的定值块和使用者, 表项存指针校验; 多次定值的值为 collide, irBB 为指令所在的块
+// 之后新建的指令用 record 登记, 新值的 num 超出表的范围时扩表
+struct DefUseTable {
+    std::vector<std::pair<Value*, BasicBlock*>> defBB;
+    std::vector<std::vector<Instruction*>> users;
+    std::unordered_map<Instruction*, BasicBlock*> irBB;
+    Value* const collide = reinterpret_cast<Value*>(-1);
+
+    void build(Function* function);
+    void record(Instruction* ir, BasicBlock* bb);
+    void addUser(Value* val, Instruction* ir);
+private:
+    Function* function = nullptr;
+    std::vector<Use*> uses;
+    void addUses(Instruction* ir);
+    bool fits(Value* val);
+};
+
+inline void DefUseTable::build(Function* function) {
+    this->function = function;
+    defBB.assign(function->varCnt, {nullptr, nullptr});
+    users.assign(function->varCnt, {});
+    irBB.clear();
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            irBB[ir] = bb;
+            Value* dst = getDefVal(ir);
+            if(dst && fits(dst)) {
+                auto& entry = defBB[dst->getNum()];
+                entry = {entry.first ? collide : dst, bb};
+            }
+            addUses(ir);
+        }
+    }
+}
+
+inline void DefUseTable::record(Instruction* ir, BasicBlock* bb) {
+    irBB[ir] = bb;
+    Value* dst = getDefVal(ir);
+    if(dst && fits(dst)) defBB[dst->getNum()] = {dst, bb};
+    addUses(ir);
+}
+
+inline void DefUseTable::addUser(Value* val, Instruction* ir) {
+    if(val && fits(val)) users[val->getNum()].push_back(ir);
+}
+
+inline void DefUseTable::addUses(Instruction* ir) {
+    if(typeid(*ir) == typeid(PhiIR)) {
+        for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+            TempVal* t = dynamic_cast<TempVal*>(param.second);
+            addUser(t ? t->getVal() : param.second, ir);
+        }
+        return;
+    }
+    getUseOperands(ir, uses);
+    for(Use* use : uses) {
+        addUser(getUseVal(use), ir);
+    }
+}
+
+inline bool DefUseTable::fits(Value* val) {
+    if(val->getNum() < 0) return false;
+    if(val->getNum() >= (int) defBB.size()) {
+        defBB.resize(function->varCnt, {nullptr, nullptr});
+        users.resize(function->varCnt);
+    }
+    return val->getNum() < (int) defBB.size();
+}
+
+// 沿替换表找到 val 最终被替换成的变量
+inline Value* resolveVal(std::unordered_map<Value*, Value*>& valMap, Value* val) {
+    for(int depth(0); val && depth < 1024; depth++) {
+        auto it = valMap.find(val);
+        if(it == valMap.end()) return val;
+        val = it->second;
+    }
+    return val;
+}
+
+// 按替换表改写函数中所有的使用, 包括 phi 参数
+inline void applyValMap(Function* function, std::unordered_map<Value*, Value*>& valMap) {
+    std::vector<Use*> uses;
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    if(t && t->getVal()) t->setVal(resolveVal(valMap, t->getVal()));
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                Value* val = getUseVal(use);
+                if(val && valMap.count(val)) setUseVal(use, resolveVal(valMap, val));
+            }
+        }
+    }
+}
+
+// 不读写程序内存的库函数(输入输出标量、计时)
+inline bool isMemFreeLibFunc(Function* func) {
+    static const char* names[] = {"getint", "getch", "getfloat", "putint", "putch", "putfloat", "putf",
+                                  "_sysy_starttime", "_sysy_stoptime"};
+    if(!func->getBB().empty()) return false;
+    for(const char* name : names) {
+        if(func->name == name) return true;
+    }
+    return false;
+}
+
+// 删除入口不可达的块, 并从后继的前驱表中去掉, 返回是否有改动
+inline bool removeUnreachableBB(Function* function) {
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    function->renumberBB();
+    std::vector<bool> reach(bbs.size(), false);
+    std::vector<BasicBlock*> work{bbs[0]};
+    reach[0] = true;
+    while(!work.empty()) {
+        BasicBlock* bb = work.back();
+        work.pop_back();
+        for(BasicBlock* succBB : bb->getSucc()) {
+            if(!reach[succBB->getId()]) {
+                reach[succBB->getId()] = true;
+                work.push_back(succBB);
+            }
+        }
+    }
+    if(std::find(reach.begin(), reach.end(), false) == reach.end()) return false;
+
+    std::vector<BasicBlock*> kept;
+    for(BasicBlock* bb : bbs) {
+        if(reach[bb->getId()]) {
+            kept.push_back(bb);
+            continue;
+        }
+        while(!bb->getSucc().empty()) {
+            BasicBlock* succBB = bb->getSucc().back();
+            bb->removeSucc(succBB);
+            for(auto ir : succBB->getIr()) {
+                if(typeid(*ir) != typeid(PhiIR)) break;
+                dynamic_cast<PhiIR*>(ir)->params.erase(bb);
+            }
+        }
+    }
+    bbs.swap(kept);
+    function->renumberBB();
+    return true;
+}
+
+#endif //SYSY2022_BJTU_IRHELPER_HH
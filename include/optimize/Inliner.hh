@@ -0,0 +1,296 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_INLINER_HH
+#define SYSY2022_BJTU_INLINER_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "LoopInfo.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+// 函数内联, 在 Mem2reg 之后的 SSA 上做
+// 调用图按强连通分量自底向上处理, 被调函数先内联完; 同一分量内(递归)的调用不内联
+// 代价: 被调函数的指令数不超过阈值, 常量实参、循环内的调用、唯一调用点各有加成;
+// 每个调用者的增长不超过 maxGrowth 条指令(-finline-growth=)
+// 调用点所在块在调用处切开, 被调函数的块复制到两半之间, 返回改为跳到后半块, 多个返回值用 phi 合并
+class Inliner {
+private:
+    struct CallSite {
+        BasicBlock* bb;
+        CallIR* call;
+        bool inLoop;
+    };
+
+    IrVisitor* irVisitor;
+    DominateTree dominateTree;
+    LoopInfo loopInfo;
+    int maxGrowth;
+
+    std::unordered_map<Function*, int> sizes;
+    std::unordered_map<Function*, bool> inlinable;
+    std::unordered_map<Function*, std::vector<Function*>> callees;
+    std::unordered_map<Function*, int> callCnt;
+    // Tarjan 求强连通分量, 出栈顺序即被调者在前
+    std::unordered_map<Function*, int> dfn;
+    std::unordered_map<Function*, int> low;
+    std::vector<Function*> stack;
+    std::unordered_set<Function*> onStack;
+    std::vector<std::vector<Function*>> sccs;
+    int dfnCnt = 0;
+
+    static const int baseThreshold = 40;
+    static const int constArgBonus = 15;
+    static const int loopBonus = 60;
+    static const int singleCallBonus = 100;
+    // 被调函数局部数组的总长度上限, 防止栈空间随内联膨胀
+    static const int maxArrayLen = 1024;
+
+    int inlinedCnt = 0;
+    int callerCnt = 0;
+
+    void buildCallGraph();
+    void tarjan(Function* func);
+    void inlineCalls(Function* func, std::unordered_set<Function*>& scc);
+    void inlineCall(Function* func, BasicBlock* bb, CallIR* call);
+    int threshold(CallSite& site);
+public:
+    Inliner(IrVisitor* irVisitor, int maxGrowth = 1000)
+        : irVisitor(irVisitor), dominateTree(irVisitor), maxGrowth(maxGrowth) {;}
+    void execute();
+    int getInlinedCnt() { return inlinedCnt; }
+    int getCallerCnt() { return callerCnt; }
+};
+
+inline void Inliner::execute() {
+    buildCallGraph();
+    for(Function* func : irVisitor->getFunctions()) {
+        if(!func->getBB().empty() && !dfn.count(func)) tarjan(func);
+    }
+    for(auto& scc : sccs) {
+        std::unordered_set<Function*> members(scc.begin(), scc.end());
+        for(Function* func : scc) {
+            inlineCalls(func, members);
+        }
+    }
+}
+
+// 调用边、规模和能否内联
+inline void Inliner::buildCallGraph() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        int size = 0, arrayLen = 0;
+        bool ok = !func->variant_params, hasReturn = false;
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                size++;
+                const std::type_info& t = typeid(*ir);
+                if(t == typeid(BreakIR) || t == typeid(ContinueIR)) ok = false;
+                if(t == typeid(ReturnIR)) hasReturn = true;
+                if(dynamic_cast<AllocIR*>(ir)) arrayLen += dynamic_cast<AllocIR*>(ir)->arrayLen;
+                if(t == typeid(CallIR)) {
+                    Function* callee = dynamic_cast<CallIR*>(ir)->func;
+                    if(callee->getBB().empty()) continue;
+                    callees[func].push_back(callee);
+                    callCnt[callee]++;
+                }
+            }
+        }
+        sizes[func] = size;
+        inlinable[func] = ok && hasReturn && arrayLen <= maxArrayLen;
+    }
+}
+
+inline void Inliner::tarjan(Function* func) {
+    dfn[func] = low[func] = dfnCnt++;
+    stack.push_back(func);
+    onStack.insert(func);
+    for(Function* callee : callees[func]) {
+        if(!dfn.count(callee)) {
+            tarjan(callee);
+            low[func] = std::min(low[func], low[callee]);
+        } else if(onStack.count(callee)) {
+            low[func] = std::min(low[func], dfn[callee]);
+        }
+    }
+    if(low[func] != dfn[func]) return;
+    std::vector<Function*> scc;
+    Function* top;
+    do {
+        top = stack.back();
+        stack.pop_back();
+        onStack.erase(top);
+        scc.push_back(top);
+    } while(top != func);
+    sccs.push_back(scc);
+}
+
+inline int Inliner::threshold(CallSite& site) {
+    int res = baseThreshold;
+    auto& operands = site.call->getOperands();
+    for(size_t i(1); i < operands.size(); i++) {
+        TempVal* arg = dynamic_cast<TempVal*>(operands[i]->getVal());
+        if(arg && !arg->getVal()) res += constArgBonus;
+    }
+    if(site.inLoop) res += loopBonus;
+    if(callCnt[site.call->func] == 1) res += singleCallBonus;
+    return res;
+}
+
+inline void Inliner::inlineCalls(Function* func, std::unordered_set<Function*>& scc) {
+    // 调用点先全部收集, 同一块内从后往前内联, 前面的调用仍留在原块
+    loopInfo.analyze(func);
+    std::vector<CallSite> sites;
+    for(BasicBlock* bb : func->getBB()) {
+        auto& irs = bb->getIr();
+        for(auto it = irs.rbegin(); it != irs.rend(); it++) {
+            if((*it)->isDeleted() || typeid(**it) != typeid(CallIR)) continue;
+            CallIR* call = dynamic_cast<CallIR*>(*it);
+            if(call->func->getBB().empty() || scc.count(call->func) || !inlinable[call->func]) continue;
+            sites.push_back({bb, call, loopInfo.getDepth(bb) > 0});
+        }
+    }
+    int budget = maxGrowth;
+    bool changed = false;
+    for(CallSite& site : sites) {
+        int size = sizes[site.call->func];
+        if(size > threshold(site) || size > budget) continue;
+        inlineCall(func, site.bb, site.call);
+        budget -= size;
+        sizes[func] += size;
+        inlinedCnt++;
+        changed = true;
+    }
+    if(!changed) return;
+    callerCnt++;
+    func->renumberBB();
+    dominateTree.getIdom(func);
+    dominateTree.getDomFront(func);
+    dominateTree.genDominateTree(func);
+}
+
+inline void Inliner::inlineCall(Function* func, BasicBlock* bb, CallIR* call) {
+    Function* callee = call->func;
+    auto& irs = bb->getIr();
+    auto pos = std::find(irs.begin(), irs.end(), call);
+
+    // 调用之后的指令和出边移到后半块
+    BasicBlock* after = new NormalBlock(nullptr, func->name, func->bbCnt++);
+    after->getIr().assign(pos + 1, irs.end());
+    irs.erase(pos, irs.end());
+    std::vector<BasicBlock*> succs = bb->getSucc();
+    for(BasicBlock* succBB : succs) {
+        bb->removeSucc(succBB);
+        after->addSucc(succBB);
+        succBB->replacePhiPre(bb, after);
+    }
+
+    // 形参换成实参, 常量实参先放进变量
+    std::unordered_map<Value*, Value*> valMap;
+    auto& operands = call->getOperands();
+    for(size_t i(0); i < callee->params.size(); i++) {
+        Value* param = callee->params[i];
+        TempVal* arg = dynamic_cast<TempVal*>(operands[i + 1]->getVal());
+        if(arg->getVal()) {
+            valMap[param] = arg->getVal();
+        } else {
+            Value* dst = cloneVar(param, func);
+            irs.push_back(new MoveIR(dst, castConst(arg, param->getType())));
+            valMap[param] = dst;
+        }
+    }
+
+    // 复制被调函数的块
+    std::unordered_map<BasicBlock*, BasicBlock*> bbMap;
+    std::vector<BasicBlock*> copies;
+    for(BasicBlock* calleeBB : callee->getBB()) {
+        BasicBlock* nb = new NormalBlock(nullptr, func->name, func->bbCnt++);
+        bbMap[calleeBB] = nb;
+        copies.push_back(nb);
+        for(auto ir : calleeBB->getIr()) {
+            if(ir->isDeleted()) continue;
+            Value* dst = getDefVal(ir);
+            if(dst) valMap[dst] = cloneVar(dst, func);
+        }
+    }
+    Value* res = getDefVal(call);
+    std::vector<std::pair<BasicBlock*, TempVal*>> rets;
+    for(BasicBlock* calleeBB : callee->getBB()) {
+        BasicBlock* nb = bbMap[calleeBB];
+        bool returned = false;
+        for(auto ir : calleeBB->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) != typeid(ReturnIR)) {
+                nb->getIr().push_back(cloneIR(ir, valMap, bbMap));
+                continue;
+            }
+            // 返回值先取出来, 返回改为跳到后半块
+            ReturnIR* returnIr = dynamic_cast<ReturnIR*>(ir);
+            Value* v = ir->getOperands()[1]->getVal();
+            TempVal* val = nullptr;
+            if(v && typeid(*v) == typeid(TempVal)) {
+                val = new TempVal(*dynamic_cast<TempVal*>(v));
+                if(val->getVal()) val->setVal(valMap.count(val->getVal()) ? valMap[val->getVal()] : val->getVal());
+            } else if(v) {
+                val = wrapVal(valMap.count(v) ? valMap[v] : v);
+            } else if(returnIr->useInt || returnIr->useFloat) {
+                val = new TempVal();
+                val->setType(new Type(returnIr->useInt ? TypeID::INT : TypeID::FLOAT));
+                if(returnIr->useInt) val->setInt(returnIr->retInt);
+                else val->setFloat(returnIr->retFloat);
+            }
+            if(res && val && !val->getVal()) val = castConst(val, res->getType());
+            rets.push_back({nb, val});
+            nb->getIr().push_back(new JumpIR(after));
+            returned = true;
+            break;
+        }
+        for(BasicBlock* succBB : calleeBB->getSucc()) {
+            nb->addSucc(bbMap[succBB]);
+        }
+        // 落到函数末尾的块同样回到后半块
+        if(!returned && calleeBB->getSucc().empty()) {
+            nb->getIr().push_back(new JumpIR(after));
+            rets.push_back({nb, nullptr});
+        }
+        if(nb->getSucc().empty()) nb->addSucc(after);
+    }
+    irs.push_back(new JumpIR(copies[0]));
+    bb->addSucc(copies[0]);
+
+    // 返回值: 一处返回直接赋值, 多处用 phi 合并
+    if(res) {
+        auto valueOf = [&](TempVal* val) {
+            if(val) return val;
+            TempVal* zero = new TempVal();
+            zero->setType(new Type(TypeID::INT));
+            zero->setInt(0);
+            return castConst(zero, res->getType());
+        };
+        if(rets.size() == 1) {
+            auto& retIrs = rets[0].first->getIr();
+            retIrs.insert(retIrs.end() - 1, new MoveIR(res, valueOf(rets[0].second)));
+        } else {
+            PhiIR* phi = new PhiIR({}, res);
+            for(auto& ret : rets) {
+                phi->params[ret.first] = valueOf(ret.second);
+            }
+            after->getIr().insert(after->getIr().begin(), phi);
+        }
+    }
+
+    // 被调函数的块和后半块接在原块之后, 原块的顺序落入关系不变
+    auto& bbs = func->getBB();
+    auto it = std::find(bbs.begin(), bbs.end(), bb) + 1;
+    copies.push_back(after);
+    bbs.insert(it, copies.begin(), copies.end());
+}
+
+#endif //SYSY2022_BJTU_INLINER_HH
@@ -0,0 +1,633 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_INSTCOMBINE_HH
+#define SYSY2022_BJTU_INSTCOMBINE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <deque>
+#include <climits>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+// 指令合并, 在 SSA 上做的窥孔化简, 不改 CFG
+// 工作表驱动: 指令改动后把它和结果的使用者重新加入, 直到不动点
+// 规则: 常量折叠和代入、交换律/比较把常量放到右边、恒等式(x+0, x*1, x-x, x/x ...)、
+// 常量重结合((x+c1)+c2, (x*c1)*c2, (x+c1)==c2)、取负折叠、布尔值和 NOT 链化简, lowerShifts 时 x*2^k 换成移位
+// 整数按 32 位补码回绕; 浮点只用精确成立的恒等式(x*1.0, x-0.0, x-(-y) 等)
+// x/x、x%x 只在整数上化简, 除数为 0 时程序行为未定义
+class InstCombine {
+public:
+    enum Rule { FOLD, CANON, IDENTITY, REASSOC, NEGATE, BOOLEAN, SHIFT, DEAD, RULE_CNT };
+private:
+    IrVisitor* irVisitor;
+    Function* function;
+    bool lowerShifts;
+
+    std::unordered_map<Value*, Instruction*> defIr;
+    std::unordered_map<Value*, int> defCnt;
+    std::unordered_map<Value*, std::vector<Instruction*>> users;
+    std::unordered_map<Instruction*, std::pair<BasicBlock*, size_t>> pos;
+    // 定值为常量的变量 -> 常量
+    std::unordered_map<Value*, TempVal*> constMap;
+    std::deque<Instruction*> work;
+    std::unordered_set<Instruction*> inWork;
+    std::vector<Use*> uses;
+
+    int hits[RULE_CNT] = {};
+
+    void build();
+    void push(Instruction* ir);
+    void pushUsers(Value* val);
+    void addUsers(Instruction* ir);
+    bool visitArithmetic(ArithmeticIR* ir);
+    bool visitUnary(UnaryIR* ir);
+    bool substitute(ArithmeticIR* ir);
+    // 用 ir 替换 old 在块中的位置
+    void replaceIR(Instruction* old, Instruction* ir);
+    // old 的结果换成变量 val, 删掉 old
+    void replaceVal(Instruction* old, Value* val);
+    void replaceConst(Instruction* old, TempVal c);
+    void removeDead();
+
+    // 单次定值且未删除的定值指令
+    Instruction* getDef(Value* val) {
+        auto it = defIr.find(val);
+        if(!val || it == defIr.end() || defCnt[val] != 1 || it->second->isDeleted()) return nullptr;
+        return it->second;
+    }
+    // 在不同位置取值相同的变量
+    bool isStable(Value* val) { return val && !val->is_Global() && defCnt[val] <= 1; }
+    bool isBoolean(Value* val);
+    static TempVal* operand(Instruction* ir, int k) { return dynamic_cast<TempVal*>(ir->getOperands()[k]->getVal()); }
+    static bool isIntConst(TempVal* v, int c) { return !v->getVal() && v->isInt() && v->getInt() == c; }
+    static bool isFloatConst(TempVal* v, float c) { return !v->getVal() && v->isFloat() && v->getFloat() == c; }
+    static TempVal varTemp(Value* val);
+    static TempVal intTemp(int c);
+    static bool foldInt(const std::type_info& t, int x, int y, int& res);
+    static bool isFloatOp(const std::type_info& t);
+    static bool isCompare(const std::type_info& t);
+    static bool isCommutative(const std::type_info& t);
+    static const std::type_info* mirror(const std::type_info& t);
+    static const std::type_info* inverse(const std::type_info& t);
+public:
+    InstCombine(IrVisitor* irVisitor, bool lowerShifts = false) : irVisitor(irVisitor), lowerShifts(lowerShifts) {;}
+    void execute();
+    int getHitCnt(Rule rule) { return hits[rule]; }
+    int getTotalCnt();
+    // 输出命中过的规则, 如 " identity 3, fold 2"
+    void printHits(std::ostream& out);
+};
+
+inline void InstCombine::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        build();
+        size_t steps = 0, maxSteps = work.size() * 8 + 1024;
+        while(!work.empty() && steps++ < maxSteps) {
+            Instruction* ir = work.front();
+            work.pop_front();
+            inWork.erase(ir);
+            if(ir->isDeleted()) continue;
+            if(dynamic_cast<ArithmeticIR*>(ir)) visitArithmetic(dynamic_cast<ArithmeticIR*>(ir));
+            else if(typeid(*ir) == typeid(UnaryIR)) visitUnary(dynamic_cast<UnaryIR*>(ir));
+        }
+        work.clear();
+        inWork.clear();
+        removeDead();
+    }
+}
+
+inline void InstCombine::build() {
+    defIr.clear();
+    defCnt.clear();
+    users.clear();
+    pos.clear();
+    constMap.clear();
+    for(BasicBlock* bb : function->getBB()) {
+        auto& irs = bb->getIr();
+        for(size_t i(0); i < irs.size(); i++) {
+            Instruction* ir = irs[i];
+            if(ir->isDeleted()) continue;
+            pos[ir] = {bb, i};
+            addUsers(ir);
+            Value* dst = getDefVal(ir);
+            if(!dst) continue;
+            defIr[dst] = ir;
+            defCnt[dst]++;
+        }
+    }
+    for(auto& item : defIr) {
+        Instruction* ir = item.second;
+        Type* type = item.first->getType();
+        if(typeid(*ir) != typeid(MoveIR) || defCnt[item.first] != 1 || !type || (!type->isInt() && !type->isFloat())) continue;
+        TempVal* src = dynamic_cast<TempVal*>(ir->getOperands()[1]->getVal());
+        if(src && !src->getVal() && src->getType() && (src->getType()->isInt() || src->getType()->isFloat())) {
+            constMap[item.first] = castConst(src, item.first->getType());
+        }
+    }
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(!ir->isDeleted()) push(ir);
+        }
+    }
+}
+
+inline void InstCombine::push(Instruction* ir) {
+    if(inWork.insert(ir).second) work.push_back(ir);
+}
+
+inline void InstCombine::pushUsers(Value* val) {
+    auto it = users.find(val);
+    if(it == users.end()) return;
+    for(Instruction* user : it->second) {
+        if(!user->isDeleted()) push(user);
+    }
+}
+
+inline void InstCombine::addUsers(Instruction* ir) {
+    if(typeid(*ir) == typeid(PhiIR)) {
+        for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+            TempVal* tv = dynamic_cast<TempVal*>(param.second);
+            Value* val = tv ? tv->getVal() : param.second;
+            if(val) users[val].push_back(ir);
+        }
+        return;
+    }
+    getUseOperands(ir, uses);
+    for(Use* use : uses) {
+        Value* val = getUseVal(use);
+        if(val) users[val].push_back(ir);
+    }
+}
+
+inline void InstCombine::replaceIR(Instruction* old, Instruction* ir) {
+    auto p = pos[old];
+    p.first->getIr()[p.second] = ir;
+    pos.erase(old);
+    pos[ir] = p;
+    old->deleteIR();
+    addUsers(ir);
+    Value* dst = getDefVal(ir);
+    if(dst) defIr[dst] = ir;
+    push(ir);
+    pushUsers(dst);
+}
+
+inline void InstCombine::replaceVal(Instruction* old, Value* val) {
+    Value* dst = getDefVal(old);
+    std::vector<Instruction*> list = users[dst];
+    for(Instruction* user : list) {
+        if(user->isDeleted()) continue;
+        if(typeid(*user) == typeid(PhiIR)) {
+            for(auto& param : dynamic_cast<PhiIR*>(user)->params) {
+                TempVal* tv = dynamic_cast<TempVal*>(param.second);
+                if(tv && tv->getVal() == dst) tv->setVal(val);
+                else if(!tv && param.second == dst) param.second = val;
+            }
+        } else {
+            getUseOperands(user, uses);
+            for(Use* use : uses) {
+                if(getUseVal(use) == dst) setUseVal(use, val);
+            }
+        }
+        users[val].push_back(user);
+        push(user);
+    }
+    old->deleteIR();
+}
+
+inline void InstCombine::replaceConst(Instruction* old, TempVal c) {
+    Value* dst = getDefVal(old);
+    TempVal* src = castConst(&c, dst->getType());
+    constMap[dst] = src;
+    replaceIR(old, new MoveIR(dst, src));
+}
+
+inline bool InstCombine::isBoolean(Value* val) {
+    Instruction* def = getDef(val);
+    if(!def || !val->getType()->isInt()) return false;
+    if(typeid(*def) == typeid(UnaryIR)) return dynamic_cast<UnaryIR*>(def)->op == OP::NOT;
+    return isCompare(typeid(*def));
+}
+
+// 把常量变量代入运算数, 两边都成了常量时折叠
+inline bool InstCombine::substitute(ArithmeticIR* ir) {
+    const std::type_info& t = typeid(*ir);
+    bool changed = false;
+    for(int k(1); k <= 2; k++) {
+        TempVal* tv = operand(ir, k);
+        TempVal* other = operand(ir, 3 - k);
+        auto it = constMap.find(tv->getVal());
+        if(!tv->getVal() || it == constMap.end()) continue;
+        TempVal* c = it->second;
+        if(other->getVal()) {
+            *tv = *castConst(c, tv->getVal()->getType());
+            hits[FOLD]++;
+            changed = true;
+            continue;
+        }
+        // 另一边已是常量, 只折叠整数运算
+        int x, y, res;
+        if(isFloatOp(t) || !c->isInt() || !other->isInt()) continue;
+        x = k == 1 ? c->getInt() : other->getInt();
+        y = k == 1 ? other->getInt() : c->getInt();
+        if(foldInt(t, x, y, res)) {
+            replaceConst(ir, intTemp(res));
+            hits[FOLD]++;
+            return true;
+        }
+    }
+    return changed;
+}
+
+inline bool InstCombine::visitArithmetic(ArithmeticIR* ir) {
+    const std::type_info& t = typeid(*ir);
+    Value* dst = getDefVal(ir);
+    if(!dst || defCnt[dst] != 1) return false;
+    bool changed = substitute(ir);
+    if(ir->isDeleted()) return true;
+    TempVal* res = operand(ir, 0);
+    TempVal* a = operand(ir, 1);
+    TempVal* b = operand(ir, 2);
+    Value* x = a->getVal();
+    Value* y = b->getVal();
+    bool isFloat = isFloatOp(t);
+    // 两边都是常量
+    if(!x && !y) {
+        int v;
+        if(!isFloat && a->isInt() && b->isInt() && foldInt(t, a->getInt(), b->getInt(), v)) {
+            replaceConst(ir, intTemp(v));
+            hits[FOLD]++;
+            return true;
+        }
+        return changed;
+    }
+    // 常量放到右边
+    if(!x) {
+        if(isCommutative(t)) {
+            std::swap(*a, *b);
+            std::swap(x, y);
+            hits[CANON]++;
+            changed = true;
+        } else if(isCompare(t)) {
+            replaceIR(ir, newArithmetic(*mirror(t), *res, *b, *a));
+            hits[CANON]++;
+            return true;
+        }
+    }
+    auto toVal = [&](Value* val, Rule rule) {
+        if(!isStable(val) || val->getType()->isFloat() != dst->getType()->isFloat()) return false;
+        replaceVal(ir, val);
+        hits[rule]++;
+        return true;
+    };
+    auto toConst = [&](int c, Rule rule) {
+        replaceConst(ir, intTemp(c));
+        hits[rule]++;
+        return true;
+    };
+    auto toIR = [&](Instruction* newIr, Rule rule) {
+        replaceIR(ir, newIr);
+        hits[rule]++;
+        return true;
+    };
+    auto toNeg = [&](Value* val, Rule rule) {
+        return toIR(new UnaryIR(*res, varTemp(val), OP::NEG), rule);
+    };
+    // val 的定值是类型一致的取负, 返回被取负的变量
+    auto negOf = [&](Value* val) -> Value* {
+        UnaryIR* neg = dynamic_cast<UnaryIR*>(getDef(val));
+        if(!neg || neg->op != OP::NEG) return nullptr;
+        Value* src = operand(neg, 1)->getVal();
+        if(!isStable(src) || src->getType()->isFloat() != val->getType()->isFloat()) return nullptr;
+        return src;
+    };
+    // val 的定值是 op(变量, 常量), 取出变量和常量
+    auto constOperand = [&](Value* val, const std::type_info& op, Value*& var, int& c) {
+        Instruction* def = getDef(val);
+        if(!def || typeid(*def) != op) return false;
+        TempVal* l = operand(def, 1);
+        TempVal* r = operand(def, 2);
+        if(!isStable(l->getVal()) || r->getVal() || !r->isInt()) return false;
+        var = l->getVal();
+        c = r->getInt();
+        return true;
+    };
+    bool bConst = !y;
+    Value* var;
+    int c;
+
+    if(!isFloat) {
+        if(bConst && !b->isInt()) return changed;
+        if(t == typeid(AddIIR)) {
+            if(bConst && b->getInt() == 0) return toVal(x, IDENTITY);
+            if(bConst && constOperand(x, typeid(AddIIR), var, c)) {
+                int sum = (int) ((unsigned) c + (unsigned) b->getInt());
+                if(sum == 0) return toVal(var, REASSOC);
+                return toIR(new AddIIR(*res, varTemp(var), intTemp(sum)), REASSOC);
+            }
+            if(y && (var = negOf(y))) return toIR(new SubIIR(*res, *a, varTemp(var)), NEGATE);
+            if(y && (var = negOf(x))) return toIR(new SubIIR(*res, *b, varTemp(var)), NEGATE);
+        } else if(t == typeid(SubIIR)) {
+            if(!x) {
+                if(isIntConst(a, 0)) return toNeg(y, NEGATE);
+                return changed;
+            }
+            if(x == y) return toConst(0, IDENTITY);
+            if(bConst && b->getInt() == 0) return toVal(x, IDENTITY);
+            if(bConst && b->getInt() != INT_MIN) return toIR(new AddIIR(*res, *a, intTemp(-b->getInt())), CANON);
+            if(y && (var = negOf(y))) return toIR(new AddIIR(*res, *a, varTemp(var)), NEGATE);
+        } else if(t == typeid(MulIIR)) {
+            if(!bConst) return changed;
+            int v = b->getInt();
+            if(v == 0) return toConst(0, IDENTITY);
+            if(v == 1) return toVal(x, IDENTITY);
+            if(v == -1) return toNeg(x, NEGATE);
+            if(constOperand(x, typeid(MulIIR), var, c)) {
+                return toIR(new MulIIR(*res, varTemp(var), intTemp((int) ((unsigned) c * (unsigned) v))), REASSOC);
+            }
+            if(lowerShifts && v > 0 && (v & (v - 1)) == 0) {
+                int k = 0;
+                while((1 << k) != v) k++;
+                return toIR(new ShlIR(*res, *a, intTemp(k)), SHIFT);
+            }
+        } else if(t == typeid(DivIIR)) {
+            if(!x) return changed;
+            if(x == y) return toConst(1, IDENTITY);
+            if(isIntConst(b, 1)) return toVal(x, IDENTITY);
+            if(isIntConst(b, -1)) return toNeg(x, NEGATE);
+        } else if(t == typeid(ModIR)) {
+            if(!x) return changed;
+            if(x == y || isIntConst(b, 1) || isIntConst(b, -1)) return toConst(0, IDENTITY);
+        } else if(t == typeid(ShlIR)) {
+            if(x && isIntConst(b, 0)) return toVal(x, IDENTITY);
+        } else if(isCompare(t)) {
+            if(x == y) {
+                bool eq = t == typeid(LEIIR) || t == typeid(GEIIR) || t == typeid(EQUIIR);
+                return toConst(eq ? 1 : 0, IDENTITY);
+            }
+            bool isEq = t == typeid(EQUIIR);
+            if(!bConst || (!isEq && t != typeid(NEIIR))) return changed;
+            // (x + c1) == c2 -> x == c2 - c1
+            if(constOperand(x, typeid(AddIIR), var, c)) {
+                int v = (int) ((unsigned) b->getInt() - (unsigned) c);
+                return toIR(newArithmetic(t, *res, varTemp(var), intTemp(v)), REASSOC);
+            }
+            if(isBoolean(x) && isStable(x)) {
+                int v = b->getInt();
+                if((isEq && v == 1) || (!isEq && v == 0)) return toVal(x, BOOLEAN);
+                if((isEq && v == 0) || (!isEq && v == 1)) return toIR(new UnaryIR(*res, varTemp(x), OP::NOT), BOOLEAN);
+                // 布尔值不可能等于其它常量
+                return toConst(isEq ? 0 : 1, BOOLEAN);
+            }
+        }
+        return changed;
+    }
+
+    if(!x) return changed;
+    if(t == typeid(AddFIR)) {
+        if(y && (var = negOf(y))) return toIR(new SubFIR(*res, *a, varTemp(var)), NEGATE);
+        if(y && (var = negOf(x))) return toIR(new SubFIR(*res, *b, varTemp(var)), NEGATE);
+    } else if(t == typeid(SubFIR)) {
+        if(isFloatConst(b, 0.0f)) return toVal(x, IDENTITY);
+        if(y && (var = negOf(y))) return toIR(new AddFIR(*res, *a, varTemp(var)), NEGATE);
+    } else if(t == typeid(MulFIR)) {
+        if(isFloatConst(b, 1.0f)) return toVal(x, IDENTITY);
+        if(isFloatConst(b, -1.0f)) return toNeg(x, NEGATE);
+    } else if(t == typeid(DivFIR)) {
+        if(isFloatConst(b, 1.0f)) return toVal(x, IDENTITY);
+    }
+    return changed;
+}
+
+inline bool InstCombine::visitUnary(UnaryIR* ir) {
+    Value* dst = getDefVal(ir);
+    if(!dst || defCnt[dst] != 1) return false;
+    TempVal* res = operand(ir, 0);
+    TempVal* v = operand(ir, 1);
+    bool changed = false;
+    auto it = constMap.find(v->getVal());
+    if(v->getVal() && it != constMap.end()) {
+        *v = *castConst(it->second, v->getVal()->getType());
+        hits[FOLD]++;
+        changed = true;
+    }
+    Value* x = v->getVal();
+    bool sameType = v->getType()->isFloat() == res->getType()->isFloat();
+    if(ir->op == OP::NOT) {
+        if(!res->isInt()) return changed;
+        if(!x) {
+            replaceConst(ir, intTemp(v->isFloat() ? v->getFloat() == 0 : v->getInt() == 0));
+            hits[FOLD]++;
+            return true;
+        }
+        Instruction* def = getDef(x);
+        if(!def) return changed;
+        const std::type_info& t = typeid(*def);
+        // !!y: y 本身是布尔值时就是 y, 否则是 y != 0
+        UnaryIR* inner = dynamic_cast<UnaryIR*>(def);
+        if(inner && inner->op == OP::NOT) {
+            Value* src = operand(inner, 1)->getVal();
+            if(!isStable(src) || !src->getType()->isInt()) return changed;
+            if(isBoolean(src)) {
+                replaceVal(ir, src);
+            } else {
+                replaceIR(ir, new NEIIR(*res, varTemp(src), intTemp(0)));
+            }
+            hits[BOOLEAN]++;
+            return true;
+        }
+        // !(a < b) -> a >= b, 浮点比较有 NaN, 只取反 == 和 !=
+        const std::type_info* inv = isCompare(t) ? inverse(t) : nullptr;
+        if(inv) {
+            TempVal* l = operand(def, 1);
+            TempVal* r = operand(def, 2);
+            if((l->getVal() && !isStable(l->getVal())) || (r->getVal() && !isStable(r->getVal()))) return changed;
+            replaceIR(ir, newArithmetic(*inv, *res, *l, *r));
+            hits[BOOLEAN]++;
+            return true;
+        }
+        return changed;
+    }
+    if(!sameType) return changed;
+    if(!x) {
+        TempVal c = *v;
+        if(c.isFloat()) c.setFloat(-c.getFloat());
+        else c.setInt((int) (0u - (unsigned) c.getInt()));
+        replaceConst(ir, c);
+        hits[FOLD]++;
+        return true;
+    }
+    Instruction* def = getDef(x);
+    if(!def) return changed;
+    UnaryIR* inner = dynamic_cast<UnaryIR*>(def);
+    if(inner && inner->op == OP::NEG) {
+        Value* src = operand(inner, 1)->getVal();
+        if(!isStable(src) || src->getType()->isFloat() != x->getType()->isFloat()) return changed;
+        replaceVal(ir, src);
+        hits[NEGATE]++;
+        return true;
+    }
+    // -(a - b) -> b - a, 浮点在 a == b 时符号不同
+    if(typeid(*def) == typeid(SubIIR)) {
+        TempVal* l = operand(def, 1);
+        TempVal* r = operand(def, 2);
+        if((l->getVal() && !isStable(l->getVal())) || (r->getVal() && !isStable(r->getVal()))) return changed;
+        if(!l->getVal() && !r->getVal()) return changed;
+        replaceIR(ir, new SubIIR(*res, *r, *l));
+        hits[NEGATE]++;
+        return true;
+    }
+    return changed;
+}
+
+// 删掉化简后不再使用的运算和常量 move
+inline void InstCombine::removeDead() {
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        std::unordered_set<Value*> used;
+        for(BasicBlock* bb : function->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                if(typeid(*ir) == typeid(PhiIR)) {
+                    for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                        TempVal* tv = dynamic_cast<TempVal*>(param.second);
+                        used.insert(tv ? tv->getVal() : param.second);
+                    }
+                    continue;
+                }
+                getUseOperands(ir, uses);
+                for(Use* use : uses) {
+                    used.insert(getUseVal(use));
+                }
+            }
+        }
+        for(BasicBlock* bb : function->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                bool constMove = false;
+                if(typeid(*ir) == typeid(MoveIR)) {
+                    TempVal* src = dynamic_cast<TempVal*>(ir->getOperands()[1]->getVal());
+                    constMove = src && !src->getVal();
+                }
+                if(!dynamic_cast<ArithmeticIR*>(ir) && typeid(*ir) != typeid(UnaryIR) && !constMove) continue;
+                Value* dst = getDefVal(ir);
+                if(!dst || dst->is_Global() || defCnt[dst] != 1 || used.count(dst)) continue;
+                ir->deleteIR();
+                hits[DEAD]++;
+                changed = true;
+            }
+        }
+    }
+}
+
+inline TempVal InstCombine::varTemp(Value* val) {
+    TempVal res;
+    res.setVal(val);
+    res.setType(val->getType());
+    return res;
+}
+
+inline TempVal InstCombine::intTemp(int c) {
+    TempVal res;
+    res.setType(new Type(TypeID::INT));
+    res.setInt(c);
+    return res;
+}
+
+// 与 SCCP 的折叠一致: 除零、移位量越界不折叠
+inline bool InstCombine::foldInt(const std::type_info& t, int x, int y, int& res) {
+    if(t == typeid(AddIIR)) res = (int) ((unsigned) x + (unsigned) y);
+    else if(t == typeid(SubIIR)) res = (int) ((unsigned) x - (unsigned) y);
+    else if(t == typeid(MulIIR)) res = (int) ((unsigned) x * (unsigned) y);
+    else if(t == typeid(DivIIR)) {
+        if(y == 0) return false;
+        res = x == INT_MIN && y == -1 ? INT_MIN : x / y;
+    } else if(t == typeid(ModIR)) {
+        if(y == 0) return false;
+        res = x == INT_MIN && y == -1 ? 0 : x % y;
+    } else if(t == typeid(ShlIR)) {
+        if(y < 0 || y > 31) return false;
+        res = (int) ((unsigned) x << y);
+    }
+    else if(t == typeid(LTIIR)) res = x < y;
+    else if(t == typeid(LEIIR)) res = x <= y;
+    else if(t == typeid(GTIIR)) res = x > y;
+    else if(t == typeid(GEIIR)) res = x >= y;
+    else if(t == typeid(EQUIIR)) res = x == y;
+    else if(t == typeid(NEIIR)) res = x != y;
+    else return false;
+    return true;
+}
+
+inline bool InstCombine::isFloatOp(const std::type_info& t) {
+    return t == typeid(AddFIR) || t == typeid(SubFIR) || t == typeid(MulFIR) || t == typeid(DivFIR)
+           || t == typeid(LTFIR) || t == typeid(LEFIR) || t == typeid(GTFIR) || t == typeid(GEFIR)
+           || t == typeid(EQUFIR) || t == typeid(NEFIR);
+}
+
+inline bool InstCombine::isCompare(const std::type_info& t) {
+    return t == typeid(LTIIR) || t == typeid(LEIIR) || t == typeid(GTIIR) || t == typeid(GEIIR)
+           || t == typeid(EQUIIR) || t == typeid(NEIIR) || t == typeid(LTFIR) || t == typeid(LEFIR)
+           || t == typeid(GTFIR) || t == typeid(GEFIR) || t == typeid(EQUFIR) || t == typeid(NEFIR);
+}
+
+inline bool InstCombine::isCommutative(const std::type_info& t) {
+    return t == typeid(AddIIR) || t == typeid(AddFIR) || t == typeid(MulIIR) || t == typeid(MulFIR)
+           || t == typeid(EQUIIR) || t == typeid(EQUFIR) || t == typeid(NEIIR) || t == typeid(NEFIR);
+}
+
+// 交换左右两边后的比较
+inline const std::type_info* InstCombine::mirror(const std::type_info& t) {
+    if(t == typeid(LTIIR)) return &typeid(GTIIR);
+    if(t == typeid(GTIIR)) return &typeid(LTIIR);
+    if(t == typeid(LEIIR)) return &typeid(GEIIR);
+    if(t == typeid(GEIIR)) return &typeid(LEIIR);
+    if(t == typeid(LTFIR)) return &typeid(GTFIR);
+    if(t == typeid(GTFIR)) return &typeid(LTFIR);
+    if(t == typeid(LEFIR)) return &typeid(GEFIR);
+    if(t == typeid(GEFIR)) return &typeid(LEFIR);
+    return &t;
+}
+
+// 结果取反的比较, 没有时返回 nullptr
+inline const std::type_info* InstCombine::inverse(const std::type_info& t) {
+    if(t == typeid(LTIIR)) return &typeid(GEIIR);
+    if(t == typeid(GEIIR)) return &typeid(LTIIR);
+    if(t == typeid(LEIIR)) return &typeid(GTIIR);
+    if(t == typeid(GTIIR)) return &typeid(LEIIR);
+    if(t == typeid(EQUIIR)) return &typeid(NEIIR);
+    if(t == typeid(NEIIR)) return &typeid(EQUIIR);
+    if(t == typeid(EQUFIR)) return &typeid(NEFIR);
+    if(t == typeid(NEFIR)) return &typeid(EQUFIR);
+    return nullptr;
+}
+
+inline int InstCombine::getTotalCnt() {
+    int total = 0;
+    for(int i(0); i < RULE_CNT; i++) {
+        total += hits[i];
+    }
+    return total;
+}
+
+inline void InstCombine::printHits(std::ostream& out) {
+    static const char* names[RULE_CNT] = {"fold", "canon", "identity", "reassoc", "negate", "boolean", "shift", "dead"};
+    bool first = true;
+    for(int i(0); i < RULE_CNT; i++) {
+        if(!hits[i]) continue;
+        out << (first ? " " : ", ") << names[i] << " " << hits[i];
+        first = false;
+    }
+    if(first) out << " none";
+}
+
+#endif //SYSY2022_BJTU_INSTCOMBINE_HH
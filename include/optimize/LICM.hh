@@ -0,0 +1,280 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_LICM_HH
+#define SYSY2022_BJTU_LICM_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "LoopInfo.hh"
+#include "AliasAnalysis.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+// 循环不变量外提, 需要 LoopSimplify 之后的前置块和有效的支配树, 不改 CFG
+// 外提: 操作数都在循环外定值的纯运算、GEP、拷贝和 load 移到前置块末尾, 内层循环先做, 提到外层后可以继续外提
+// 前置块里的指令循环一次不执行也会执行: 整数除法/取模要求除数为非零常数或在首块中;
+// load 要求地址一定有效(标量变量、常数下标在界内)或在首块中, 且循环中没有可能写这块内存的 store 和调用(按别名分析)
+// 内存按别名分析给出的地址根区分: 局部 alloca、全局变量、其他指针(参数); 参数指针只会指向全局数组或调用者的数组
+// 下沉: 结果只在循环外使用的纯运算, 和循环中唯一写某块内存且循环中不读它的 store, 移到唯一的出口块,
+// 要求所在块支配出口块, 这样离开循环时它最后一次执行的结果与在出口重新计算相同
+class LICM {
+private:
+    IrVisitor* irVisitor;
+    Function* function;
+    LoopInfo loopInfo;
+    AliasAnalysis aliasAnalysis;
+    DefUseTable defUse;
+    std::vector<Use*> uses;
+
+    // 循环中的内存访问
+    struct LoopMem {
+        std::unordered_map<Value*, int> storeCnt, loadCnt;
+        // globalStore: 写了全局数组
+        bool globalStore = false, unknownStore = false, unknownLoad = false, hasCall = false;
+        std::vector<Value*> storeAddrs;
+        std::vector<CallIR*> calls;
+    };
+
+    int hoistedCnt = 0;
+    int sunkCnt = 0;
+
+    Value* getRoot(Value* addr) { return aliasAnalysis.getLocation(addr).root; }
+    bool isLocal(Value* root) { return aliasAnalysis.isLocal(root); }
+    bool isGlobal(Value* root) { return root && !isLocal(root) && root->is_Global(); }
+    void scanLoop(Loop* loop, LoopMem& mem);
+    bool isInvariant(Value* val, Loop* loop);
+    bool canHoist(Instruction* ir, BasicBlock* bb, Loop* loop, LoopMem& mem);
+    bool canSpeculateLoad(Value* addr);
+    bool loadClobbered(Value* addr, LoopMem& mem);
+    bool canSink(Instruction* ir, BasicBlock* bb, Loop* loop, BasicBlock* exitBB, LoopMem& mem);
+    void hoist(Loop* loop, LoopMem& mem);
+    void sink(Loop* loop, LoopMem& mem);
+    void moveDef(Instruction* ir, BasicBlock* to);
+public:
+    LICM(IrVisitor* irVisitor) : irVisitor(irVisitor), aliasAnalysis(irVisitor) {;}
+    void execute();
+    int getHoistedCnt() { return hoistedCnt; }
+    int getSunkCnt() { return sunkCnt; }
+};
+
+inline void LICM::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        loopInfo.analyze(func);
+        if(loopInfo.getLoops().empty()) continue;
+        aliasAnalysis.analyze(func);
+        defUse.build(function);
+        for(Loop* loop : loopInfo.getLoops()) {
+            LoopMem mem;
+            scanLoop(loop, mem);
+            if(loop->getPreheader()) hoist(loop, mem);
+            sink(loop, mem);
+        }
+    }
+}
+
+inline void LICM::scanLoop(Loop* loop, LoopMem& mem) {
+    for(BasicBlock* bb : loop->bbs) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            const std::type_info& t = typeid(*ir);
+            if(t == typeid(CallIR)) {
+                if(!isMemFreeLibFunc(dynamic_cast<CallIR*>(ir)->func)) mem.hasCall = true;
+                mem.calls.push_back(dynamic_cast<CallIR*>(ir));
+                continue;
+            }
+            bool isStore = t == typeid(StoreIIR) || t == typeid(StoreFIR);
+            if(!isStore && t != typeid(LoadIIR) && t != typeid(LoadFIR)) continue;
+            Value* root = getRoot(getUseVal(ir->getOperands()[isStore ? 0 : 1]));
+            if(isStore) {
+                mem.storeAddrs.push_back(getUseVal(ir->getOperands()[0]));
+                if(isLocal(root) || isGlobal(root)) {
+                    mem.storeCnt[root]++;
+                    mem.globalStore = mem.globalStore || (isGlobal(root) && root->is_Array());
+                } else {
+                    mem.unknownStore = true;
+                }
+            } else {
+                if(isLocal(root) || isGlobal(root)) {
+                    mem.loadCnt[root]++;
+                } else {
+                    mem.unknownLoad = true;
+                }
+            }
+        }
+    }
+}
+
+// 常量、参数、全局变量和在循环外定值的变量
+inline bool LICM::isInvariant(Value* val, Loop* loop) {
+    if(!val || val->getNum() < 0 || val->getNum() >= (int) defUse.defBB.size()) return true;
+    auto& entry = defUse.defBB[val->getNum()];
+    if(entry.first == defUse.collide) return false;
+    if(entry.first != val) return true;
+    return !loop->contains(entry.second);
+}
+
+// 循环中可能写 addr 指向的内存; addr 是循环不变量, 别名分析中同一变量的比较跨迭代也成立
+inline bool LICM::loadClobbered(Value* addr, LoopMem& mem) {
+    for(CallIR* call : mem.calls) {
+        if(aliasAnalysis.callMayAccess(call, addr)) return true;
+    }
+    for(Value* storeAddr : mem.storeAddrs) {
+        if(aliasAnalysis.alias(addr, storeAddr) != AliasAnalysis::NoAlias) return true;
+    }
+    return false;
+}
+
+// 标量变量和常数下标在界内的数组元素, 地址一定有效
+inline bool LICM::canSpeculateLoad(Value* addr) {
+    if(!addr) return false;
+    AliasAnalysis::Location& loc = aliasAnalysis.getLocation(addr);
+    Value* root = loc.root;
+    if(!(isLocal(root) || isGlobal(root))) return false;
+    if(root == addr) return !addr->is_Array();
+    if(!loc.known || loc.var || root->getArrayDims().empty()) return false;
+    return loc.offset >= 0 && loc.offset < root->getArrayLen();
+}
+
+inline bool LICM::canHoist(Instruction* ir, BasicBlock* bb, Loop* loop, LoopMem& mem) {
+    const std::type_info& t = typeid(*ir);
+    bool isLoad = t == typeid(LoadIIR) || t == typeid(LoadFIR);
+    if(!isLoad && !dynamic_cast<ArithmeticIR*>(ir) && t != typeid(UnaryIR) && t != typeid(CastInt2FloatIR)
+       && t != typeid(CastFloat2IntIR) && t != typeid(GEPIR) && t != typeid(MoveIR)) {
+        return false;
+    }
+    Value* dst = getDefVal(ir);
+    if(!dst || defUse.defBB[dst->getNum()].first != dst) return false;
+    getUseOperands(ir, uses);
+    for(Use* use : uses) {
+        if(!isInvariant(getUseVal(use), loop)) return false;
+    }
+    if(t == typeid(DivIIR) || t == typeid(ModIR)) {
+        Value* divisor = ir->getOperands()[2]->getVal();
+        TempVal* c = dynamic_cast<TempVal*>(divisor);
+        bool nonZero = c && !c->getVal() && c->getInt() != 0;
+        if(!nonZero && bb != loop->header) return false;
+    }
+    if(isLoad) {
+        Value* addr = getUseVal(ir->getOperands()[1]);
+        if(loadClobbered(addr, mem)) return false;
+        if(bb != loop->header && !canSpeculateLoad(addr)) return false;
+    }
+    return true;
+}
+
+inline void LICM::moveDef(Instruction* ir, BasicBlock* to) {
+    defUse.irBB[ir] = to;
+    Value* dst = getDefVal(ir);
+    if(dst) defUse.defBB[dst->getNum()].second = to;
+}
+
+inline void LICM::hoist(Loop* loop, LoopMem& mem) {
+    BasicBlock* preheader = loop->getPreheader();
+    std::vector<Instruction*> hoisted;
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(BasicBlock* bb : loop->bbs) {
+            auto& irs = bb->getIr();
+            std::vector<Instruction*> kept;
+            for(auto ir : irs) {
+                if(!ir->isDeleted() && typeid(*ir) != typeid(PhiIR) && canHoist(ir, bb, loop, mem)) {
+                    hoisted.push_back(ir);
+                    moveDef(ir, preheader);
+                    changed = true;
+                } else {
+                    kept.push_back(ir);
+                }
+            }
+            if(kept.size() != irs.size()) irs.swap(kept);
+        }
+    }
+    if(hoisted.empty()) return;
+    auto& irs = preheader->getIr();
+    auto pos = irs.end();
+    if(!irs.empty()) {
+        const std::type_info& t = typeid(*irs.back());
+        if(t == typeid(JumpIR) || t == typeid(BranchIR) || t == typeid(ReturnIR)) pos--;
+    }
+    irs.insert(pos, hoisted.begin(), hoisted.end());
+    hoistedCnt += hoisted.size();
+}
+
+inline bool LICM::canSink(Instruction* ir, BasicBlock* bb, Loop* loop, BasicBlock* exitBB, LoopMem& mem) {
+    if(!bb->dominates(exitBB)) return false;
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+        // 循环中只有它写这块内存且没有读, 离开循环时内存里就是它最后一次写的值
+        Value* addr = getUseVal(ir->getOperands()[0]);
+        Value* root = getRoot(addr);
+        if(!isInvariant(addr, loop) || !(isLocal(root) || isGlobal(root))) return false;
+        if(mem.storeCnt[root] != 1 || mem.loadCnt.count(root)) return false;
+        if(isLocal(root)) return !(aliasAnalysis.isEscaped(root) && mem.hasCall);
+        return !mem.hasCall && !(root->is_Array() && (mem.unknownLoad || mem.unknownStore));
+    }
+    if(!dynamic_cast<ArithmeticIR*>(ir) && t != typeid(UnaryIR) && t != typeid(CastInt2FloatIR)
+       && t != typeid(CastFloat2IntIR) && t != typeid(GEPIR) && t != typeid(MoveIR)) {
+        return false;
+    }
+    Value* dst = getDefVal(ir);
+    if(!dst || defUse.defBB[dst->getNum()].first != dst) return false;
+    for(Instruction* user : defUse.users[dst->getNum()]) {
+        if(user->isDeleted()) continue;
+        if(typeid(*user) == typeid(PhiIR) || loop->contains(defUse.irBB[user])) return false;
+    }
+    return true;
+}
+
+// 下沉到唯一的出口块, 出口块的前驱都在循环中
+inline void LICM::sink(Loop* loop, LoopMem& mem) {
+    if(loop->exits.size() != 1) return;
+    BasicBlock* exitBB = loop->exits[0];
+    for(BasicBlock* preBB : exitBB->getPre()) {
+        if(!loop->contains(preBB)) return;
+    }
+    // (原块的支配树先序号, 块内位置) 排序后插入, 保证定值在使用之前
+    std::vector<std::pair<std::pair<int, int>, Instruction*>> sunk;
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(BasicBlock* bb : loop->bbs) {
+            auto& irs = bb->getIr();
+            std::vector<Instruction*> kept;
+            for(int i(irs.size() - 1); i >= 0; i--) {
+                Instruction* ir = irs[i];
+                if(!ir->isDeleted() && typeid(*ir) != typeid(PhiIR) && canSink(ir, bb, loop, exitBB, mem)) {
+                    sunk.push_back({{bb->getDomIn(), i}, ir});
+                    moveDef(ir, exitBB);
+                    changed = true;
+                } else {
+                    kept.push_back(ir);
+                }
+            }
+            if(kept.size() != irs.size()) {
+                std::reverse(kept.begin(), kept.end());
+                irs.swap(kept);
+            }
+        }
+    }
+    if(sunk.empty()) return;
+    std::sort(sunk.begin(), sunk.end(),
+              [](const std::pair<std::pair<int, int>, Instruction*>& a, const std::pair<std::pair<int, int>, Instruction*>& b) {
+                  return a.first < b.first;
+              });
+    auto& irs = exitBB->getIr();
+    size_t pos = 0;
+    while(pos < irs.size() && typeid(*irs[pos]) == typeid(PhiIR)) pos++;
+    std::vector<Instruction*> moved;
+    for(auto& item : sunk) moved.push_back(item.second);
+    irs.insert(irs.begin() + pos, moved.begin(), moved.end());
+    sunkCnt += moved.size();
+}
+
+#endif //SYSY2022_BJTU_LICM_HH
@@ -0,0 +1,197 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_LOADELIMINATION_HH
+#define SYSY2022_BJTU_LOADELIMINATION_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "AliasAnalysis.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// 冗余 load 消除和 store 到 load 的转发, 在 SSA 上做, 需要有效的支配树, 不改 CFG
+// 沿支配树先序遍历, 维护可用的 (地址, 值): load 后记下结果, store 后记下存入的值
+// store、调用、数组 alloca 去掉可能被改写的表项(按别名分析), 地址 MustAlias 的 load 直接用表中的值
+// 进入块时继承支配树父结点末尾的表; 块有其它前驱时, 找出从父结点到本块路径上的块, 去掉被它们改写的表项
+// 存入的常量换成 move, 变量的使用最后统一改写; 多次定值的变量不记
+class LoadElimination {
+private:
+    struct Avail {
+        Value* addr;
+        // val 为 nullptr 时是常量 cst
+        Value* val;
+        TempVal* cst;
+        bool fromStore;
+    };
+    struct Frame {
+        BasicBlock* bb;
+        size_t next;
+        std::vector<Avail> avail;
+    };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    AliasAnalysis aliasAnalysis;
+    std::unordered_map<Value*, int> defCnt;
+    // 被删掉的 load 结果 -> 替换的值
+    std::unordered_map<Value*, Value*> valMap;
+
+    static const int maxAvail = 64;
+    static const int maxRegion = 256;
+
+    int forwardedCnt = 0;
+    int removedCnt = 0;
+
+    void enterBB(BasicBlock* bb, std::vector<Avail>& avail);
+    void visitBB(BasicBlock* bb, std::vector<Avail>& avail);
+    bool mayClobber(Instruction* ir, Value* addr);
+    void record(std::vector<Avail>& avail, const Avail& item);
+public:
+    LoadElimination(IrVisitor* irVisitor) : irVisitor(irVisitor), aliasAnalysis(irVisitor) {;}
+    void execute();
+    int getForwardedCnt() { return forwardedCnt; }
+    int getRemovedCnt() { return removedCnt; }
+};
+
+inline void LoadElimination::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        aliasAnalysis.analyze(func);
+        defCnt.clear();
+        valMap.clear();
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                Value* dst = getDefVal(ir);
+                if(dst) defCnt[dst]++;
+            }
+        }
+
+        // 支配树先序遍历, 每层保存块末尾的表
+        std::vector<Frame> work;
+        work.push_back({func->getBB()[0], 0, {}});
+        visitBB(func->getBB()[0], work.back().avail);
+        while(!work.empty()) {
+            Frame& top = work.back();
+            auto& children = top.bb->getDomTreeSuccNode();
+            if(top.next < children.size()) {
+                BasicBlock* child = children[top.next++];
+                std::vector<Avail> avail = top.avail;
+                enterBB(child, avail);
+                visitBB(child, avail);
+                work.push_back({child, 0, std::move(avail)});
+                continue;
+            }
+            work.pop_back();
+        }
+        if(!valMap.empty()) applyValMap(function, valMap);
+    }
+}
+
+// 从前驱往回找到父结点为止, 这些块中的指令可能在父结点和本块之间执行
+inline void LoadElimination::enterBB(BasicBlock* bb, std::vector<Avail>& avail) {
+    auto& preBBs = bb->getPre();
+    BasicBlock* idom = bb->getIdom();
+    if(avail.empty() || (preBBs.size() == 1 && preBBs[0] == idom)) return;
+    std::unordered_set<BasicBlock*> region;
+    std::vector<BasicBlock*> stack;
+    for(BasicBlock* preBB : preBBs) {
+        if(preBB != idom && region.insert(preBB).second) stack.push_back(preBB);
+    }
+    while(!stack.empty()) {
+        BasicBlock* cur = stack.back();
+        stack.pop_back();
+        if((int) region.size() > maxRegion) {
+            avail.clear();
+            return;
+        }
+        for(BasicBlock* preBB : cur->getPre()) {
+            if(preBB != idom && region.insert(preBB).second) stack.push_back(preBB);
+        }
+    }
+    for(BasicBlock* cur : region) {
+        for(auto ir : cur->getIr()) {
+            if(avail.empty()) return;
+            if(ir->isDeleted()) continue;
+            for(size_t i(0); i < avail.size();) {
+                if(mayClobber(ir, avail[i].addr)) avail.erase(avail.begin() + i);
+                else i++;
+            }
+        }
+    }
+}
+
+inline bool LoadElimination::mayClobber(Instruction* ir, Value* addr) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+        return aliasAnalysis.alias(getUseVal(ir->getOperands()[0]), addr) != AliasAnalysis::NoAlias;
+    }
+    if(t == typeid(CallIR)) return aliasAnalysis.callMayAccess(dynamic_cast<CallIR*>(ir), addr);
+    // 循环中的数组 alloca 每次进入都是新的对象
+    AllocIR* alloc = dynamic_cast<AllocIR*>(ir);
+    if(alloc && alloc->isArray) {
+        Value* root = aliasAnalysis.getLocation(addr).root;
+        return !root || root == getDefVal(ir);
+    }
+    return false;
+}
+
+inline void LoadElimination::record(std::vector<Avail>& avail, const Avail& item) {
+    if((int) avail.size() >= maxAvail) avail.erase(avail.begin());
+    avail.push_back(item);
+}
+
+inline void LoadElimination::visitBB(BasicBlock* bb, std::vector<Avail>& avail) {
+    auto& irs = bb->getIr();
+    for(size_t i(0); i < irs.size(); i++) {
+        Instruction* ir = irs[i];
+        if(ir->isDeleted()) continue;
+        const std::type_info& t = typeid(*ir);
+        if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) {
+            Value* addr = getUseVal(ir->getOperands()[1]);
+            Value* dst = getDefVal(ir);
+            if(!addr || !dst) continue;
+            bool isFloat = t == typeid(LoadFIR);
+            const Avail* hit = nullptr;
+            for(size_t k(avail.size()); k-- > 0;) {
+                if(aliasAnalysis.alias(avail[k].addr, addr) != AliasAnalysis::MustAlias) continue;
+                Type* type = avail[k].val ? avail[k].val->getType() : nullptr;
+                if(!type || type->isFloat() == isFloat) hit = &avail[k];
+                break;
+            }
+            if(hit) {
+                if(hit->val) {
+                    valMap[dst] = hit->val;
+                    ir->deleteIR();
+                } else {
+                    irs[i] = new MoveIR(dst, castConst(hit->cst, dst->getType()));
+                }
+                if(hit->fromStore) forwardedCnt++;
+                else removedCnt++;
+            } else if(defCnt[dst] == 1) {
+                record(avail, {addr, dst, nullptr, false});
+            }
+            continue;
+        }
+        if(t != typeid(StoreIIR) && t != typeid(StoreFIR) && t != typeid(CallIR) && !dynamic_cast<AllocIR*>(ir)) continue;
+        for(size_t k(0); k < avail.size();) {
+            if(mayClobber(ir, avail[k].addr)) avail.erase(avail.begin() + k);
+            else k++;
+        }
+        if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+            Value* addr = getUseVal(ir->getOperands()[0]);
+            TempVal* src = dynamic_cast<TempVal*>(ir->getOperands()[1]->getVal());
+            if(!addr || !src) continue;
+            Value* val = src->getVal();
+            if(!val) record(avail, {addr, nullptr, src, true});
+            else if(defCnt[val] <= 1) record(avail, {addr, resolveVal(valMap, val), nullptr, true});
+        }
+    }
+}
+
+#endif //SYSY2022_BJTU_LOADELIMINATION_HH
@@ -0,0 +1,166 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_LOOPINFO_HH
+#define SYSY2022_BJTU_LOOPINFO_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include <vector>
+#include <algorithm>
+
+// 自然循环: 回边 t->h 满足 h 支配 t, 同一个 h 的回边合成一个循环
+// 块的 id 在分析后不能变, CFG 改动后要重新分析
+class Loop {
+public:
+    BasicBlock* header;
+    // 首块在前, 其余按块 id 升序
+    std::vector<BasicBlock*> bbs;
+    std::vector<BasicBlock*> latches;
+    // 循环内有边出去的块, 和循环外的出口块(不重复)
+    std::vector<BasicBlock*> exitings;
+    std::vector<BasicBlock*> exits;
+    Loop* parent = nullptr;
+    std::vector<Loop*> subLoops;
+    // 最外层为 1
+    int depth = 1;
+
+    Loop(BasicBlock* header, int bbCnt) : header(header), inLoop(bbCnt, false) {;}
+    bool contains(BasicBlock* bb) {
+        return bb->getId() >= 0 && bb->getId() < (int) inLoop.size() && inLoop[bb->getId()];
+    }
+    bool contains(Loop* loop) {
+        return contains(loop->header);
+    }
+    // 唯一的循环外前驱且它只流向首块时返回它, 否则 nullptr
+    BasicBlock* getPreheader() {
+        BasicBlock* res = nullptr;
+        for(BasicBlock* preBB : header->getPre()) {
+            if(contains(preBB)) continue;
+            if(res) return nullptr;
+            res = preBB;
+        }
+        return res && res->getSucc().size() == 1 ? res : nullptr;
+    }
+    BasicBlock* getLatch() {
+        return latches.size() == 1 ? latches[0] : nullptr;
+    }
+private:
+    std::vector<bool> inLoop;
+    friend class LoopInfo;
+};
+
+class LoopInfo {
+private:
+    Function* function = nullptr;
+    std::vector<Loop*> loops;
+    std::vector<Loop*> topLoops;
+    // 按块 id 索引的最内层循环
+    std::vector<Loop*> loopOf;
+
+    void clear();
+public:
+    LoopInfo() {;}
+    ~LoopInfo() { clear(); }
+    // 需要有效的支配树
+    void analyze(Function* function);
+    // 内层循环在前
+    std::vector<Loop*>& getLoops() { return loops; }
+    std::vector<Loop*>& getTopLoops() { return topLoops; }
+    Loop* getLoopFor(BasicBlock* bb) {
+        return bb->getId() >= 0 && bb->getId() < (int) loopOf.size() ? loopOf[bb->getId()] : nullptr;
+    }
+    int getDepth(BasicBlock* bb) {
+        Loop* loop = getLoopFor(bb);
+        return loop ? loop->depth : 0;
+    }
+    bool isHeader(BasicBlock* bb) {
+        Loop* loop = getLoopFor(bb);
+        return loop && loop->header == bb;
+    }
+};
+
+inline void LoopInfo::clear() {
+    for(Loop* loop : loops) delete loop;
+    loops.clear();
+    topLoops.clear();
+    loopOf.clear();
+}
+
+inline void LoopInfo::analyze(Function* function) {
+    clear();
+    this->function = function;
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    function->renumberBB();
+    int n = bbs.size();
+    loopOf.assign(n, nullptr);
+
+    // 每个首块从回边的尾反向搜索到首块, 得到循环体
+    std::vector<BasicBlock*> work;
+    for(BasicBlock* header : bbs) {
+        Loop* loop = nullptr;
+        for(BasicBlock* preBB : header->getPre()) {
+            if(!header->dominates(preBB)) continue;
+            if(!loop) loop = new Loop(header, n);
+            loop->latches.push_back(preBB);
+        }
+        if(!loop) continue;
+        loop->inLoop[header->getId()] = true;
+        for(BasicBlock* latch : loop->latches) {
+            if(!loop->inLoop[latch->getId()]) {
+                loop->inLoop[latch->getId()] = true;
+                work.push_back(latch);
+            }
+        }
+        while(!work.empty()) {
+            BasicBlock* bb = work.back();
+            work.pop_back();
+            for(BasicBlock* preBB : bb->getPre()) {
+                // 入口不可达的块不属于任何循环
+                if(preBB->getDomIn() < 0 || loop->inLoop[preBB->getId()]) continue;
+                loop->inLoop[preBB->getId()] = true;
+                work.push_back(preBB);
+            }
+        }
+        loop->bbs.push_back(header);
+        for(BasicBlock* bb : bbs) {
+            if(bb != header && loop->inLoop[bb->getId()]) loop->bbs.push_back(bb);
+        }
+        loops.push_back(loop);
+    }
+
+    // 循环体小的在内层: 父循环是包含首块的最小的其他循环
+    std::stable_sort(loops.begin(), loops.end(), [](Loop* a, Loop* b) { return a->bbs.size() < b->bbs.size(); });
+    for(size_t i(0); i < loops.size(); i++) {
+        Loop* loop = loops[i];
+        for(BasicBlock* bb : loop->bbs) {
+            if(!loopOf[bb->getId()]) loopOf[bb->getId()] = loop;
+        }
+        for(size_t j(i + 1); j < loops.size(); j++) {
+            if(loops[j]->contains(loop->header)) {
+                loop->parent = loops[j];
+                loops[j]->subLoops.push_back(loop);
+                break;
+            }
+        }
+        if(!loop->parent) topLoops.push_back(loop);
+        for(BasicBlock* bb : loop->bbs) {
+            bool exiting = false;
+            for(BasicBlock* succBB : bb->getSucc()) {
+                if(loop->contains(succBB)) continue;
+                exiting = true;
+                if(std::find(loop->exits.begin(), loop->exits.end(), succBB) == loop->exits.end()) {
+                    loop->exits.push_back(succBB);
+                }
+            }
+            if(exiting) loop->exitings.push_back(bb);
+        }
+    }
+    // 外层先定深度
+    for(auto it = loops.rbegin(); it != loops.rend(); it++) {
+        if((*it)->parent) (*it)->depth = (*it)->parent->depth + 1;
+    }
+}
+
+#endif //SYSY2022_BJTU_LOOPINFO_HH
@@ -0,0 +1,146 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_LOOPSIMPLIFY_HH
+#define SYSY2022_BJTU_LOOPSIMPLIFY_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "LoopInfo.hh"
+#include "IRHelper.hh"
+#include <vector>
+
+// 循环规范化: 每个循环有专用的前置块(唯一的循环外前驱, 只流向首块)和唯一的回边块
+// 多个前驱并到一个新块上, 首块 phi 在这几个前驱上的参数不同时在新块里建 phi 合并
+// 支配树增量维护; 结束后 loopInfo 为规范化后的结果
+class LoopSimplify {
+private:
+    IrVisitor* irVisitor;
+    Function* function;
+    DominateTree dominateTree;
+    LoopInfo loopInfo;
+
+    int loopCnt = 0;
+    int preheaderCnt = 0;
+    int latchCnt = 0;
+
+    BasicBlock* mergePreds(BasicBlock* header, std::vector<BasicBlock*>& preBBs);
+    static bool sameVal(Value* a, Value* b);
+public:
+    LoopSimplify(IrVisitor* irVisitor) : irVisitor(irVisitor), dominateTree(irVisitor) {;}
+    void execute();
+    // 单个函数规范化, 给循环优化遍复用
+    void simplify(Function* function);
+    LoopInfo& getLoopInfo() { return loopInfo; }
+    int getLoopCnt() { return loopCnt; }
+    int getPreheaderCnt() { return preheaderCnt; }
+    int getLatchCnt() { return latchCnt; }
+};
+
+inline void LoopSimplify::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        simplify(func);
+        loopCnt += loopInfo.getLoops().size();
+    }
+}
+
+inline void LoopSimplify::simplify(Function* function) {
+    this->function = function;
+    loopInfo.analyze(function);
+    if(loopInfo.getLoops().empty()) return;
+
+    // 改 CFG 会重排块 id, 先按指针记下每个循环要合并的前驱; 各循环首块不同, 互不影响
+    std::vector<std::pair<BasicBlock*, std::vector<BasicBlock*>>> outside, latches;
+    for(Loop* loop : loopInfo.getLoops()) {
+        if(!loop->getPreheader()) {
+            std::vector<BasicBlock*> preBBs;
+            for(BasicBlock* preBB : loop->header->getPre()) {
+                if(!loop->contains(preBB)) preBBs.push_back(preBB);
+            }
+            if(!preBBs.empty()) outside.push_back({loop->header, preBBs});
+        }
+        if(loop->latches.size() > 1) latches.push_back({loop->header, loop->latches});
+    }
+    if(outside.empty() && latches.empty()) return;
+    for(auto& item : outside) {
+        mergePreds(item.first, item.second);
+        preheaderCnt++;
+    }
+    for(auto& item : latches) {
+        mergePreds(item.first, item.second);
+        latchCnt++;
+    }
+    loopInfo.analyze(function);
+}
+
+// 把 header 的前驱 preBBs 并到一个新块上, 返回新块
+inline BasicBlock* LoopSimplify::mergePreds(BasicBlock* header, std::vector<BasicBlock*>& preBBs) {
+    // 顺序落入 header 的前驱补上跳转, 新块插入后不会改变它的去向
+    for(BasicBlock* preBB : preBBs) {
+        auto& irs = preBB->getIr();
+        if(irs.empty() || (typeid(*irs.back()) != typeid(JumpIR) && typeid(*irs.back()) != typeid(BranchIR))) {
+            irs.push_back(new JumpIR(header));
+        }
+    }
+    // 先记下各前驱上的 phi 参数, splitEdge 会把第一个前驱的参数改挂到新块上
+    std::vector<PhiIR*> phis;
+    for(auto ir : header->getIr()) {
+        if(typeid(*ir) != typeid(PhiIR)) break;
+        if(!ir->isDeleted()) phis.push_back(dynamic_cast<PhiIR*>(ir));
+    }
+    std::vector<std::vector<Value*>> vals(phis.size());
+    for(size_t i(0); i < phis.size(); i++) {
+        for(BasicBlock* preBB : preBBs) {
+            auto it = phis[i]->params.find(preBB);
+            vals[i].push_back(it == phis[i]->params.end() ? nullptr : it->second);
+        }
+    }
+
+    BasicBlock* nb = dominateTree.splitEdge(function, preBBs[0], header);
+    for(size_t k(1); k < preBBs.size(); k++) {
+        preBBs[k]->replaceTarget(header, nb);
+        dominateTree.insertEdge(function, preBBs[k], nb);
+        dominateTree.deleteEdge(function, preBBs[k], header);
+    }
+
+    std::vector<Instruction*> newPhis;
+    for(size_t i(0); i < phis.size(); i++) {
+        auto& params = phis[i]->params;
+        for(size_t k(1); k < preBBs.size(); k++) {
+            params.erase(preBBs[k]);
+        }
+        bool same = true;
+        for(size_t k(1); k < preBBs.size(); k++) {
+            same = same && sameVal(vals[i][0], vals[i][k]);
+        }
+        if(same) {
+            params[nb] = vals[i][0];
+            continue;
+        }
+        Value* dst = new VarValue("", getDefVal(phis[i])->getType(), false, function->varCnt++);
+        PhiIR* phi = new PhiIR({}, dst);
+        for(size_t k(0); k < preBBs.size(); k++) {
+            phi->params[preBBs[k]] = vals[i][k];
+        }
+        newPhis.push_back(phi);
+        params[nb] = wrapVal(dst);
+    }
+    nb->getIr().insert(nb->getIr().begin(), newPhis.begin(), newPhis.end());
+    return nb;
+}
+
+// phi 参数相同: 同一个变量, 或值相同的常量
+inline bool LoopSimplify::sameVal(Value* a, Value* b) {
+    if(a == b) return true;
+    if(!a || !b || typeid(*a) != typeid(TempVal) || typeid(*b) != typeid(TempVal)) return false;
+    TempVal* x = dynamic_cast<TempVal*>(a);
+    TempVal* y = dynamic_cast<TempVal*>(b);
+    if(x->getVal() || y->getVal()) return x->getVal() == y->getVal();
+    if(x->isFloat() != y->isFloat()) return false;
+    return x->isFloat() ? x->getFloat() == y->getFloat() : x->getInt() == y->getInt();
+}
+
+#endif //SYSY2022_BJTU_LOOPSIMPLIFY_HH
@@ -0,0 +1,540 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_LOOPUNROLL_HH
+#define SYSY2022_BJTU_LOOPUNROLL_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "LoopInfo.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <climits>
+
+// 循环展开, 只处理最内层、规范形式且只从首块退出的循环
+// 首块的条件为 i op n, i 是首块 phi, 回边上为 i + c, n 是常数或循环不变量, 真分支留在循环内
+// 完全展开: init、n 都是常数时模拟求出次数, 次数和展开后的规模不超过阈值时复制成直线代码
+// 部分展开(-funroll-loops): 新循环每轮执行 factor 份循环体, 首块测试 i op n - (factor - 1) * c,
+// 剩下的轮数交给原循环; n 不是常数时前置块先检查 n - (factor - 1) * c 不溢出, 溢出则直接走原循环
+class LoopUnroll {
+private:
+    struct Candidate {
+        BasicBlock* header;
+        BasicBlock* preheader;
+        BasicBlock* latch;
+        BasicBlock* exit;
+        BasicBlock* body;
+        std::vector<BasicBlock*> bbs;
+        std::vector<PhiIR*> phis;
+        Value* iv;
+        int step;
+        // 归一化为 i op bound, bound 为空时是常数 boundConst
+        const std::type_info* op;
+        Value* bound;
+        int boundConst;
+        int size;
+        int trip;
+    };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    DominateTree dominateTree;
+    LoopInfo loopInfo;
+    bool partial;
+    int factor;
+    std::vector<BasicBlock*> newBBs;
+
+    // 完全展开的次数、展开后的指令数上限, 部分展开后循环体的指令数上限
+    static const int maxFullTrip = 64;
+    static const int maxFullSize = 320;
+    static const int maxPartialSize = 240;
+
+    int fullCnt = 0;
+    int partialCnt = 0;
+
+    bool analyze(Loop* loop, Candidate& c);
+    static int tripCount(Candidate& c, long long i);
+    static bool compare(const std::type_info& op, long long a, long long b);
+    static Instruction* terminatorOf(BasicBlock* bb);
+    BasicBlock* newBlock();
+    Value* newVar(Type* type) { return new VarValue("", type, false, function->varCnt++); }
+    Value* materialize(Value* val, BasicBlock* bb);
+    BasicBlock* cloneIteration(Candidate& c, std::unordered_map<Value*, Value*>& valMap, BasicBlock* headerCopy,
+                               BasicBlock* next, std::vector<Value*>& vals, std::vector<BasicBlock*>& layout);
+    void cloneHeader(Candidate& c, std::unordered_map<Value*, Value*>& valMap, BasicBlock* headerCopy);
+    void setTerminator(BasicBlock* bb, Instruction* term);
+    void replaceLoop(Candidate& c, std::vector<BasicBlock*>& layout, bool removeLoop);
+    void fullUnroll(Candidate& c);
+    bool partialUnroll(Candidate& c);
+    void removeDeadCopies();
+public:
+    LoopUnroll(IrVisitor* irVisitor, bool partial = false, int factor = 4)
+        : irVisitor(irVisitor), dominateTree(irVisitor), partial(partial), factor(factor) {;}
+    void execute();
+    int getFullCnt() { return fullCnt; }
+    int getPartialCnt() { return partialCnt; }
+};
+
+inline void LoopUnroll::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        loopInfo.analyze(func);
+        // 先分析完所有循环再改, 改动后块号失效
+        std::vector<Candidate> candidates;
+        for(Loop* loop : loopInfo.getLoops()) {
+            Candidate c;
+            if(analyze(loop, c)) candidates.push_back(c);
+        }
+        newBBs.clear();
+        bool changed = false;
+        for(Candidate& c : candidates) {
+            if(c.trip > 0 && c.trip <= maxFullTrip && (long long) (c.trip + 1) * c.size <= maxFullSize) {
+                fullUnroll(c);
+                fullCnt++;
+                changed = true;
+            } else if(partial && factor > 1 && partialUnroll(c)) {
+                partialCnt++;
+                changed = true;
+            }
+        }
+        if(!changed) continue;
+        removeDeadCopies();
+        func->renumberBB();
+        dominateTree.getIdom(func);
+        dominateTree.getDomFront(func);
+        dominateTree.genDominateTree(func);
+    }
+}
+
+// 块的终结指令, 顺序落入时返回 nullptr
+inline Instruction* LoopUnroll::terminatorOf(BasicBlock* bb) {
+    auto& irs = bb->getIr();
+    if(irs.empty() || irs.back()->isDeleted()) return nullptr;
+    const std::type_info& t = typeid(*irs.back());
+    return t == typeid(JumpIR) || t == typeid(BranchIR) || t == typeid(ReturnIR) ? irs.back() : nullptr;
+}
+
+inline bool LoopUnroll::compare(const std::type_info& op, long long a, long long b) {
+    if(op == typeid(LTIIR)) return a < b;
+    if(op == typeid(LEIIR)) return a <= b;
+    if(op == typeid(GTIIR)) return a > b;
+    if(op == typeid(GEIIR)) return a >= b;
+    return a != b;
+}
+
+inline BasicBlock* LoopUnroll::newBlock() {
+    BasicBlock* bb = new NormalBlock(nullptr, function->name, function->bbCnt++);
+    newBBs.push_back(bb);
+    return bb;
+}
+
+inline bool LoopUnroll::analyze(Loop* loop, Candidate& c) {
+    if(!loop->subLoops.empty() || !loop->getPreheader() || !loop->getLatch()) return false;
+    if(loop->exitings.size() != 1 || loop->exitings[0] != loop->header || loop->exits.size() != 1) return false;
+    c.header = loop->header;
+    c.preheader = loop->getPreheader();
+    c.latch = loop->getLatch();
+    c.exit = loop->exits[0];
+    c.bbs = loop->bbs;
+    Instruction* preTerm = terminatorOf(c.preheader);
+    if(preTerm && typeid(*preTerm) != typeid(JumpIR)) return false;
+    Instruction* term = terminatorOf(c.header);
+    if(!term || typeid(*term) != typeid(BranchIR)) return false;
+    BranchIR* branchIr = dynamic_cast<BranchIR*>(term);
+    if(!loop->contains(branchIr->trueTarget) || branchIr->falseTarget != c.exit) return false;
+    c.body = branchIr->trueTarget;
+
+    // 循环内的定值和规模
+    std::unordered_map<Value*, Instruction*> defs;
+    c.size = 0;
+    for(BasicBlock* bb : c.bbs) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            // 局部数组不复制
+            if(dynamic_cast<AllocIR*>(ir)) return false;
+            c.size++;
+            Value* dst = getDefVal(ir);
+            if(dst) defs[dst] = ir;
+        }
+    }
+    c.phis.clear();
+    for(auto ir : c.header->getIr()) {
+        if(typeid(*ir) != typeid(PhiIR)) break;
+        if(ir->isDeleted()) continue;
+        PhiIR* phi = dynamic_cast<PhiIR*>(ir);
+        if(phi->params.size() != 2 || !phi->params.count(c.preheader) || !phi->params.count(c.latch)) return false;
+        c.phis.push_back(phi);
+    }
+
+    // 条件 i op n, i 在右边时交换
+    auto condIt = defs.find(getUseVal(branchIr->getOperands()[1]));
+    if(condIt == defs.end()) return false;
+    Instruction* cmp = condIt->second;
+    const std::type_info& t = typeid(*cmp);
+    if(t != typeid(LTIIR) && t != typeid(LEIIR) && t != typeid(GTIIR) && t != typeid(GEIIR) && t != typeid(NEIIR)) return false;
+    TempVal* left = dynamic_cast<TempVal*>(cmp->getOperands()[1]->getVal());
+    TempVal* right = dynamic_cast<TempVal*>(cmp->getOperands()[2]->getVal());
+    PhiIR* ivPhi = nullptr;
+    TempVal* other = nullptr;
+    for(PhiIR* phi : c.phis) {
+        if(left->getVal() && left->getVal() == getDefVal(phi)) {
+            ivPhi = phi;
+            other = right;
+            c.op = &t;
+        } else if(right->getVal() && right->getVal() == getDefVal(phi)) {
+            ivPhi = phi;
+            other = left;
+            c.op = t == typeid(LTIIR) ? &typeid(GTIIR) : t == typeid(LEIIR) ? &typeid(GEIIR)
+                 : t == typeid(GTIIR) ? &typeid(LTIIR) : t == typeid(GEIIR) ? &typeid(LEIIR) : &t;
+        }
+    }
+    if(!ivPhi || other->getVal() == getDefVal(ivPhi) || other->getType()->isFloat()) return false;
+    c.iv = getDefVal(ivPhi);
+    if(c.iv->getType()->isFloat() || c.iv->getType()->isPointer()) return false;
+    c.bound = other->getVal();
+    c.boundConst = c.bound ? 0 : other->getInt();
+    if(c.bound && defs.count(c.bound)) return false;
+
+    // 回边上的值为 i + c
+    TempVal* next = dynamic_cast<TempVal*>(ivPhi->params[c.latch]);
+    if(!next || !next->getVal() || !defs.count(next->getVal())) return false;
+    Instruction* inc = defs[next->getVal()];
+    if(typeid(*inc) != typeid(AddIIR) && typeid(*inc) != typeid(SubIIR)) return false;
+    TempVal* a = dynamic_cast<TempVal*>(inc->getOperands()[1]->getVal());
+    TempVal* b = dynamic_cast<TempVal*>(inc->getOperands()[2]->getVal());
+    if(typeid(*inc) == typeid(AddIIR) && a->getVal() == c.iv && !b->getVal()) {
+        c.step = b->getInt();
+    } else if(typeid(*inc) == typeid(AddIIR) && b->getVal() == c.iv && !a->getVal()) {
+        c.step = a->getInt();
+    } else if(typeid(*inc) == typeid(SubIIR) && a->getVal() == c.iv && !b->getVal() && b->getInt() != INT_MIN) {
+        c.step = -b->getInt();
+    } else {
+        return false;
+    }
+    if(c.step == 0) return false;
+    TempVal* init = dynamic_cast<TempVal*>(ivPhi->params[c.preheader]);
+    c.trip = init && !init->getVal() && !c.bound ? tripCount(c, init->getInt()) : -1;
+    return true;
+}
+
+// init、n 都是常数时模拟求循环次数, 超过上限或溢出返回 -1
+inline int LoopUnroll::tripCount(Candidate& c, long long i) {
+    int trip = 0;
+    while(compare(*c.op, i, c.boundConst)) {
+        i += c.step;
+        if(++trip > maxFullTrip || i < INT_MIN || i > INT_MAX) return -1;
+    }
+    return trip;
+}
+
+// phi 参数为常量时放进新变量, 插在 bb 开头
+inline Value* LoopUnroll::materialize(Value* val, BasicBlock* bb) {
+    TempVal* t = dynamic_cast<TempVal*>(val);
+    if(!t) return val;
+    if(t->getVal()) return t->getVal();
+    Value* dst = newVar(t->getType());
+    bb->getIr().insert(bb->getIr().begin(), new MoveIR(dst, new TempVal(*t)));
+    return dst;
+}
+
+// 首块除 phi 和分支外的指令复制到 headerCopy
+inline void LoopUnroll::cloneHeader(Candidate& c, std::unordered_map<Value*, Value*>& valMap, BasicBlock* headerCopy) {
+    std::unordered_map<BasicBlock*, BasicBlock*> bbMap;
+    Instruction* term = terminatorOf(c.header);
+    for(auto ir : c.header->getIr()) {
+        if(ir->isDeleted() || ir == term || typeid(*ir) == typeid(PhiIR)) continue;
+        Value* dst = getDefVal(ir);
+        if(dst) valMap[dst] = cloneVar(dst, function);
+        headerCopy->getIr().push_back(cloneIR(ir, valMap, bbMap));
+    }
+}
+
+// 复制一轮循环, valMap 进来时给出首块 phi 在这一轮的值, 出来时含这一轮所有定值的副本
+// 首块复制到 headerCopy 并直接进入循环体, 回边改为跳到 next; vals 返回下一轮各 phi 的值, 返回回边块的副本
+inline BasicBlock* LoopUnroll::cloneIteration(Candidate& c, std::unordered_map<Value*, Value*>& valMap,
+                                              BasicBlock* headerCopy, BasicBlock* next, std::vector<Value*>& vals,
+                                              std::vector<BasicBlock*>& layout) {
+    std::unordered_map<BasicBlock*, BasicBlock*> bbMap;
+    bbMap[c.header] = headerCopy;
+    layout.push_back(headerCopy);
+    for(BasicBlock* bb : c.bbs) {
+        if(bb == c.header) continue;
+        bbMap[bb] = newBlock();
+        layout.push_back(bbMap[bb]);
+    }
+    for(BasicBlock* bb : c.bbs) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted() || (bb == c.header && typeid(*ir) == typeid(PhiIR))) continue;
+            Value* dst = getDefVal(ir);
+            if(dst) valMap[dst] = cloneVar(dst, function);
+        }
+    }
+    for(BasicBlock* bb : c.bbs) {
+        BasicBlock* nb = bbMap[bb];
+        Instruction* term = terminatorOf(bb);
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted() || ir == term || (bb == c.header && typeid(*ir) == typeid(PhiIR))) continue;
+            nb->getIr().push_back(cloneIR(ir, valMap, bbMap));
+        }
+        BasicBlock* target;
+        if(bb == c.header) {
+            target = c.body == c.header ? next : bbMap[c.body];
+        } else if(term) {
+            nb->getIr().push_back(cloneIR(term, valMap, bbMap));
+            nb->replaceTarget(headerCopy, next);
+            continue;
+        } else {
+            // 顺序落入的块补上跳转
+            target = bb->getSucc()[0] == c.header ? next : bbMap[bb->getSucc()[0]];
+        }
+        nb->getIr().push_back(new JumpIR(target));
+    }
+    vals.clear();
+    for(PhiIR* phi : c.phis) {
+        TempVal* t = dynamic_cast<TempVal*>(phi->params[c.latch]);
+        auto it = t && t->getVal() ? valMap.find(t->getVal()) : valMap.end();
+        vals.push_back(it == valMap.end() ? phi->params[c.latch] : wrapVal(it->second));
+    }
+    return bbMap[c.latch];
+}
+
+// 换掉 bb 的终结指令(顺序落入时直接追加), 原出边一并去掉
+inline void LoopUnroll::setTerminator(BasicBlock* bb, Instruction* term) {
+    if(terminatorOf(bb)) bb->getIr().pop_back();
+    bb->getIr().push_back(term);
+    std::vector<BasicBlock*> succs = bb->getSucc();
+    for(BasicBlock* succBB : succs) {
+        bb->removeSucc(succBB);
+    }
+}
+
+// 新块按终结指令补上出边, 放到原首块之前; removeLoop 时去掉原循环的块
+inline void LoopUnroll::replaceLoop(Candidate& c, std::vector<BasicBlock*>& layout, bool removeLoop) {
+    for(BasicBlock* bb : layout) {
+        Instruction* term = terminatorOf(bb);
+        if(typeid(*term) == typeid(JumpIR)) {
+            bb->addSucc(dynamic_cast<JumpIR*>(term)->target);
+        } else if(typeid(*term) == typeid(BranchIR)) {
+            bb->addSucc(dynamic_cast<BranchIR*>(term)->trueTarget);
+            bb->addSucc(dynamic_cast<BranchIR*>(term)->falseTarget);
+        }
+    }
+    std::unordered_set<BasicBlock*> loopBBs(c.bbs.begin(), c.bbs.end());
+    if(removeLoop) {
+        for(BasicBlock* bb : c.bbs) {
+            std::vector<BasicBlock*> succs = bb->getSucc();
+            for(BasicBlock* succBB : succs) {
+                bb->removeSucc(succBB);
+            }
+        }
+    }
+    std::vector<BasicBlock*> res;
+    for(BasicBlock* bb : function->getBB()) {
+        if(bb == c.header) res.insert(res.end(), layout.begin(), layout.end());
+        if(!removeLoop || !loopBBs.count(bb)) res.push_back(bb);
+    }
+    function->getBB() = res;
+}
+
+// 完全展开: 每轮复制一份, 最后一份只含首块的非 phi 指令, 之后跳到出口
+inline void LoopUnroll::fullUnroll(Candidate& c) {
+    std::vector<BasicBlock*> layout;
+    std::vector<BasicBlock*> entries;
+    for(int k(0); k <= c.trip; k++) {
+        entries.push_back(newBlock());
+    }
+    std::vector<Value*> vals;
+    for(PhiIR* phi : c.phis) {
+        vals.push_back(phi->params[c.preheader]);
+    }
+    std::unordered_map<Value*, Value*> valMap;
+    for(int k(0); k <= c.trip; k++) {
+        valMap.clear();
+        for(size_t i(0); i < c.phis.size(); i++) {
+            valMap[getDefVal(c.phis[i])] = materialize(vals[i], entries[k]);
+        }
+        if(k < c.trip) {
+            cloneIteration(c, valMap, entries[k], entries[k + 1], vals, layout);
+        } else {
+            cloneHeader(c, valMap, entries[k]);
+            entries[k]->getIr().push_back(new JumpIR(c.exit));
+            layout.push_back(entries[k]);
+        }
+    }
+
+    // 循环外对首块定值的使用改为最后一份的值
+    std::unordered_set<BasicBlock*> loopBBs(c.bbs.begin(), c.bbs.end());
+    std::vector<Use*> uses;
+    for(BasicBlock* bb : function->getBB()) {
+        if(loopBBs.count(bb)) continue;
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    auto it = t && t->getVal() ? valMap.find(t->getVal()) : valMap.end();
+                    if(it != valMap.end()) t->setVal(it->second);
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                Value* val = getUseVal(use);
+                auto it = val ? valMap.find(val) : valMap.end();
+                if(it != valMap.end()) setUseVal(use, it->second);
+            }
+        }
+    }
+    c.exit->replacePhiPre(c.header, entries[c.trip]);
+    setTerminator(c.preheader, new JumpIR(entries[0]));
+    c.preheader->addSucc(entries[0]);
+    replaceLoop(c, layout, true);
+}
+
+// 部分展开: 前置块 -> [检查] -> 展开的循环 -> 余数块 -> 原循环
+inline bool LoopUnroll::partialUnroll(Candidate& c) {
+    int f = factor;
+    while(f > 1 && (long long) f * c.size > maxPartialSize) f--;
+    if(f < 2) return false;
+    const std::type_info& op = *c.op;
+    if(c.step > 0 ? op != typeid(LTIIR) && op != typeid(LEIIR) : op != typeid(GTIIR) && op != typeid(GEIIR)) return false;
+    long long k = (long long) (f - 1) * c.step;
+    if(k < INT_MIN || k > INT_MAX) return false;
+    Type* intType = c.iv->getType();
+    bool guard = c.bound != nullptr;
+    if(!guard && (c.boundConst - k < INT_MIN || c.boundConst - k > INT_MAX)) return false;
+
+    BasicBlock* entry = guard ? newBlock() : nullptr;
+    BasicBlock* header = newBlock();
+    BasicBlock* remainder = newBlock();
+    std::vector<BasicBlock*> layout;
+    if(entry) layout.push_back(entry);
+    layout.push_back(header);
+
+    // 新的上界, n 不是常数时检查 n - k 不溢出
+    TempVal lim = intConst(c.boundConst - k);
+    if(guard) {
+        Value* limVar = newVar(intType);
+        Value* ok = newVar(intType);
+        std::vector<Instruction*> code;
+        code.push_back(new SubIIR(*wrapVal(limVar), *wrapVal(c.bound), intConst(k)));
+        if(c.step > 0) {
+            code.push_back(new GEIIR(*wrapVal(ok), *wrapVal(c.bound), intConst(INT_MIN + k)));
+        } else {
+            code.push_back(new LEIIR(*wrapVal(ok), *wrapVal(c.bound), intConst(INT_MAX + k)));
+        }
+        setTerminator(c.preheader, new BranchIR(entry, remainder, ok));
+        auto& irs = c.preheader->getIr();
+        irs.insert(irs.end() - 1, code.begin(), code.end());
+        c.preheader->addSucc(entry);
+        c.preheader->addSucc(remainder);
+        entry->getIr().push_back(new JumpIR(header));
+        lim = *wrapVal(limVar);
+    } else {
+        setTerminator(c.preheader, new JumpIR(header));
+        c.preheader->addSucc(header);
+    }
+
+    // 新循环首块的 phi 和测试
+    BasicBlock* outer = guard ? entry : c.preheader;
+    std::vector<PhiIR*> phis;
+    std::unordered_map<Value*, Value*> valMap;
+    for(PhiIR* phi : c.phis) {
+        Value* dst = cloneVar(getDefVal(phi), function);
+        PhiIR* res = new PhiIR({}, dst);
+        res->params[outer] = new TempVal(*dynamic_cast<TempVal*>(phi->params[c.preheader]));
+        header->getIr().push_back(res);
+        phis.push_back(res);
+        valMap[getDefVal(phi)] = dst;
+    }
+    Value* test = newVar(intType);
+    header->getIr().push_back(newArithmetic(op, *wrapVal(test), *wrapVal(valMap[c.iv]), lim));
+    std::vector<BasicBlock*> entries;
+    for(int j(0); j < f; j++) {
+        entries.push_back(newBlock());
+    }
+    header->getIr().push_back(new BranchIR(entries[0], remainder, test));
+
+    std::vector<Value*> vals;
+    BasicBlock* latch = nullptr;
+    for(int j(0); j < f; j++) {
+        if(j > 0) {
+            valMap.clear();
+            for(size_t i(0); i < c.phis.size(); i++) {
+                valMap[getDefVal(c.phis[i])] = materialize(vals[i], entries[j]);
+            }
+        }
+        latch = cloneIteration(c, valMap, entries[j], j + 1 < f ? entries[j + 1] : header, vals, layout);
+    }
+    for(size_t i(0); i < phis.size(); i++) {
+        phis[i]->params[latch] = new TempVal(*dynamic_cast<TempVal*>(vals[i]));
+    }
+
+    // 余数块: 原循环从新循环结束时的值(检查失败时为初值)继续
+    c.header->replacePhiPre(c.preheader, remainder);
+    for(size_t i(0); i < c.phis.size(); i++) {
+        Value* val = getDefVal(phis[i]);
+        if(guard) {
+            val = cloneVar(val, function);
+            PhiIR* res = new PhiIR({}, val);
+            res->params[c.preheader] = new TempVal(*dynamic_cast<TempVal*>(c.phis[i]->params[remainder]));
+            res->params[header] = wrapVal(getDefVal(phis[i]));
+            remainder->getIr().push_back(res);
+        }
+        c.phis[i]->params[remainder] = wrapVal(val);
+    }
+    remainder->getIr().push_back(new JumpIR(c.header));
+    layout.push_back(remainder);
+    replaceLoop(c, layout, false);
+    return true;
+}
+
+// 展开复制出的无用纯指令(如每份的循环条件)直接删掉
+inline void LoopUnroll::removeDeadCopies() {
+    std::unordered_map<Value*, int> useCnt;
+    std::vector<Use*> uses;
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    if(t && t->getVal()) useCnt[t->getVal()]++;
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                if(getUseVal(use)) useCnt[getUseVal(use)]++;
+            }
+        }
+    }
+    auto isPure = [](Instruction* ir) {
+        const std::type_info& t = typeid(*ir);
+        return dynamic_cast<ArithmeticIR*>(ir) || t == typeid(MoveIR) || t == typeid(GEPIR) || t == typeid(UnaryIR)
+               || t == typeid(CastInt2FloatIR) || t == typeid(CastFloat2IntIR);
+    };
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(BasicBlock* bb : newBBs) {
+            for(auto it = bb->getIr().rbegin(); it != bb->getIr().rend(); it++) {
+                Instruction* ir = *it;
+                if(ir->isDeleted() || !isPure(ir) || useCnt[getDefVal(ir)] > 0) continue;
+                getUseOperands(ir, uses);
+                for(Use* use : uses) {
+                    if(getUseVal(use)) useCnt[getUseVal(use)]--;
+                }
+                ir->deleteIR();
+                changed = true;
+            }
+        }
+    }
+}
+
+#endif //SYSY2022_BJTU_LOOPUNROLL_HH
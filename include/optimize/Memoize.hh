@@ -0,0 +1,208 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_MEMOIZE_HH
+#define SYSY2022_BJTU_MEMOIZE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "PurityAnalysis.hh"
+#include "IRHelper.hh"
+#include <vector>
+
+// 纯递归函数的记忆化, 在 SSA 上做(-fmemoize)
+// 条件: 纯函数, 至少两处调用自身(可能指数级), 1~3 个 int 形参, 返回 int 或 float
+// 每个函数在 .bss 里建两张表: 结果和是否已算出, 实参都在 [0, range) 内才查表/填表, range^形参数 <= tableSize
+// 入口:   ok = 各实参在范围内; ok ? 查表 : 原入口
+// 查表:   已算出则直接返回表中结果, 否则进原入口
+// 原来的返回都跳到新的出口块, 用 phi 合并返回值, ok 时填表后返回
+class Memoize {
+private:
+    IrVisitor* irVisitor;
+    DominateTree dominateTree;
+    PurityAnalysis purity;
+    Function* function;
+    int range;
+
+    static const int tableSize = 4096;
+
+    int funcCnt = 0;
+
+    bool isCandidate(Function* func);
+    void transform();
+    // 在 bb 末尾算出表下标
+    Value* genKey(BasicBlock* bb);
+    Value* newVar(Type* type) { return new VarValue("", type, false, function->varCnt++); }
+    TempVal* constInt(int val);
+public:
+    Memoize(IrVisitor* irVisitor) : irVisitor(irVisitor), dominateTree(irVisitor), purity(irVisitor) {;}
+    void execute();
+    int getPureCnt() { return purity.getPureCnt(); }
+    int getFuncCnt() { return funcCnt; }
+};
+
+inline void Memoize::execute() {
+    purity.analyze();
+    for(Function* func : irVisitor->getFunctions()) {
+        if(!isCandidate(func)) continue;
+        this->function = func;
+        range = tableSize;
+        if(func->params.size() == 2) range = 64;
+        if(func->params.size() == 3) range = 16;
+        transform();
+        funcCnt++;
+        func->renumberBB();
+        dominateTree.getIdom(func);
+        dominateTree.getDomFront(func);
+        dominateTree.genDominateTree(func);
+    }
+}
+
+inline bool Memoize::isCandidate(Function* func) {
+    if(!purity.isPure(func) || func->name == "main") return false;
+    if(!func->return_type->isInt() && !func->return_type->isFloat()) return false;
+    if(func->params.empty() || func->params.size() > 3) return false;
+    for(Value* param : func->params) {
+        if(!param->getType()->isInt()) return false;
+    }
+    int selfCalls = 0;
+    for(BasicBlock* bb : func->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(!ir->isDeleted() && typeid(*ir) == typeid(CallIR) && dynamic_cast<CallIR*>(ir)->func == func) selfCalls++;
+        }
+    }
+    return selfCalls >= 2;
+}
+
+inline TempVal* Memoize::constInt(int val) {
+    TempVal* res = new TempVal();
+    res->setType(new Type(TypeID::INT));
+    res->setInt(val);
+    return res;
+}
+
+// key = ((a0 * range) + a1) * range + a2, 只在实参都在范围内的路径上算, 不会溢出
+inline Value* Memoize::genKey(BasicBlock* bb) {
+    Type* intType = new Type(TypeID::INT);
+    auto& irs = bb->getIr();
+    Value* key = function->params[0];
+    for(size_t i(1); i < function->params.size(); i++) {
+        Value* mul = newVar(intType);
+        irs.push_back(new MulIIR(*wrapVal(mul), *wrapVal(key), *constInt(range)));
+        key = newVar(intType);
+        irs.push_back(new AddIIR(*wrapVal(key), *wrapVal(mul), *wrapVal(function->params[i])));
+    }
+    return key;
+}
+
+inline void Memoize::transform() {
+    Type* intType = new Type(TypeID::INT);
+    Type* retType = function->return_type;
+    bool isFloat = retType->isFloat();
+
+    // 结果表和标记表, 放在 .bss 里初值为 0
+    int len = 1;
+    for(size_t i(0); i < function->params.size(); i++) len *= range;
+    auto newTable = [&](const std::string& kind, Type* elemType) {
+        Value* table = new VarValue("_m_memo_" + kind + "_" + function->name, new Type(TypeID::POINTER, elemType), true, 0);
+        table->setArray(true);
+        table->setArrayDims({len});
+        irVisitor->pushGlobalVars(table);
+        return table;
+    };
+    Value* valTable = newTable("val", isFloat ? new Type(TypeID::FLOAT) : new Type(TypeID::INT));
+    Value* setTable = newTable("set", new Type(TypeID::INT));
+
+    auto& bbs = function->getBB();
+    BasicBlock* body = bbs[0];
+    auto newBB = [&]() { return new NormalBlock(nullptr, function->name, function->bbCnt++); };
+    BasicBlock* entry = newBB();
+    BasicBlock* lookup = newBB();
+    BasicBlock* hit = newBB();
+    BasicBlock* exit = newBB();
+    BasicBlock* save = newBB();
+    BasicBlock* done = newBB();
+
+    // 入口: ok = (a0 >= 0) * (a0 < range) * ...
+    Value* ok = nullptr;
+    for(Value* param : function->params) {
+        for(int i(0); i < 2; i++) {
+            Value* cmp = newVar(intType);
+            if(i == 0) entry->getIr().push_back(new GEIIR(*wrapVal(cmp), *wrapVal(param), *constInt(0)));
+            else entry->getIr().push_back(new LTIIR(*wrapVal(cmp), *wrapVal(param), *constInt(range)));
+            if(ok) {
+                Value* both = newVar(intType);
+                entry->getIr().push_back(new MulIIR(*wrapVal(both), *wrapVal(ok), *wrapVal(cmp)));
+                cmp = both;
+            }
+            ok = cmp;
+        }
+    }
+    entry->getIr().push_back(new BranchIR(lookup, body, ok));
+    entry->addSucc(lookup);
+    entry->addSucc(body);
+
+    // 查表
+    Value* key = genKey(lookup);
+    Value* setAddr = newVar(setTable->getType());
+    Value* isSet = newVar(intType);
+    lookup->getIr().push_back(new GEPIR(setAddr, setTable, key));
+    lookup->getIr().push_back(new LoadIIR(isSet, setAddr));
+    lookup->getIr().push_back(new BranchIR(hit, body, isSet));
+    lookup->addSucc(hit);
+    lookup->addSucc(body);
+
+    Value* valAddr = newVar(valTable->getType());
+    Value* memo = newVar(retType);
+    hit->getIr().push_back(new GEPIR(valAddr, valTable, key));
+    if(isFloat) hit->getIr().push_back(new LoadFIR(memo, valAddr));
+    else hit->getIr().push_back(new LoadIIR(memo, valAddr));
+    hit->getIr().push_back(new ReturnIR(memo));
+
+    // 原来的返回都跳到出口
+    Value* res = newVar(retType);
+    PhiIR* phi = new PhiIR({}, res);
+    for(BasicBlock* bb : bbs) {
+        auto& irs = bb->getIr();
+        if(irs.empty() || irs.back()->isDeleted() || typeid(*irs.back()) != typeid(ReturnIR)) continue;
+        ReturnIR* ret = dynamic_cast<ReturnIR*>(irs.back());
+        Value* v = getUseVal(ret->getOperands()[1]);
+        TempVal* x;
+        if(v) {
+            x = wrapVal(v);
+        } else {
+            x = new TempVal();
+            x->setType(new Type(ret->useInt ? TypeID::INT : TypeID::FLOAT));
+            if(ret->useInt) x->setInt(ret->retInt);
+            else x->setFloat(ret->retFloat);
+            x = castConst(x, retType);
+        }
+        phi->params[bb] = x;
+        irs.back() = new JumpIR(exit);
+        bb->addSucc(exit);
+    }
+    exit->getIr().push_back(phi);
+    exit->getIr().push_back(new BranchIR(save, done, ok));
+    exit->addSucc(save);
+    exit->addSucc(done);
+
+    // 填表
+    key = genKey(save);
+    Value* saveVal = newVar(valTable->getType());
+    Value* saveSet = newVar(setTable->getType());
+    save->getIr().push_back(new GEPIR(saveVal, valTable, key));
+    if(isFloat) save->getIr().push_back(new StoreFIR(saveVal, *wrapVal(res)));
+    else save->getIr().push_back(new StoreIIR(saveVal, *wrapVal(res)));
+    save->getIr().push_back(new GEPIR(saveSet, setTable, key));
+    save->getIr().push_back(new StoreIIR(saveSet, *constInt(1)));
+    save->getIr().push_back(new JumpIR(done));
+    save->addSucc(done);
+    done->getIr().push_back(new ReturnIR(res));
+
+    bbs.insert(bbs.begin(), {entry, lookup, hit});
+    bbs.insert(bbs.end(), {exit, save, done});
+}
+
+#endif //SYSY2022_BJTU_MEMOIZE_HH
@@ -0,0 +1,163 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_OUTOFSSA_HH
+#define SYSY2022_BJTU_OUTOFSSA_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <map>
+#include <set>
+
+// 消去 phi, 退出 SSA
+// 先拆关键边, 使每个前驱只流向一个含 phi 的块, 避免 lost copy
+// 同一前驱上的 phi 赋值是并行拷贝, 按依赖排序成串行 MoveIR, 每个环只用一个临时变量, 避免 swap 问题
+// 拷贝插在前驱的跳转之前; 需要有效的支配树, 拆边时增量维护
+class OutOfSSA {
+private:
+    typedef std::vector<std::pair<Value*, TempVal*>> CopyList;
+    IrVisitor* irVisitor;
+    Function* function;
+    DominateTree dominateTree;
+
+    int splitCnt = 0;
+    int copyCnt = 0;
+    int tempCnt = 0;
+
+    void splitCriticalEdges();
+    void sequentialize(CopyList& copies, std::vector<Instruction*>& moves);
+    void insertMoves(BasicBlock* bb, std::vector<Instruction*>& moves);
+public:
+    OutOfSSA(IrVisitor* irVisitor) : irVisitor(irVisitor), dominateTree(irVisitor) {;}
+    void execute();
+    int getSplitCnt() { return splitCnt; }
+    int getCopyCnt() { return copyCnt; }
+    int getTempCnt() { return tempCnt; }
+};
+
+inline void OutOfSSA::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+
+        bool hasPhi = false;
+        for(BasicBlock* bb : func->getBB()) {
+            if(!bb->getIr().empty() && typeid(*bb->getIr()[0]) == typeid(PhiIR)) {
+                hasPhi = true;
+                break;
+            }
+        }
+        if(!hasPhi) continue;
+        splitCriticalEdges();
+
+        // 每个前驱上的并行拷贝, 按块id索引
+        std::vector<BasicBlock*>& bbs = func->getBB();
+        std::vector<CopyList> copies(bbs.size());
+        for(BasicBlock* bb : bbs) {
+            auto& irs = bb->getIr();
+            size_t phiEnd = 0;
+            while(phiEnd < irs.size() && typeid(*irs[phiEnd]) == typeid(PhiIR)) {
+                PhiIR* phi = dynamic_cast<PhiIR*>(irs[phiEnd]);
+                Value* dst = getDefVal(phi);
+                for(BasicBlock* preBB : bb->getPre()) {
+                    if(phi->isDeleted()) break;
+                    auto it = phi->params.find(preBB);
+                    if(it == phi->params.end() || !it->second) continue;
+                    TempVal* src = typeid(*it->second) == typeid(TempVal) ? dynamic_cast<TempVal*>(it->second)
+                                                                         : wrapVal(it->second);
+                    copies[preBB->getId()].push_back({dst, src});
+                }
+                phiEnd++;
+            }
+            irs.erase(irs.begin(), irs.begin() + phiEnd);
+        }
+        std::vector<Instruction*> moves;
+        for(BasicBlock* bb : bbs) {
+            if(copies[bb->getId()].empty()) continue;
+            sequentialize(copies[bb->getId()], moves);
+            insertMoves(bb, moves);
+        }
+    }
+}
+
+// 前驱有多个后继且后继含 phi 时, 在边上插入新块放拷贝
+inline void OutOfSSA::splitCriticalEdges() {
+    std::vector<std::pair<BasicBlock*, BasicBlock*>> edges;
+    for(BasicBlock* bb : function->getBB()) {
+        if(bb->getSucc().size() < 2) continue;
+        for(BasicBlock* succBB : bb->getSucc()) {
+            if(!succBB->getIr().empty() && typeid(*succBB->getIr()[0]) == typeid(PhiIR)) {
+                edges.push_back({bb, succBB});
+            }
+        }
+    }
+    for(auto& e : edges) {
+        dominateTree.splitEdge(function, e.first, e.second);
+    }
+    splitCnt += edges.size();
+}
+
+// 并行拷贝串行化: 目标不再被读的拷贝先做, 剩下的都在环上, 把环上一个目标的旧值存到临时变量后打开环
+// loc[a]: 变量 a 的原值当前所在位置, 原值被拷走后 a 即可被覆盖; pred[b]: 拷贝 b <- a 的源 a
+inline void OutOfSSA::sequentialize(CopyList& copies, std::vector<Instruction*>& moves) {
+    moves.clear();
+    std::map<Value*, Value*> loc, pred;
+    std::set<Value*> done;
+    std::vector<Value*> ready, todo;
+    CopyList consts;
+    for(auto& copy : copies) {
+        if(!copy.second->getVal()) {
+            consts.push_back(copy);
+        } else if(copy.second->getVal() != copy.first) {
+            loc[copy.first] = nullptr;
+            pred[copy.first] = copy.second->getVal();
+            todo.push_back(copy.first);
+        }
+    }
+    for(Value* b : todo) loc[pred[b]] = pred[b];
+    for(Value* b : todo) {
+        if(!loc[b]) ready.push_back(b);
+    }
+    while(!todo.empty()) {
+        while(!ready.empty()) {
+            Value* b = ready.back();
+            ready.pop_back();
+            Value* a = pred[b];
+            Value* c = loc[a];
+            moves.push_back(new MoveIR(b, wrapVal(c)));
+            done.insert(b);
+            loc[a] = b;
+            if(a == c && pred.count(a)) ready.push_back(a);
+        }
+        Value* b = todo.back();
+        todo.pop_back();
+        if(!done.count(b)) {
+            Value* temp = new VarValue("", b->getType(), false, function->varCnt++);
+            moves.push_back(new MoveIR(temp, wrapVal(b)));
+            loc[b] = temp;
+            ready.push_back(b);
+            tempCnt++;
+        }
+    }
+    // 常量不依赖其他拷贝, 放在最后, 以免先覆盖了还要被读的变量
+    for(auto& copy : consts) {
+        moves.push_back(new MoveIR(copy.first, castConst(copy.second, copy.first->getType())));
+    }
+    copyCnt += moves.size();
+}
+
+inline void OutOfSSA::insertMoves(BasicBlock* bb, std::vector<Instruction*>& moves) {
+    auto& irs = bb->getIr();
+    auto pos = irs.end();
+    if(!irs.empty()) {
+        const std::type_info& t = typeid(*irs.back());
+        if(t == typeid(JumpIR) || t == typeid(BranchIR) || t == typeid(ReturnIR)) pos--;
+    }
+    irs.insert(pos, moves.begin(), moves.end());
+}
+
+#endif //SYSY2022_BJTU_OUTOFSSA_HH
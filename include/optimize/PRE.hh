@@ -0,0 +1,594 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_PRE_HH
+#define SYSY2022_BJTU_PRE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "AliasAnalysis.hh"
+#include "DominateTree.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <string>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+// 部分冗余消除, 用 lazy code motion 在 SSA 的 CFG 上做, 需要有效的支配树, 必要时拆关键边
+// 表达式按词法结构编号: 同一块内由纯运算和 load 组成的小表达式树算一个表达式, 叶子是变量或常量
+// 这样不同分支里各自算出的 a[i]*k 是同一个表达式; 叶子的定值和可能改写树中 load 的指令是 kill
+// 每个表达式单独求可用/可预期, 算出最晚的插入边和可删掉的出现, 插入处复制整棵树
+// 删掉的出现改用块入口处的值, 需要时在汇合块建 phi, 只有一个来源的 phi 随后去掉
+// 树根不取 GEP, 免得别名分析看不到新建的指针 phi
+class PRE {
+private:
+    struct Tree {
+        int key;
+        BasicBlock* bb;
+        // 按块内顺序, 根在最后
+        std::vector<Instruction*> nodes;
+        std::vector<Value*> leaves;
+        std::vector<Value*> loadAddrs;
+    };
+    struct Kill {
+        int first = INT_MAX;
+        int last = -1;
+        std::vector<int> mem;
+    };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    AliasAnalysis aliasAnalysis;
+    DominateTree dominateTree;
+
+    std::unordered_map<Value*, Instruction*> defIr;
+    std::unordered_map<Value*, int> defCnt;
+    std::unordered_map<Value*, BasicBlock*> defBB;
+    std::unordered_map<Value*, int> useCnt;
+    std::unordered_map<Instruction*, int> pos;
+    std::unordered_map<Instruction*, Tree> trees;
+    std::unordered_map<std::string, int> keyIds;
+    std::vector<std::vector<Instruction*>> keyOcc;
+    std::vector<std::pair<BasicBlock*, Instruction*>> memWriters;
+    std::unordered_map<Value*, Value*> valMap;
+    bool posDirty;
+
+    // 当前表达式的 SSA 重建
+    std::unordered_map<BasicBlock*, Value*> insertedEnd;
+    std::unordered_map<BasicBlock*, Value*> insertedStart;
+    std::unordered_map<BasicBlock*, Instruction*> availOcc;
+    std::unordered_set<Instruction*> deletedOcc;
+    std::unordered_map<BasicBlock*, Value*> entryMemo;
+    std::vector<PhiIR*> newPhis;
+    Value* protoDst;
+
+    static const int maxNodes = 8;
+    static const int maxKeys = 1024;
+
+    int exprCnt = 0;
+    int insertedCnt = 0;
+    int removedCnt = 0;
+
+    void collect();
+    void buildTree(Instruction* ir, BasicBlock* bb);
+    bool encode(Use* use, BasicBlock* bb, std::string& code, Tree& tree);
+    bool isCandidate(Instruction* ir);
+    void renumber();
+    bool processKey(int key);
+    bool mayClobber(Instruction* ir, Value* addr);
+    Value* materialize(Tree& tree, BasicBlock* bb, bool atEnd);
+    Value* valueAtEnd(BasicBlock* bb);
+    Value* valueAtEntry(BasicBlock* bb);
+    void removeOcc(Instruction* root);
+    void dropUse(Value* val);
+public:
+    PRE(IrVisitor* irVisitor) : irVisitor(irVisitor), aliasAnalysis(irVisitor), dominateTree(irVisitor) {;}
+    void execute();
+    int getExprCnt() { return exprCnt; }
+    int getInsertedCnt() { return insertedCnt; }
+    int getRemovedCnt() { return removedCnt; }
+};
+
+inline void PRE::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty() || !func->getBB()[0]->getPre().empty()) continue;
+        this->function = func;
+        aliasAnalysis.analyze(func);
+        valMap.clear();
+        collect();
+
+        // 大的树先做, 被删掉的根下面的子树随之变成死代码
+        std::vector<int> keys;
+        for(int key(0); key < (int) keyOcc.size(); key++) {
+            auto& occ = keyOcc[key];
+            bool multi = false;
+            for(Instruction* ir : occ) {
+                if(trees[ir].bb != trees[occ[0]].bb) multi = true;
+            }
+            if(multi && typeid(*occ[0]) != typeid(GEPIR)) keys.push_back(key);
+        }
+        std::stable_sort(keys.begin(), keys.end(), [&](int a, int b) {
+            return trees[keyOcc[a][0]].nodes.size() > trees[keyOcc[b][0]].nodes.size();
+        });
+        if((int) keys.size() > maxKeys) keys.resize(maxKeys);
+        for(int key : keys) {
+            if(processKey(key)) exprCnt++;
+        }
+        if(!valMap.empty()) applyValMap(function, valMap);
+    }
+}
+
+inline bool PRE::isCandidate(Instruction* ir) {
+    const std::type_info& t = typeid(*ir);
+    return dynamic_cast<ArithmeticIR*>(ir) || t == typeid(UnaryIR) || t == typeid(CastInt2FloatIR)
+           || t == typeid(CastFloat2IntIR) || t == typeid(GEPIR) || t == typeid(LoadIIR) || t == typeid(LoadFIR);
+}
+
+inline void PRE::collect() {
+    defIr.clear();
+    defCnt.clear();
+    defBB.clear();
+    useCnt.clear();
+    trees.clear();
+    keyIds.clear();
+    keyOcc.clear();
+    memWriters.clear();
+    std::vector<Use*> uses;
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            Value* dst = getDefVal(ir);
+            if(dst) {
+                defCnt[dst]++;
+                defIr[dst] = ir;
+                defBB[dst] = bb;
+            }
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    Value* val = t ? t->getVal() : param.second;
+                    if(val) useCnt[val]++;
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                Value* val = getUseVal(use);
+                if(val) useCnt[val]++;
+            }
+        }
+    }
+    renumber();
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            const std::type_info& t = typeid(*ir);
+            if(t == typeid(StoreIIR) || t == typeid(StoreFIR) || t == typeid(CallIR)
+               || (dynamic_cast<AllocIR*>(ir) && dynamic_cast<AllocIR*>(ir)->isArray)) {
+                memWriters.push_back({bb, ir});
+            }
+            if(isCandidate(ir)) buildTree(ir, bb);
+        }
+    }
+}
+
+inline void PRE::renumber() {
+    pos.clear();
+    for(BasicBlock* bb : function->getBB()) {
+        auto& irs = bb->getIr();
+        for(size_t i(0); i < irs.size(); i++) pos[irs[i]] = (int) i;
+    }
+    posDirty = false;
+}
+
+// 操作数编码进 code; 同块内先算出的树作为子树并入, 其余变量作为叶子
+inline bool PRE::encode(Use* use, BasicBlock* bb, std::string& code, Tree& tree) {
+    Value* val = use ? use->getVal() : nullptr;
+    if(!val) {
+        code += 'z';
+        return true;
+    }
+    if(typeid(*val) == typeid(TempVal) && !dynamic_cast<TempVal*>(val)->getVal()) {
+        TempVal* c = dynamic_cast<TempVal*>(val);
+        uint32_t u;
+        if(c->isFloat()) {
+            float f = c->getFloat();
+            memcpy(&u, &f, sizeof(u));
+            code += 'f';
+        } else {
+            u = (uint32_t) c->getInt();
+            code += 'i';
+        }
+        code.append((const char*) &u, sizeof(u));
+        return true;
+    }
+    val = getUseVal(use);
+    auto cnt = defCnt.find(val);
+    if(cnt != defCnt.end() && cnt->second > 1) return false;
+    auto def = defIr.find(val);
+    if(def != defIr.end() && defBB[val] == bb) {
+        auto sub = trees.find(def->second);
+        if(sub != trees.end() && tree.nodes.size() + sub->second.nodes.size() < maxNodes) {
+            Tree& child = sub->second;
+            code += 'n';
+            code.append((const char*) &child.key, sizeof(child.key));
+            for(Instruction* node : child.nodes) {
+                if(std::find(tree.nodes.begin(), tree.nodes.end(), node) == tree.nodes.end()) tree.nodes.push_back(node);
+            }
+            for(Value* leaf : child.leaves) {
+                if(std::find(tree.leaves.begin(), tree.leaves.end(), leaf) == tree.leaves.end()) tree.leaves.push_back(leaf);
+            }
+            for(Value* addr : child.loadAddrs) tree.loadAddrs.push_back(addr);
+            return true;
+        }
+    }
+    code += 'v';
+    code.append((const char*) &val, sizeof(val));
+    if(std::find(tree.leaves.begin(), tree.leaves.end(), val) == tree.leaves.end()) tree.leaves.push_back(val);
+    return true;
+}
+
+inline void PRE::buildTree(Instruction* ir, BasicBlock* bb) {
+    static const std::vector<const std::type_info*> commutative = {
+        &typeid(AddIIR), &typeid(MulIIR), &typeid(EQUIIR), &typeid(NEIIR),
+        &typeid(AddFIR), &typeid(MulFIR), &typeid(EQUFIR), &typeid(NEFIR),
+    };
+    Value* dst = getDefVal(ir);
+    if(!dst || defCnt[dst] != 1) return;
+    const std::type_info& t = typeid(*ir);
+    auto& operands = ir->getOperands();
+    Tree tree;
+    tree.bb = bb;
+    std::string code = t.name();
+    code += '#';
+    if(dynamic_cast<ArithmeticIR*>(ir)) {
+        std::string left, right;
+        if(!encode(operands[1], bb, left, tree) || !encode(operands[2], bb, right, tree)) return;
+        bool swap = false;
+        for(auto c : commutative) {
+            if(*c == t) swap = right < left;
+        }
+        code += swap ? right + left : left + right;
+    } else if(t == typeid(GEPIR)) {
+        if(!encode(operands[1], bb, code, tree)) return;
+        if(operands[2]->getVal()) {
+            if(!encode(operands[2], bb, code, tree)) return;
+        } else {
+            int len = dynamic_cast<GEPIR*>(ir)->arrayLen;
+            code += 'l';
+            code.append((const char*) &len, sizeof(len));
+        }
+    } else {
+        if(t == typeid(UnaryIR)) {
+            UnaryIR* unaryIr = dynamic_cast<UnaryIR*>(ir);
+            code += unaryIr->op == OP::NEG ? 'N' : 'L';
+            code += unaryIr->res.isFloat() ? 'F' : 'I';
+        }
+        if(!encode(operands[1], bb, code, tree)) return;
+        if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) tree.loadAddrs.push_back(getUseVal(operands[1]));
+    }
+    std::sort(tree.nodes.begin(), tree.nodes.end(), [&](Instruction* a, Instruction* b) { return pos[a] < pos[b]; });
+    tree.nodes.push_back(ir);
+    auto it = keyIds.find(code);
+    if(it == keyIds.end()) {
+        it = keyIds.insert({code, (int) keyOcc.size()}).first;
+        keyOcc.emplace_back();
+    }
+    tree.key = it->second;
+    keyOcc[tree.key].push_back(ir);
+    trees[ir] = std::move(tree);
+}
+
+inline bool PRE::mayClobber(Instruction* ir, Value* addr) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+        return aliasAnalysis.alias(getUseVal(ir->getOperands()[0]), addr) != AliasAnalysis::NoAlias;
+    }
+    if(t == typeid(CallIR)) return aliasAnalysis.callMayAccess(dynamic_cast<CallIR*>(ir), addr);
+    AllocIR* alloc = dynamic_cast<AllocIR*>(ir);
+    if(alloc && alloc->isArray) {
+        Value* root = aliasAnalysis.getLocation(addr).root;
+        return !root || root == getDefVal(ir);
+    }
+    return false;
+}
+
+inline bool PRE::processKey(int key) {
+    // 有效的出现: 树中指令都还在, 叶子没有被替换
+    std::vector<Instruction*> occ;
+    for(Instruction* root : keyOcc[key]) {
+        Tree& tree = trees[root];
+        bool valid = true;
+        for(Instruction* node : tree.nodes) {
+            if(node->isDeleted()) valid = false;
+        }
+        for(Value* leaf : tree.leaves) {
+            if(valMap.count(leaf)) return false;
+        }
+        if(valid) occ.push_back(root);
+    }
+    if(occ.size() < 2) return false;
+    if(posDirty) renumber();
+    Tree& proto = trees[occ[0]];
+
+    auto& bbs = function->getBB();
+    int n = (int) bbs.size();
+    std::vector<Kill> kills(n);
+    for(Value* leaf : proto.leaves) {
+        auto def = defIr.find(leaf);
+        if(def == defIr.end() || def->second->isDeleted()) continue;
+        Kill& k = kills[defBB[leaf]->getId()];
+        int p = pos[def->second];
+        k.first = std::min(k.first, p);
+        k.last = std::max(k.last, p);
+    }
+    if(!proto.loadAddrs.empty()) {
+        for(auto& item : memWriters) {
+            if(item.second->isDeleted()) continue;
+            bool clobber = false;
+            for(Value* addr : proto.loadAddrs) {
+                if(mayClobber(item.second, addr)) clobber = true;
+            }
+            if(!clobber) continue;
+            Kill& k = kills[item.first->getId()];
+            int p = pos[item.second];
+            k.first = std::min(k.first, p);
+            k.last = std::max(k.last, p);
+            k.mem.push_back(p);
+        }
+    }
+
+    // 局部性质: 出现在块内第一个 kill 之前为 ANTLOC, 在最后一个 kill 之后为 COMP
+    std::vector<char> antloc(n, 0), comp(n, 0), transp(n, 0);
+    std::vector<Instruction*> firstOcc(n, nullptr), lastOcc(n, nullptr);
+    for(Instruction* root : occ) {
+        Tree& tree = trees[root];
+        int id = tree.bb->getId();
+        Kill& k = kills[id];
+        int start = pos[tree.nodes[0]], end = pos[root];
+        bool valid = true;
+        for(int p : k.mem) {
+            if(p > start && p < end) valid = false;
+        }
+        if(!valid) continue;
+        if(end < k.first && (!firstOcc[id] || end < pos[firstOcc[id]])) firstOcc[id] = root;
+        if(end > k.last && (!lastOcc[id] || end > pos[lastOcc[id]])) lastOcc[id] = root;
+    }
+    for(int i(0); i < n; i++) {
+        transp[i] = kills[i].last < 0;
+        antloc[i] = firstOcc[i] != nullptr;
+        comp[i] = lastOcc[i] != nullptr;
+    }
+
+    // 可用性(前向, 交)与可预期性(后向, 交)
+    std::vector<char> avIn(n, 1), avOut(n, 1), antIn(n, 1), antOut(n, 1);
+    for(bool changed = true; changed;) {
+        changed = false;
+        for(int i(0); i < n; i++) {
+            char in = i != 0;
+            for(BasicBlock* preBB : bbs[i]->getPre()) in &= avOut[preBB->getId()];
+            char out = comp[i] || (in && transp[i]);
+            if(in != avIn[i] || out != avOut[i]) changed = true;
+            avIn[i] = in;
+            avOut[i] = out;
+        }
+    }
+    for(bool changed = true; changed;) {
+        changed = false;
+        for(int i(n); i-- > 0;) {
+            char out = !bbs[i]->getSucc().empty();
+            for(BasicBlock* succBB : bbs[i]->getSucc()) out &= antIn[succBB->getId()];
+            char in = antloc[i] || (out && transp[i]);
+            if(in != antIn[i] || out != antOut[i]) changed = true;
+            antIn[i] = in;
+            antOut[i] = out;
+        }
+    }
+    auto earliest = [&](int i, int j) {
+        return antIn[j] && !avOut[i] && (!transp[i] || !antOut[i]);
+    };
+    // later 的最大不动点, 入口块由虚拟入口边决定
+    std::vector<char> laterIn(n, 1);
+    laterIn[0] = antIn[0];
+    auto later = [&](int i, int j) {
+        return earliest(i, j) || (laterIn[i] && !antloc[i]);
+    };
+    for(bool changed = true; changed;) {
+        changed = false;
+        for(int j(1); j < n; j++) {
+            char in = 1;
+            for(BasicBlock* preBB : bbs[j]->getPre()) in &= later(preBB->getId(), j);
+            if(in != laterIn[j]) {
+                laterIn[j] = in;
+                changed = true;
+            }
+        }
+    }
+    std::vector<std::pair<BasicBlock*, BasicBlock*>> inserts;
+    // 拆边会重新编号, 删除点连同出现一起记下
+    std::vector<std::pair<BasicBlock*, Instruction*>> deletes;
+    for(int i(0); i < n; i++) {
+        if(antloc[i] && !laterIn[i]) deletes.push_back({bbs[i], firstOcc[i]});
+        for(BasicBlock* succBB : bbs[i]->getSucc()) {
+            int j = succBB->getId();
+            if(later(i, j) && !laterIn[j]) inserts.push_back({bbs[i], succBB});
+        }
+    }
+    if(deletes.empty()) return false;
+
+    // 先确认插入之后每个删除点入口处都能拿到值, 不行就放弃, 不改 IR
+    auto inserted = [&](int i, int j) {
+        for(auto& e : inserts) {
+            if(e.first->getId() == i && e.second->getId() == j) return true;
+        }
+        return false;
+    };
+    std::vector<char> okIn(n, 1), okOut(n, 1);
+    for(bool changed = true; changed;) {
+        changed = false;
+        for(int i(0); i < n; i++) {
+            char in = i != 0;
+            for(BasicBlock* preBB : bbs[i]->getPre()) in &= okOut[preBB->getId()] || inserted(preBB->getId(), i);
+            char out = comp[i] || (in && transp[i]);
+            if(in != okIn[i] || out != okOut[i]) changed = true;
+            okIn[i] = in;
+            okOut[i] = out;
+        }
+    }
+    for(auto& item : deletes) {
+        if(!okIn[item.first->getId()]) return false;
+    }
+
+    insertedEnd.clear();
+    insertedStart.clear();
+    availOcc.clear();
+    deletedOcc.clear();
+    entryMemo.clear();
+    newPhis.clear();
+    protoDst = getDefVal(occ[0]);
+    for(int i(0); i < n; i++) {
+        if(lastOcc[i]) availOcc[bbs[i]] = lastOcc[i];
+    }
+    for(auto& item : deletes) deletedOcc.insert(item.second);
+    // 插入点: 前驱只有一个后继时放前驱末尾, 后继只有一个前驱时放后继开头, 否则拆边
+    for(auto& e : inserts) {
+        if(e.first->getSucc().size() == 1) {
+            insertedEnd[e.first] = materialize(proto, e.first, true);
+        } else if(e.second->getPre().size() == 1) {
+            insertedStart[e.second] = materialize(proto, e.second, false);
+        } else {
+            BasicBlock* nb = dominateTree.splitEdge(function, e.first, e.second);
+            insertedEnd[nb] = materialize(proto, nb, true);
+        }
+        insertedCnt++;
+    }
+    posDirty = true;
+
+    std::vector<std::pair<Instruction*, Value*>> repl;
+    for(auto& item : deletes) repl.push_back({item.second, valueAtEntry(item.first)});
+    // 去掉只有一个来源的 phi
+    for(bool changed = true; changed;) {
+        changed = false;
+        for(PhiIR* phi : newPhis) {
+            if(phi->isDeleted()) continue;
+            Value* same = nullptr;
+            bool trivial = true;
+            for(auto& param : phi->params) {
+                Value* val = resolveVal(valMap, dynamic_cast<TempVal*>(param.second)->getVal());
+                if(val == phi->dst || val == same) continue;
+                if(same) trivial = false;
+                same = val;
+            }
+            if(!trivial || !same) continue;
+            valMap[phi->dst] = same;
+            useCnt[same] += useCnt[phi->dst];
+            phi->deleteIR();
+            changed = true;
+        }
+    }
+    for(auto& item : repl) {
+        Value* dst = getDefVal(item.first);
+        Value* to = resolveVal(valMap, item.second);
+        valMap[dst] = to;
+        useCnt[to] += useCnt[dst];
+        removeOcc(item.first);
+        removedCnt++;
+    }
+    return true;
+}
+
+// 在 bb 末尾(跳转之前)或开头(phi 之后)复制一棵树, 返回根的新变量
+inline Value* PRE::materialize(Tree& tree, BasicBlock* bb, bool atEnd) {
+    auto& irs = bb->getIr();
+    size_t at = 0;
+    if(atEnd) {
+        at = irs.size();
+        if(at > 0 && (typeid(*irs[at - 1]) == typeid(JumpIR) || typeid(*irs[at - 1]) == typeid(BranchIR))) at--;
+    } else {
+        while(at < irs.size() && typeid(*irs[at]) == typeid(PhiIR)) at++;
+    }
+    std::unordered_map<Value*, Value*> varMap;
+    std::unordered_map<BasicBlock*, BasicBlock*> bbMap;
+    std::vector<Use*> uses;
+    Value* res = nullptr;
+    for(Instruction* node : tree.nodes) {
+        Value* dst = getDefVal(node);
+        res = cloneVar(dst, function);
+        varMap[dst] = res;
+        Instruction* ir = cloneIR(node, varMap, bbMap);
+        // 非负标记依赖原位置的分支条件, 不带过去
+        if(dynamic_cast<ArithmeticIR*>(ir)) dynamic_cast<ArithmeticIR*>(ir)->nonNegative = false;
+        getUseOperands(ir, uses);
+        for(Use* use : uses) {
+            Value* val = getUseVal(use);
+            if(val) useCnt[val]++;
+        }
+        defIr[res] = ir;
+        defCnt[res] = 1;
+        defBB[res] = bb;
+        irs.insert(irs.begin() + at++, ir);
+    }
+    return res;
+}
+
+inline Value* PRE::valueAtEnd(BasicBlock* bb) {
+    auto ins = insertedEnd.find(bb);
+    if(ins != insertedEnd.end()) return ins->second;
+    auto occ = availOcc.find(bb);
+    if(occ != availOcc.end() && !deletedOcc.count(occ->second)) return getDefVal(occ->second);
+    return valueAtEntry(bb);
+}
+
+inline Value* PRE::valueAtEntry(BasicBlock* bb) {
+    auto ins = insertedStart.find(bb);
+    if(ins != insertedStart.end()) return ins->second;
+    auto memo = entryMemo.find(bb);
+    if(memo != entryMemo.end()) return memo->second;
+    auto& preBBs = bb->getPre();
+    if(preBBs.size() == 1) {
+        Value* val = valueAtEnd(preBBs[0]);
+        entryMemo[bb] = val;
+        return val;
+    }
+    Value* dst = cloneVar(protoDst, function);
+    PhiIR* phi = new PhiIR({}, dst);
+    entryMemo[bb] = dst;
+    defIr[dst] = phi;
+    defCnt[dst] = 1;
+    defBB[dst] = bb;
+    bb->getIr().insert(bb->getIr().begin(), phi);
+    newPhis.push_back(phi);
+    std::vector<BasicBlock*> pres = preBBs;
+    for(BasicBlock* preBB : pres) {
+        Value* val = valueAtEnd(preBB);
+        phi->params[preBB] = wrapVal(val);
+        useCnt[val]++;
+    }
+    return dst;
+}
+
+// 删掉一个出现, 树中随之没有使用的指令一起删掉
+inline void PRE::removeOcc(Instruction* root) {
+    Tree& tree = trees[root];
+    std::vector<Use*> uses;
+    root->deleteIR();
+    getUseOperands(root, uses);
+    for(Use* use : uses) dropUse(getUseVal(use));
+    for(size_t i(tree.nodes.size()); i-- > 0;) {
+        Instruction* node = tree.nodes[i];
+        if(node->isDeleted() || useCnt[getDefVal(node)] > 0) continue;
+        node->deleteIR();
+        getUseOperands(node, uses);
+        for(Use* use : uses) dropUse(getUseVal(use));
+    }
+}
+
+inline void PRE::dropUse(Value* val) {
+    if(val && useCnt[val] > 0) useCnt[val]--;
+}
+
+#endif //SYSY2022_BJTU_PRE_HH
@@ -0,0 +1,90 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_PURITYANALYSIS_HH
+#define SYSY2022_BJTU_PURITYANALYSIS_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// 过程间纯函数分析, 在 SSA 上做
+// 纯函数: 只读写自己的局部数组(不碰全局变量和指针形参指向的内存), 不调用库函数, 被调函数也是纯函数
+// 这样的函数结果只由实参决定, 且没有可见的副作用
+// 先假设所有函数都是纯的, 不满足的不断去掉直到不动点, 互相递归的函数也能判定
+class PurityAnalysis {
+private:
+    IrVisitor* irVisitor;
+    std::unordered_set<Function*> pure;
+
+    bool localOnly(Function* func);
+public:
+    PurityAnalysis(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void analyze();
+    bool isPure(Function* func) { return pure.count(func) > 0; }
+    int getPureCnt() { return pure.size(); }
+};
+
+inline void PurityAnalysis::analyze() {
+    pure.clear();
+    for(Function* func : irVisitor->getFunctions()) {
+        if(!func->getBB().empty() && localOnly(func)) pure.insert(func);
+    }
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(Function* func : irVisitor->getFunctions()) {
+            if(!pure.count(func)) continue;
+            bool ok = true;
+            for(BasicBlock* bb : func->getBB()) {
+                for(auto ir : bb->getIr()) {
+                    if(ir->isDeleted() || typeid(*ir) != typeid(CallIR)) continue;
+                    if(!pure.count(dynamic_cast<CallIR*>(ir)->func)) ok = false;
+                }
+            }
+            if(!ok) {
+                pure.erase(func);
+                changed = true;
+            }
+        }
+    }
+}
+
+// 读写的地址都由本函数的局部数组算出
+inline bool PurityAnalysis::localOnly(Function* func) {
+    std::unordered_set<Value*> local;
+    std::unordered_map<Value*, Value*> gepBase;
+    std::vector<Instruction*> accesses;
+    for(BasicBlock* bb : func->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            auto& operands = ir->getOperands();
+            if(dynamic_cast<AllocIR*>(ir)) {
+                local.insert(getDefVal(ir));
+            } else if(typeid(*ir) == typeid(GEPIR)) {
+                gepBase[getDefVal(ir)] = operands[1]->getVal();
+            } else if(dynamic_cast<LoadIR*>(ir) || dynamic_cast<StoreIR*>(ir)) {
+                accesses.push_back(ir);
+            }
+        }
+    }
+    auto isLocal = [&](Value* addr) {
+        while(addr && !local.count(addr)) {
+            auto it = gepBase.find(addr);
+            if(it == gepBase.end()) return false;
+            addr = it->second;
+        }
+        return addr != nullptr;
+    };
+    for(Instruction* ir : accesses) {
+        Value* addr = dynamic_cast<LoadIR*>(ir) ? ir->getOperands()[1]->getVal() : ir->getOperands()[0]->getVal();
+        if(!isLocal(addr)) return false;
+    }
+    return true;
+}
+
+#endif //SYSY2022_BJTU_PURITYANALYSIS_HH
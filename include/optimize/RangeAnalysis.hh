@@ -0,0 +1,346 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_RANGEANALYSIS_HH
+#define SYSY2022_BJTU_RANGEANALYSIS_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+// 整数值域分析, 在 SSA 上做, 需要有效的支配树
+// 每个 int 变量一个区间 [lo, hi], 沿 SSA 传播: 先从空区间往上迭代, phi 多次变大后放宽到 int 的边界,
+// 再按转移函数往下迭代两轮收窄(循环变量的上界就是这时由循环条件得到的)
+// 使用处的区间按支配它的分支条件收紧: 沿支配树往上, 只从分支的一个出边进入的块上条件(x < y, x == c 等)成立
+// phi 参数还按前驱到本块的边上的条件收紧
+// 有符号溢出是未定义行为: 加减越界的一端截到 int 的边界, 否则计数器放宽上界后 i + 1 会冲掉 phi 的下界;
+// 乘法等其余运算可能溢出时取整个 int 范围
+class RangeAnalysis {
+public:
+    struct Range {
+        long long lo, hi;
+        bool isEmpty() const { return lo > hi; }
+        bool isConst() const { return lo == hi; }
+        bool operator==(const Range& r) const { return (isEmpty() && r.isEmpty()) || (lo == r.lo && hi == r.hi); }
+        bool operator!=(const Range& r) const { return !(*this == r); }
+    };
+    static Range full() { return {INT_MIN, INT_MAX}; }
+    static Range empty() { return {1, 0}; }
+    static Range single(long long c) { return {c, c}; }
+private:
+    IrVisitor* irVisitor;
+    Function* function = nullptr;
+    std::unordered_map<Value*, Instruction*> defIr;
+    std::unordered_map<Value*, int> defCnt;
+    std::unordered_map<Value*, Range> ranges;
+    std::unordered_map<Value*, int> widenCnt;
+
+    static const int maxRounds = 64;
+    static const int narrowRounds = 2;
+    static const int maxRefineDepth = 16;
+    static const int widenAfter = 2;
+
+    std::unordered_set<Value*> params;
+
+    bool isTracked(Value* val) {
+        return val && val->getType() && val->getType()->isInt() && !params.count(val) && defCnt.count(val) && defCnt[val] == 1;
+    }
+    // 不会在分支和使用之间改变的 int 变量, 可以按分支条件收紧
+    bool isRefinable(Value* val) {
+        return isTracked(val) || (params.count(val) && !defCnt.count(val));
+    }
+    static bool isCompare(const std::type_info& t) {
+        return t == typeid(LTIIR) || t == typeid(LEIIR) || t == typeid(GTIIR) || t == typeid(GEIIR)
+               || t == typeid(EQUIIR) || t == typeid(NEIIR) || t == typeid(LTFIR) || t == typeid(LEFIR)
+               || t == typeid(GTFIR) || t == typeid(GEFIR) || t == typeid(EQUFIR) || t == typeid(NEFIR);
+    }
+    Range eval(Instruction* ir, BasicBlock* bb);
+    Range evalBinary(Instruction* ir, Range a, Range b);
+    // 按 cond 的取值收紧 val 的区间
+    Range applyCond(Range r, Value* val, Value* cond, bool taken);
+    Range applyEdge(Range r, Value* val, BasicBlock* from, BasicBlock* to);
+    static Range join(Range a, Range b);
+    static Range meet(Range a, Range b);
+    static Range clamp(long long lo, long long hi);
+    static Range saturate(long long lo, long long hi);
+public:
+    RangeAnalysis(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void analyze(Function* function);
+    // 变量在定值处的区间, 不跟踪的变量为整个 int 范围
+    Range getRange(Value* val);
+    // 变量或常量在块 bb 中使用时的区间
+    Range getRangeAt(Value* val, BasicBlock* bb);
+};
+
+inline void RangeAnalysis::analyze(Function* function) {
+    this->function = function;
+    defIr.clear();
+    defCnt.clear();
+    ranges.clear();
+    widenCnt.clear();
+    params.clear();
+    for(Value* param : function->params) {
+        if(param->getType()->isInt()) params.insert(param);
+    }
+    for(BasicBlock* bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            Value* dst = getDefVal(ir);
+            if(!dst) continue;
+            defIr[dst] = ir;
+            defCnt[dst]++;
+        }
+    }
+    // 往上迭代, phi 放宽保证收敛
+    bool changed = true;
+    int round = 0;
+    for(; changed && round < maxRounds; round++) {
+        changed = false;
+        for(BasicBlock* bb : function->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                Value* dst = getDefVal(ir);
+                if(!isTracked(dst)) continue;
+                Range old = ranges.count(dst) ? ranges[dst] : empty();
+                Range cur = join(old, eval(ir, bb));
+                if(cur == old) continue;
+                if(typeid(*ir) == typeid(PhiIR) && !old.isEmpty() && ++widenCnt[dst] > widenAfter) {
+                    if(cur.lo < old.lo) cur.lo = INT_MIN;
+                    if(cur.hi > old.hi) cur.hi = INT_MAX;
+                }
+                ranges[dst] = cur;
+                changed = true;
+            }
+        }
+    }
+    // 没有收敛时结果不可靠, 全部放弃
+    if(changed) {
+        ranges.clear();
+        defCnt.clear();
+        params.clear();
+        return;
+    }
+    for(int k(0); k < narrowRounds; k++) {
+        for(BasicBlock* bb : function->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                Value* dst = getDefVal(ir);
+                if(!isTracked(dst)) continue;
+                ranges[dst] = meet(ranges[dst], eval(ir, bb));
+            }
+        }
+    }
+}
+
+inline RangeAnalysis::Range RangeAnalysis::getRange(Value* val) {
+    if(!isTracked(val)) return full();
+    auto it = ranges.find(val);
+    return it == ranges.end() ? empty() : it->second;
+}
+
+inline RangeAnalysis::Range RangeAnalysis::getRangeAt(Value* val, BasicBlock* bb) {
+    if(val && typeid(*val) == typeid(TempVal)) {
+        TempVal* tv = dynamic_cast<TempVal*>(val);
+        if(!tv->getVal()) {
+            if(!tv->getType() || !tv->isInt()) return full();
+            return single(tv->getInt());
+        }
+        val = tv->getVal();
+    }
+    Range r = getRange(val);
+    if(!isRefinable(val)) return r;
+    BasicBlock* cur = bb;
+    for(int depth(0); depth < maxRefineDepth && !r.isEmpty(); depth++) {
+        BasicBlock* idom = cur->getIdom();
+        if(!idom || idom == cur) break;
+        if(cur->getPre().size() == 1 && cur->getPre()[0] == idom) r = applyEdge(r, val, idom, cur);
+        cur = idom;
+    }
+    return r;
+}
+
+inline RangeAnalysis::Range RangeAnalysis::applyEdge(Range r, Value* val, BasicBlock* from, BasicBlock* to) {
+    auto& irs = from->getIr();
+    for(size_t i(irs.size()); i-- > 0;) {
+        if(irs[i]->isDeleted()) continue;
+        BranchIR* br = dynamic_cast<BranchIR*>(irs[i]);
+        if(!br || br->trueTarget == br->falseTarget) return r;
+        Value* cond = getUseVal(br->getOperands()[1]);
+        return cond ? applyCond(r, val, cond, to == br->trueTarget) : r;
+    }
+    return r;
+}
+
+inline RangeAnalysis::Range RangeAnalysis::applyCond(Range r, Value* val, Value* cond, bool taken) {
+    if(cond == val) {
+        if(!taken) return meet(r, single(0));
+        if(r.lo == 0) r.lo = 1;
+        if(r.hi == 0) r.hi = -1;
+        return r;
+    }
+    auto it = defIr.find(cond);
+    if(it == defIr.end() || defCnt[cond] != 1) return r;
+    Instruction* def = it->second;
+    const std::type_info& t = typeid(*def);
+    bool lt = t == typeid(LTIIR), le = t == typeid(LEIIR), gt = t == typeid(GTIIR), ge = t == typeid(GEIIR);
+    bool eq = t == typeid(EQUIIR), ne = t == typeid(NEIIR);
+    if(!lt && !le && !gt && !ge && !eq && !ne) return r;
+    auto& operands = def->getOperands();
+    Value* left = getUseVal(operands[1]);
+    Value* right = getUseVal(operands[2]);
+    Value* other;
+    if(left == val && right != val) {
+        other = operands[2]->getVal();
+    } else if(right == val && left != val) {
+        // 交换两边
+        other = operands[1]->getVal();
+        std::swap(lt, gt);
+        std::swap(le, ge);
+    } else {
+        return r;
+    }
+    if(!taken) {
+        bool nlt = ge, nle = gt, ngt = le, nge = lt;
+        lt = nlt, le = nle, gt = ngt, ge = nge;
+        std::swap(eq, ne);
+    }
+    TempVal* tv = dynamic_cast<TempVal*>(other);
+    Range o;
+    if(tv && !tv->getVal()) {
+        if(!tv->isInt()) return r;
+        o = single(tv->getInt());
+    } else {
+        o = getRange(tv ? tv->getVal() : other);
+    }
+    if(o.isEmpty()) return empty();
+    if(lt) r.hi = std::min(r.hi, o.hi - 1);
+    if(le) r.hi = std::min(r.hi, o.hi);
+    if(gt) r.lo = std::max(r.lo, o.lo + 1);
+    if(ge) r.lo = std::max(r.lo, o.lo);
+    if(eq) r = meet(r, o);
+    if(ne && o.isConst()) {
+        if(r.lo == o.lo) r.lo++;
+        if(r.hi == o.lo) r.hi--;
+    }
+    return r;
+}
+
+inline RangeAnalysis::Range RangeAnalysis::eval(Instruction* ir, BasicBlock* bb) {
+    const std::type_info& t = typeid(*ir);
+    auto& operands = ir->getOperands();
+    if(t == typeid(PhiIR)) {
+        Range r = empty();
+        for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+            if(!param.second) continue;
+            Range p = getRangeAt(param.second, param.first);
+            TempVal* tv = dynamic_cast<TempVal*>(param.second);
+            Value* val = tv ? tv->getVal() : param.second;
+            if(isRefinable(val)) p = applyEdge(p, val, param.first, bb);
+            r = join(r, p);
+        }
+        return r;
+    }
+    if(t == typeid(MoveIR)) {
+        Value* src = operands[1]->getVal();
+        TempVal* tv = dynamic_cast<TempVal*>(src);
+        if(tv && !tv->getVal()) {
+            if(!tv->getType() || tv->getType()->isString()) return full();
+            return single(castConst(tv, getDefVal(ir)->getType())->getInt());
+        }
+        Value* val = tv ? tv->getVal() : src;
+        if(!val || !val->getType() || !val->getType()->isInt()) return full();
+        return getRangeAt(val, bb);
+    }
+    if(dynamic_cast<ArithmeticIR*>(ir)) {
+        TempVal* a = dynamic_cast<TempVal*>(operands[1]->getVal());
+        TempVal* b = dynamic_cast<TempVal*>(operands[2]->getVal());
+        bool isInt = a->getType() && b->getType() && a->getType()->isInt() && b->getType()->isInt();
+        if(!isInt) return isCompare(typeid(*ir)) ? Range{0, 1} : full();
+        Range ra = getRangeAt(a, bb), rb = getRangeAt(b, bb);
+        if(ra.isEmpty() || rb.isEmpty()) return empty();
+        return evalBinary(ir, ra, rb);
+    }
+    if(t == typeid(UnaryIR)) {
+        UnaryIR* unaryIr = dynamic_cast<UnaryIR*>(ir);
+        TempVal* v = dynamic_cast<TempVal*>(operands[1]->getVal());
+        if(!v->getType() || !v->getType()->isInt()) return unaryIr->op == OP::NOT ? Range{0, 1} : full();
+        Range r = getRangeAt(v, bb);
+        if(r.isEmpty()) return r;
+        if(unaryIr->op == OP::NEG) return clamp(-r.hi, -r.lo);
+        if(r.lo > 0 || r.hi < 0) return single(0);
+        if(r.lo == 0 && r.hi == 0) return single(1);
+        return {0, 1};
+    }
+    return full();
+}
+
+inline RangeAnalysis::Range RangeAnalysis::evalBinary(Instruction* ir, Range a, Range b) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(AddIIR)) return saturate(a.lo + b.lo, a.hi + b.hi);
+    if(t == typeid(SubIIR)) return saturate(a.lo - b.hi, a.hi - b.lo);
+    if(t == typeid(MulIIR) || t == typeid(ShlIR)) {
+        if(t == typeid(ShlIR)) {
+            if(!b.isConst() || b.lo < 0 || b.lo > 31) return full();
+            b = single(1LL << b.lo);
+        }
+        // 两个 int 的乘积不超过 long long
+        long long p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+        return clamp(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+    }
+    if(t == typeid(DivIIR)) {
+        // 除数不跨 0 时商在四个角上取到极值
+        if(b.lo <= 0 && b.hi >= 0) return full();
+        long long p[4] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+        return clamp(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+    }
+    if(t == typeid(ModIR)) {
+        long long m = std::max(std::llabs(b.lo), std::llabs(b.hi)) - 1;
+        if(m < 0) return full();
+        if(a.lo >= 0) return {0, std::min(a.hi, m)};
+        if(a.hi <= 0) return {std::max(a.lo, -m), 0};
+        return {std::max(a.lo, -m), std::min(a.hi, m)};
+    }
+    int res = -1;
+    if(t == typeid(LTIIR)) res = a.hi < b.lo ? 1 : a.lo >= b.hi ? 0 : -1;
+    else if(t == typeid(LEIIR)) res = a.hi <= b.lo ? 1 : a.lo > b.hi ? 0 : -1;
+    else if(t == typeid(GTIIR)) res = a.lo > b.hi ? 1 : a.hi <= b.lo ? 0 : -1;
+    else if(t == typeid(GEIIR)) res = a.lo >= b.hi ? 1 : a.hi < b.lo ? 0 : -1;
+    else if(t == typeid(EQUIIR) || t == typeid(NEIIR)) {
+        bool isEq = t == typeid(EQUIIR);
+        if(a.isConst() && b.isConst() && a.lo == b.lo) res = isEq;
+        else if(a.hi < b.lo || b.hi < a.lo) res = !isEq;
+    } else {
+        return full();
+    }
+    return res < 0 ? Range{0, 1} : single(res);
+}
+
+inline RangeAnalysis::Range RangeAnalysis::join(Range a, Range b) {
+    if(a.isEmpty()) return b;
+    if(b.isEmpty()) return a;
+    return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+inline RangeAnalysis::Range RangeAnalysis::meet(Range a, Range b) {
+    Range r = {std::max(a.lo, b.lo), std::min(a.hi, b.hi)};
+    return r.isEmpty() ? empty() : r;
+}
+
+inline RangeAnalysis::Range RangeAnalysis::clamp(long long lo, long long hi) {
+    if(lo < INT_MIN || hi > INT_MAX) return full();
+    return {lo, hi};
+}
+
+// 整个区间都越界时没有不溢出的取值, 不做推断
+inline RangeAnalysis::Range RangeAnalysis::saturate(long long lo, long long hi) {
+    if(lo > INT_MAX || hi < INT_MIN) return full();
+    return {std::max(lo, (long long) INT_MIN), std::min(hi, (long long) INT_MAX)};
+}
+
+#endif //SYSY2022_BJTU_RANGEANALYSIS_HH
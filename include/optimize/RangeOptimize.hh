@@ -0,0 +1,63 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_RANGEOPTIMIZE_HH
+#define SYSY2022_BJTU_RANGEOPTIMIZE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "RangeAnalysis.hh"
+#include "IRHelper.hh"
+
+// 按值域分析的结果化简, 在 SSA 上做, 需要有效的支配树, 不改 CFG
+// 结果只有一个值的 int 运算和比较换成常量 move, 分支留给之后的 SCCP 折叠
+// 被除数非负的除法和取模打上 nonNegative 标记, 后端据此省掉负数的修正, % 2^k 换成 and
+class RangeOptimize {
+private:
+    IrVisitor* irVisitor;
+    RangeAnalysis rangeAnalysis;
+
+    int foldedCnt = 0;
+    int markedCnt = 0;
+public:
+    RangeOptimize(IrVisitor* irVisitor) : irVisitor(irVisitor), rangeAnalysis(irVisitor) {;}
+    void execute();
+    int getFoldedCnt() { return foldedCnt; }
+    int getMarkedCnt() { return markedCnt; }
+};
+
+inline void RangeOptimize::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        rangeAnalysis.analyze(func);
+        for(BasicBlock* bb : func->getBB()) {
+            auto& irs = bb->getIr();
+            for(size_t i(0); i < irs.size(); i++) {
+                Instruction* ir = irs[i];
+                if(ir->isDeleted() || (!dynamic_cast<ArithmeticIR*>(ir) && typeid(*ir) != typeid(UnaryIR))) continue;
+                Value* dst = getDefVal(ir);
+                RangeAnalysis::Range r = rangeAnalysis.getRange(dst);
+                if(!r.isEmpty() && r.isConst()) {
+                    TempVal* c = new TempVal();
+                    c->setType(new Type(TypeID::INT));
+                    c->setInt((int) r.lo);
+                    irs[i] = new MoveIR(dst, c);
+                    foldedCnt++;
+                    continue;
+                }
+                const std::type_info& t = typeid(*ir);
+                if(t != typeid(DivIIR) && t != typeid(ModIR)) continue;
+                ArithmeticIR* arIr = dynamic_cast<ArithmeticIR*>(ir);
+                if(arIr->nonNegative) continue;
+                RangeAnalysis::Range left = rangeAnalysis.getRangeAt(ir->getOperands()[1]->getVal(), bb);
+                if(!left.isEmpty() && left.lo >= 0) {
+                    arIr->nonNegative = true;
+                    markedCnt++;
+                }
+            }
+        }
+    }
+}
+
+#endif //SYSY2022_BJTU_RANGEOPTIMIZE_HH
@@ -0,0 +1,544 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_SCCP_HH
+#define SYSY2022_BJTU_SCCP_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_set>
+#include <cmath>
+#include <climits>
+#include <cstring>
+
+// 稀疏条件常量传播 (Wegman-Zadeck)
+// 格: TOP(未定) > 常量 > BOTTOM(非常量), 只下降
+// CFG 工作表记录新变为可执行的边, SSA 工作表记录格值变化的变量, 只在可执行块中求值
+// 结束后: 常量代入 TempVal 操作数, 常量定值删除(仍被引用时改为 MoveIR), 常量分支改为跳转, 删除不可达块
+// codegen 不支持两个操作数都是常量的运算, 这种情况不代入
+class SCCP {
+private:
+    enum { TOP, CONST, BOTTOM };
+    struct Lattice {
+        int state = TOP;
+        bool isFloat = false;
+        int i = 0;
+        float f = 0;
+        bool operator==(const Lattice& l) const {
+            if(state != l.state) return false;
+            if(state != CONST) return true;
+            return isFloat == l.isFloat && (isFloat ? !memcmp(&f, &l.f, sizeof(f)) : i == l.i);
+        }
+    };
+    IrVisitor* irVisitor;
+    Function* function;
+    // 按值的 num 索引, 表项存指针校验; 多次定值或 num 重复的值为 BOTTOM
+    std::vector<std::pair<Value*, Lattice>> lattice;
+    std::vector<std::vector<std::pair<Instruction*, BasicBlock*>>> users;
+    Value* const collide = reinterpret_cast<Value*>(-1);
+    std::vector<bool> bbExec;
+    std::unordered_set<uint64_t> edgeExec;
+    std::vector<std::pair<BasicBlock*, BasicBlock*>> cfgWork;
+    std::vector<Value*> ssaWork;
+    std::vector<Use*> uses;
+
+    int foldedCnt = 0;
+    int branchCnt = 0;
+    int removedBBCnt = 0;
+
+    void init();
+    void solve();
+    void markEdge(BasicBlock* from, BasicBlock* to);
+    void visitBB(BasicBlock* bb);
+    void visit(Instruction* ir, BasicBlock* bb);
+    void update(Value* val, const Lattice& l);
+    Lattice evaluate(Instruction* ir);
+    Lattice foldBinary(Instruction* ir, Lattice a, Lattice b);
+    Lattice getLattice(Value* val);
+    bool rewrite();
+    void substitute(Instruction* ir);
+    void setConst(TempVal* t, const Lattice& l, bool isFloat);
+    static Lattice constOf(int x) {
+        Lattice l;
+        l.state = CONST;
+        l.i = x;
+        return l;
+    }
+    static Lattice constOf(float x) {
+        Lattice l;
+        l.state = CONST;
+        l.isFloat = true;
+        l.f = x;
+        return l;
+    }
+    static Lattice bottom() {
+        Lattice l;
+        l.state = BOTTOM;
+        return l;
+    }
+    static Lattice castTo(Lattice l, bool isFloat);
+    int getNum(Value* val) {
+        return val && val->getNum() >= 0 && val->getNum() < (int) lattice.size() ? val->getNum() : -1;
+    }
+    static uint64_t edgeKey(BasicBlock* from, BasicBlock* to) {
+        return (uint64_t) (uint32_t) from->getId() << 32 | (uint32_t) to->getId();
+    }
+    bool isTracked(Value* val) {
+        int num = getNum(val);
+        return num >= 0 && lattice[num].first == val;
+    }
+public:
+    SCCP(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void execute();
+    int getFoldedCnt() { return foldedCnt; }
+    int getBranchCnt() { return branchCnt; }
+    int getRemovedBBCnt() { return removedBBCnt; }
+};
+
+inline void SCCP::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        func->renumberBB();
+        init();
+        solve();
+        if(rewrite()) {
+            DominateTree dominateTree(irVisitor);
+            dominateTree.getIdom(func);
+            dominateTree.getDomFront(func);
+            dominateTree.genDominateTree(func);
+        }
+    }
+}
+
+// 单次定值的变量初始为 TOP, 其余为 BOTTOM; 建立变量到使用它的指令的表
+inline void SCCP::init() {
+    lattice.assign(function->varCnt, {nullptr, Lattice()});
+    for(auto bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            int num = getNum(getDefVal(ir));
+            if(num < 0) continue;
+            auto& entry = lattice[num];
+            if(!entry.first) {
+                entry.first = getDefVal(ir);
+            } else {
+                if(entry.first != getDefVal(ir)) entry.first = collide;
+                entry.second = bottom();
+            }
+        }
+    }
+    users.assign(lattice.size(), {});
+    for(auto bb : function->getBB()) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    Value* val = t ? t->getVal() : param.second;
+                    if(isTracked(val)) users[val->getNum()].push_back({ir, bb});
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                Value* val = getUseVal(use);
+                if(isTracked(val)) users[val->getNum()].push_back({ir, bb});
+            }
+        }
+    }
+    bbExec.assign(function->getBB().size(), false);
+    edgeExec.clear();
+    cfgWork.clear();
+    ssaWork.clear();
+}
+
+inline void SCCP::solve() {
+    bbExec[0] = true;
+    visitBB(function->getBB()[0]);
+    while(true) {
+        while(!cfgWork.empty() || !ssaWork.empty()) {
+            while(!cfgWork.empty()) {
+                BasicBlock* bb = cfgWork.back().second;
+                cfgWork.pop_back();
+                if(!bbExec[bb->getId()]) {
+                    bbExec[bb->getId()] = true;
+                    visitBB(bb);
+                    continue;
+                }
+                // 新边只影响 phi
+                for(auto ir : bb->getIr()) {
+                    if(typeid(*ir) != typeid(PhiIR)) break;
+                    visit(ir, bb);
+                }
+            }
+            while(!ssaWork.empty()) {
+                Value* val = ssaWork.back();
+                ssaWork.pop_back();
+                for(auto& user : users[val->getNum()]) {
+                    if(bbExec[user.second->getId()] && !user.first->isDeleted()) visit(user.first, user.second);
+                }
+            }
+        }
+        // 条件仍为 TOP 的分支(读未定义的值)两边都走, 保证结果保守
+        bool changed = false;
+        for(BasicBlock* bb : function->getBB()) {
+            if(!bbExec[bb->getId()] || bb->getIr().empty()) continue;
+            Instruction* ir = bb->getIr().back();
+            if(typeid(*ir) != typeid(BranchIR) || getLattice(ir->getOperands()[1]->getVal()).state != TOP) continue;
+            for(BasicBlock* succBB : bb->getSucc()) {
+                if(!edgeExec.count(edgeKey(bb, succBB))) {
+                    markEdge(bb, succBB);
+                    changed = true;
+                }
+            }
+        }
+        if(!changed) break;
+    }
+}
+
+inline void SCCP::markEdge(BasicBlock* from, BasicBlock* to) {
+    if(edgeExec.insert(edgeKey(from, to)).second) {
+        cfgWork.push_back({from, to});
+    }
+}
+
+inline void SCCP::visitBB(BasicBlock* bb) {
+    for(auto ir : bb->getIr()) {
+        if(!ir->isDeleted()) visit(ir, bb);
+    }
+    if(bb->getIr().empty() || typeid(*bb->getIr().back()) != typeid(BranchIR)) {
+        for(BasicBlock* succBB : bb->getSucc()) {
+            markEdge(bb, succBB);
+        }
+    }
+}
+
+inline void SCCP::visit(Instruction* ir, BasicBlock* bb) {
+    const std::type_info& t = typeid(*ir);
+    if(t == typeid(PhiIR)) {
+        PhiIR* phi = dynamic_cast<PhiIR*>(ir);
+        Value* dst = getDefVal(ir);
+        if(!isTracked(dst)) return;
+        Lattice res;
+        for(BasicBlock* preBB : bb->getPre()) {
+            auto it = phi->params.find(preBB);
+            if(it == phi->params.end() || !edgeExec.count(edgeKey(preBB, bb))) continue;
+            Lattice l = castTo(getLattice(it->second), dst->getType()->isFloat());
+            if(l.state == TOP) continue;
+            if(res.state == TOP) {
+                res = l;
+            } else if(!(res == l)) {
+                res = bottom();
+                break;
+            }
+        }
+        update(dst, res);
+        return;
+    }
+    if(t == typeid(BranchIR)) {
+        BranchIR* branchIr = dynamic_cast<BranchIR*>(ir);
+        Lattice cond = getLattice(ir->getOperands()[1]->getVal());
+        if(cond.state == CONST) {
+            bool taken = cond.isFloat ? cond.f != 0 : cond.i != 0;
+            markEdge(bb, taken ? branchIr->trueTarget : branchIr->falseTarget);
+        } else if(cond.state == BOTTOM) {
+            for(BasicBlock* succBB : bb->getSucc()) {
+                markEdge(bb, succBB);
+            }
+        }
+        return;
+    }
+    Value* dst = getDefVal(ir);
+    if(!isTracked(dst)) return;
+    update(dst, evaluate(ir));
+}
+
+// 格值只能下降
+inline void SCCP::update(Value* val, const Lattice& l) {
+    Lattice& cur = lattice[val->getNum()].second;
+    if(cur.state == BOTTOM || l.state == TOP || cur == l) return;
+    cur = cur.state == TOP ? l : bottom();
+    ssaWork.push_back(val);
+}
+
+// 变量取格值, 常量 TempVal 为常量, 不跟踪的值(参数、全局变量、多次定值)为 BOTTOM
+inline SCCP::Lattice SCCP::getLattice(Value* val) {
+    if(val && typeid(*val) == typeid(TempVal)) {
+        TempVal* t = dynamic_cast<TempVal*>(val);
+        if(!t->getVal()) {
+            if(!t->getType() || t->getType()->isString()) return bottom();
+            return t->isFloat() ? constOf(t->getFloat()) : constOf(t->getInt());
+        }
+        val = t->getVal();
+    }
+    if(!isTracked(val)) return bottom();
+    return lattice[val->getNum()].second;
+}
+
+inline SCCP::Lattice SCCP::castTo(Lattice l, bool isFloat) {
+    if(l.state != CONST || l.isFloat == isFloat) return l;
+    if(isFloat) return constOf((float) l.i);
+    if(std::isnan(l.f) || l.f >= 2147483648.0f || l.f < -2147483648.0f) return bottom();
+    return constOf((int) l.f);
+}
+
+inline SCCP::Lattice SCCP::evaluate(Instruction* ir) {
+    const std::type_info& t = typeid(*ir);
+    auto& operands = ir->getOperands();
+    if(t == typeid(MoveIR)) {
+        return castTo(getLattice(operands[1]->getVal()), getDefVal(ir)->getType()->isFloat());
+    }
+    if(dynamic_cast<ArithmeticIR*>(ir)) {
+        Lattice a = getLattice(operands[1]->getVal());
+        Lattice b = getLattice(operands[2]->getVal());
+        if(a.state == BOTTOM || b.state == BOTTOM) return bottom();
+        if(a.state == TOP || b.state == TOP) return Lattice();
+        return foldBinary(ir, a, b);
+    }
+    if(t == typeid(UnaryIR)) {
+        UnaryIR* unaryIr = dynamic_cast<UnaryIR*>(ir);
+        Lattice v = getLattice(operands[1]->getVal());
+        if(v.state != CONST) return v;
+        Lattice res;
+        if(unaryIr->op == OP::NOT) {
+            res = constOf((int) (v.isFloat ? v.f == 0 : v.i == 0));
+        } else {
+            res = v.isFloat ? constOf(-v.f) : constOf((int) (0u - (unsigned) v.i));
+        }
+        return castTo(res, unaryIr->res.isFloat());
+    }
+    if(t == typeid(CastInt2FloatIR) || t == typeid(CastFloat2IntIR)) {
+        return castTo(getLattice(operands[1]->getVal()), t == typeid(CastInt2FloatIR));
+    }
+    return bottom();
+}
+
+// 整数按 32 位补码回绕; 除零、NaN 参与的比较不折叠, 与目标机行为不一定一致
+inline SCCP::Lattice SCCP::foldBinary(Instruction* ir, Lattice a, Lattice b) {
+    const std::type_info& t = typeid(*ir);
+    bool isFloat = t == typeid(AddFIR) || t == typeid(SubFIR) || t == typeid(MulFIR) || t == typeid(DivFIR)
+                   || t == typeid(LTFIR) || t == typeid(LEFIR) || t == typeid(GTFIR) || t == typeid(GEFIR)
+                   || t == typeid(EQUFIR) || t == typeid(NEFIR);
+    a = castTo(a, isFloat);
+    b = castTo(b, isFloat);
+    if(a.state != CONST || b.state != CONST) return bottom();
+    if(isFloat) {
+        float x = a.f, y = b.f;
+        if(t == typeid(AddFIR)) return constOf(x + y);
+        if(t == typeid(SubFIR)) return constOf(x - y);
+        if(t == typeid(MulFIR)) return constOf(x * y);
+        if(t == typeid(DivFIR)) return constOf(x / y);
+        if(std::isnan(x) || std::isnan(y)) return bottom();
+        if(t == typeid(LTFIR)) return constOf((int) (x < y));
+        if(t == typeid(LEFIR)) return constOf((int) (x <= y));
+        if(t == typeid(GTFIR)) return constOf((int) (x > y));
+        if(t == typeid(GEFIR)) return constOf((int) (x >= y));
+        if(t == typeid(EQUFIR)) return constOf((int) (x == y));
+        return constOf((int) (x != y));
+    }
+    int x = a.i, y = b.i;
+    if(t == typeid(AddIIR)) return constOf((int) ((unsigned) x + (unsigned) y));
+    if(t == typeid(SubIIR)) return constOf((int) ((unsigned) x - (unsigned) y));
+    if(t == typeid(MulIIR)) return constOf((int) ((unsigned) x * (unsigned) y));
+    if(t == typeid(DivIIR)) {
+        if(y == 0) return bottom();
+        return constOf(x == INT_MIN && y == -1 ? INT_MIN : x / y);
+    }
+    if(t == typeid(ModIR)) {
+        if(y == 0) return bottom();
+        return constOf(x == INT_MIN && y == -1 ? 0 : x % y);
+    }
+    if(t == typeid(ShlIR)) {
+        if(y < 0 || y > 31) return bottom();
+        return constOf((int) ((unsigned) x << y));
+    }
+    if(t == typeid(LTIIR)) return constOf((int) (x < y));
+    if(t == typeid(LEIIR)) return constOf((int) (x <= y));
+    if(t == typeid(GTIIR)) return constOf((int) (x > y));
+    if(t == typeid(GEIIR)) return constOf((int) (x >= y));
+    if(t == typeid(EQUIIR)) return constOf((int) (x == y));
+    if(t == typeid(NEIIR)) return constOf((int) (x != y));
+    return bottom();
+}
+
+inline void SCCP::setConst(TempVal* t, const Lattice& l, bool isFloat) {
+    Lattice c = castTo(l, isFloat);
+    t->setVal(nullptr);
+    if(isFloat) {
+        t->setType(new Type(TypeID::FLOAT));
+        t->setFloat(c.f);
+    } else {
+        t->setType(new Type(TypeID::INT));
+        t->setInt(c.i);
+    }
+}
+
+// 把常量变量代入可以放常量的操作数
+inline void SCCP::substitute(Instruction* ir) {
+    const std::type_info& t = typeid(*ir);
+    auto& operands = ir->getOperands();
+    auto constVal = [&](Value* val) {
+        Lattice l = getLattice(val);
+        return val && typeid(*val) == typeid(TempVal) && dynamic_cast<TempVal*>(val)->getVal() && l.state == CONST;
+    };
+    auto isConst = [&](Value* val) {
+        return val && typeid(*val) == typeid(TempVal) && !dynamic_cast<TempVal*>(val)->getVal();
+    };
+    if(dynamic_cast<ArithmeticIR*>(ir)) {
+        for(int k(1); k <= 2; k++) {
+            Value* val = operands[k]->getVal();
+            Value* other = operands[3 - k]->getVal();
+            if(constVal(val) && !isConst(other) && !constVal(other)) {
+                TempVal* tv = dynamic_cast<TempVal*>(val);
+                setConst(tv, getLattice(tv), tv->getVal()->getType()->isFloat());
+                foldedCnt++;
+            }
+        }
+        return;
+    }
+    size_t begin = 0, end = 0;
+    if(t == typeid(StoreIIR) || t == typeid(StoreFIR) || t == typeid(UnaryIR)) {
+        begin = 1, end = 2;
+    } else if(t == typeid(CallIR)) {
+        begin = 1, end = operands.size();
+    }
+    for(size_t k(begin); k < end; k++) {
+        Value* val = operands[k]->getVal();
+        if(!constVal(val)) continue;
+        TempVal* tv = dynamic_cast<TempVal*>(val);
+        bool isFloat = t == typeid(StoreFIR) || (t != typeid(StoreIIR) && tv->getVal()->getType()->isFloat());
+        setConst(tv, getLattice(tv), isFloat);
+        foldedCnt++;
+    }
+    if(t == typeid(GEPIR) && operands[2]->getVal()) {
+        Lattice l = getLattice(operands[2]->getVal());
+        if(l.state == CONST && !l.isFloat) {
+            operands[2]->setVal(nullptr);
+            dynamic_cast<GEPIR*>(ir)->arrayLen = l.i;
+            foldedCnt++;
+        }
+    }
+}
+
+// 返回 CFG 是否改变
+inline bool SCCP::rewrite() {
+    std::vector<BasicBlock*>& bbs = function->getBB();
+    auto isConstDef = [&](Instruction* ir) {
+        Value* dst = getDefVal(ir);
+        return isTracked(dst) && lattice[dst->getNum()].second.state == CONST;
+    };
+    // 代入常量
+    for(BasicBlock* bb : bbs) {
+        if(!bbExec[bb->getId()]) continue;
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                if(isConstDef(ir)) continue;
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* tv = dynamic_cast<TempVal*>(param.second);
+                    if(!tv || !tv->getVal() || getLattice(tv).state != CONST) continue;
+                    setConst(tv, getLattice(tv), getDefVal(ir)->getType()->isFloat());
+                }
+                continue;
+            }
+            if(!isConstDef(ir)) substitute(ir);
+        }
+    }
+    // 仍被引用的常量, 条件为常量的分支和返回常量的 ret 下面会改写, 不算引用
+    std::vector<bool> used(lattice.size(), false);
+    for(BasicBlock* bb : bbs) {
+        if(!bbExec[bb->getId()]) continue;
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted() || isConstDef(ir)) continue;
+            if((typeid(*ir) == typeid(BranchIR) || typeid(*ir) == typeid(ReturnIR))
+               && getLattice(ir->getOperands()[1]->getVal()).state == CONST) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* tv = dynamic_cast<TempVal*>(param.second);
+                    Value* val = tv ? tv->getVal() : param.second;
+                    if(isTracked(val)) used[val->getNum()] = true;
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                Value* val = getUseVal(use);
+                if(isTracked(val)) used[val->getNum()] = true;
+            }
+        }
+    }
+    // 常量定值删除或改为 MoveIR, 常量分支改为跳转
+    bool cfgChanged = false;
+    for(BasicBlock* bb : bbs) {
+        if(!bbExec[bb->getId()]) continue;
+        auto& irs = bb->getIr();
+        std::vector<Instruction*> kept, phiMoves;
+        for(auto ir : irs) {
+            if(ir->isDeleted()) {
+                kept.push_back(ir);
+                continue;
+            }
+            const std::type_info& t = typeid(*ir);
+            if(isConstDef(ir)) {
+                Value* dst = getDefVal(ir);
+                if(used[dst->getNum()]) {
+                    TempVal* c = new TempVal();
+                    setConst(c, lattice[dst->getNum()].second, dst->getType()->isFloat());
+                    (t == typeid(PhiIR) ? phiMoves : kept).push_back(new MoveIR(dst, c));
+                }
+                ir->deleteIR();
+                foldedCnt++;
+                continue;
+            }
+            if(t != typeid(PhiIR) && !phiMoves.empty()) {
+                kept.insert(kept.end(), phiMoves.begin(), phiMoves.end());
+                phiMoves.clear();
+            }
+            if(t == typeid(ReturnIR) && ir->getOperands()[1]->getVal()) {
+                Lattice l = getLattice(ir->getOperands()[1]->getVal());
+                if(l.state == CONST) {
+                    kept.push_back(l.isFloat ? new ReturnIR(l.f) : new ReturnIR(l.i));
+                    ir->deleteIR();
+                    continue;
+                }
+            }
+            if(t == typeid(BranchIR)) {
+                BranchIR* branchIr = dynamic_cast<BranchIR*>(ir);
+                Lattice cond = getLattice(ir->getOperands()[1]->getVal());
+                if(cond.state == CONST) {
+                    bool taken = cond.isFloat ? cond.f != 0 : cond.i != 0;
+                    BasicBlock* target = taken ? branchIr->trueTarget : branchIr->falseTarget;
+                    BasicBlock* other = taken ? branchIr->falseTarget : branchIr->trueTarget;
+                    if(other != target) {
+                        bb->removeSucc(other);
+                        for(auto phi : other->getIr()) {
+                            if(typeid(*phi) != typeid(PhiIR)) break;
+                            dynamic_cast<PhiIR*>(phi)->params.erase(bb);
+                        }
+                    }
+                    kept.push_back(new JumpIR(target));
+                    ir->deleteIR();
+                    branchCnt++;
+                    cfgChanged = true;
+                    continue;
+                }
+            }
+            kept.push_back(ir);
+        }
+        kept.insert(kept.end(), phiMoves.begin(), phiMoves.end());
+        irs.swap(kept);
+    }
+    size_t bbCnt = bbs.size();
+    if(removeUnreachableBB(function)) {
+        removedBBCnt += bbCnt - bbs.size();
+        cfgChanged = true;
+    }
+    return cfgChanged;
+}
+
+#endif //SYSY2022_BJTU_SCCP_HH
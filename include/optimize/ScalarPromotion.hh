@@ -0,0 +1,289 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_SCALARPROMOTION_HH
+#define SYSY2022_BJTU_SCALARPROMOTION_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "LoopInfo.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// 循环中全局标量的寄存器提升, 需要 LoopSimplify 之后的前置块和有效的支配树, 不改 CFG
+// 全局标量的地址不能取出来, 只会被直接 load/store; 函数(含间接调用的)读写的全局标量按调用图求到不动点
+// 循环中没有读写它的调用、出口块的前驱都在循环中时: 前置块里 load 一次, 循环中的 load/store 换成 SSA 值,
+// 循环中有 store 时在每个出口块开头写回; 外层循环能提升就不再看内层
+// SSA 值按需构造: 块首的值在首块和多前驱块上建 phi, 其余取唯一前驱末尾的值, 最后去掉平凡的 phi
+class ScalarPromotion {
+private:
+    IrVisitor* irVisitor;
+    Function* function;
+    LoopInfo loopInfo;
+    // 函数读写的全局标量, 含被调函数的
+    std::unordered_map<Function*, std::unordered_set<Value*>> touched;
+    std::unordered_map<Value*, int> defCnt;
+    // 被替换的 load 结果和平凡 phi -> 替换的值, 函数处理完统一改写使用
+    std::unordered_map<Value*, Value*> valMap;
+
+    // 当前提升的变量
+    Value* global;
+    Loop* loop;
+    Value* initVal;
+    std::unordered_map<BasicBlock*, Value*> startVal, endVal;
+    std::vector<std::pair<PhiIR*, BasicBlock*>> newPhis;
+
+    int promotedCnt = 0;
+    int loadCnt = 0;
+    int storeCnt = 0;
+
+    void computeTouched();
+    void promoteIn(Loop* loop, Value* global);
+    bool hasDedicatedExits(Loop* loop);
+    void promote(Loop* loop, Value* global, bool dirty);
+    Value* getStart(BasicBlock* bb);
+    Value* getEnd(BasicBlock* bb);
+    void removeTrivialPhis();
+    static bool isGlobalScalar(Value* val) { return val && val->is_Global() && !val->is_Array(); }
+public:
+    ScalarPromotion(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void execute();
+    int getPromotedCnt() { return promotedCnt; }
+    int getLoadCnt() { return loadCnt; }
+    int getStoreCnt() { return storeCnt; }
+};
+
+inline void ScalarPromotion::execute() {
+    computeTouched();
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        loopInfo.analyze(func);
+        if(loopInfo.getLoops().empty()) continue;
+        std::vector<Value*> globals;
+        std::unordered_set<Value*> seen;
+        defCnt.clear();
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                Value* dst = getDefVal(ir);
+                if(dst) defCnt[dst]++;
+                const std::type_info& t = typeid(*ir);
+                Value* addr = nullptr;
+                if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) addr = ir->getOperands()[1]->getVal();
+                if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) addr = ir->getOperands()[0]->getVal();
+                if(isGlobalScalar(addr) && seen.insert(addr).second) globals.push_back(addr);
+            }
+        }
+        valMap.clear();
+        for(Value* g : globals) {
+            for(Loop* top : loopInfo.getTopLoops()) {
+                promoteIn(top, g);
+            }
+        }
+        if(!valMap.empty()) applyValMap(function, valMap);
+    }
+}
+
+inline void ScalarPromotion::computeTouched() {
+    std::unordered_map<Function*, std::vector<Function*>> callees;
+    for(Function* func : irVisitor->getFunctions()) {
+        auto& set = touched[func];
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                const std::type_info& t = typeid(*ir);
+                if(t == typeid(CallIR)) {
+                    callees[func].push_back(dynamic_cast<CallIR*>(ir)->func);
+                } else if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) {
+                    if(isGlobalScalar(ir->getOperands()[1]->getVal())) set.insert(ir->getOperands()[1]->getVal());
+                } else if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+                    if(isGlobalScalar(ir->getOperands()[0]->getVal())) set.insert(ir->getOperands()[0]->getVal());
+                }
+            }
+        }
+    }
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(auto& item : callees) {
+            auto& set = touched[item.first];
+            for(Function* callee : item.second) {
+                for(Value* g : touched[callee]) {
+                    if(set.insert(g).second) changed = true;
+                }
+            }
+        }
+    }
+}
+
+inline bool ScalarPromotion::hasDedicatedExits(Loop* loop) {
+    for(BasicBlock* exitBB : loop->exits) {
+        for(BasicBlock* preBB : exitBB->getPre()) {
+            if(!loop->contains(preBB)) return false;
+        }
+    }
+    return true;
+}
+
+inline void ScalarPromotion::promoteIn(Loop* loop, Value* global) {
+    int loads = 0, stores = 0;
+    bool clobbered = false;
+    for(BasicBlock* bb : loop->bbs) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            const std::type_info& t = typeid(*ir);
+            if(t == typeid(CallIR)) {
+                if(touched[dynamic_cast<CallIR*>(ir)->func].count(global)) clobbered = true;
+            } else if(t == typeid(LoadIIR) || t == typeid(LoadFIR)) {
+                if(ir->getOperands()[1]->getVal() == global) loads++;
+            } else if(t == typeid(StoreIIR) || t == typeid(StoreFIR)) {
+                if(ir->getOperands()[0]->getVal() == global) stores++;
+            }
+        }
+    }
+    if(loads + stores == 0) return;
+    if(clobbered || !loop->getPreheader() || !hasDedicatedExits(loop)) {
+        for(Loop* subLoop : loop->subLoops) {
+            promoteIn(subLoop, global);
+        }
+        return;
+    }
+    promote(loop, global, stores > 0);
+    promotedCnt++;
+}
+
+inline void ScalarPromotion::promote(Loop* loop, Value* global, bool dirty) {
+    this->global = global;
+    this->loop = loop;
+    startVal.clear();
+    endVal.clear();
+    newPhis.clear();
+    Type* type = global->getType()->getContained();
+    bool isFloat = type->isFloat();
+
+    // 前置块末尾取初值
+    BasicBlock* preheader = loop->getPreheader();
+    initVal = new VarValue("", type, false, function->varCnt++);
+    auto& preIrs = preheader->getIr();
+    auto pos = preIrs.end();
+    if(!preIrs.empty()) {
+        const std::type_info& t = typeid(*preIrs.back());
+        if(t == typeid(JumpIR) || t == typeid(BranchIR)) pos--;
+    }
+    preIrs.insert(pos, isFloat ? static_cast<Instruction*>(new LoadFIR(initVal, global)) : new LoadIIR(initVal, global));
+
+    // store 的值记下来, 块末尾的值为最后一个 store 的值; 常量和多次定值的变量先拷贝到新变量
+    std::unordered_map<Instruction*, Value*> storeVal;
+    for(BasicBlock* bb : loop->bbs) {
+        auto& irs = bb->getIr();
+        for(size_t i(0); i < irs.size(); i++) {
+            Instruction* ir = irs[i];
+            if(ir->isDeleted() || !dynamic_cast<StoreIR*>(ir) || ir->getOperands()[0]->getVal() != global) continue;
+            TempVal* src = dynamic_cast<TempVal*>(ir->getOperands()[1]->getVal());
+            Value* val = src->getVal();
+            if(!val || defCnt[val] > 1) {
+                Value* copy = new VarValue("", type, false, function->varCnt++);
+                irs.insert(irs.begin() + i, new MoveIR(copy, val ? wrapVal(val) : castConst(src, type)));
+                i++;
+                val = copy;
+            }
+            ir->deleteIR();
+            storeVal[ir] = val;
+            endVal[bb] = val;
+            storeCnt++;
+        }
+    }
+    // load 换成到达的值
+    for(BasicBlock* bb : loop->bbs) {
+        Value* cur = nullptr;
+        for(auto ir : bb->getIr()) {
+            auto it = storeVal.find(ir);
+            if(it != storeVal.end()) {
+                cur = it->second;
+                continue;
+            }
+            const std::type_info& t = typeid(*ir);
+            if(ir->isDeleted() || (t != typeid(LoadIIR) && t != typeid(LoadFIR))) continue;
+            if(ir->getOperands()[1]->getVal() != global) continue;
+            valMap[getDefVal(ir)] = cur ? cur : getStart(bb);
+            ir->deleteIR();
+            loadCnt++;
+        }
+    }
+    // 出口块开头写回
+    if(dirty) {
+        for(BasicBlock* exitBB : loop->exits) {
+            Value* val = getStart(exitBB);
+            auto& irs = exitBB->getIr();
+            size_t i = 0;
+            while(i < irs.size() && typeid(*irs[i]) == typeid(PhiIR)) i++;
+            Instruction* store = isFloat ? static_cast<Instruction*>(new StoreFIR(global, *wrapVal(val)))
+                                         : new StoreIIR(global, *wrapVal(val));
+            irs.insert(irs.begin() + i, store);
+        }
+    }
+    for(auto& item : newPhis) {
+        auto& irs = item.second->getIr();
+        irs.insert(irs.begin(), item.first);
+    }
+    removeTrivialPhis();
+}
+
+inline Value* ScalarPromotion::getEnd(BasicBlock* bb) {
+    auto it = endVal.find(bb);
+    return it != endVal.end() ? it->second : getStart(bb);
+}
+
+// 首块和多前驱块先建 phi 再填参数, 回边上的查询会停在这个 phi
+inline Value* ScalarPromotion::getStart(BasicBlock* bb) {
+    auto it = startVal.find(bb);
+    if(it != startVal.end()) return it->second;
+    auto& preBBs = bb->getPre();
+    if(bb != loop->header && preBBs.size() == 1) {
+        Value* val = getEnd(preBBs[0]);
+        startVal[bb] = val;
+        return val;
+    }
+    Value* dst = new VarValue("", global->getType()->getContained(), false, function->varCnt++);
+    PhiIR* phi = new PhiIR({}, dst);
+    startVal[bb] = dst;
+    newPhis.push_back({phi, bb});
+    for(BasicBlock* preBB : preBBs) {
+        phi->params[preBB] = wrapVal(loop->contains(preBB) ? getEnd(preBB) : initVal);
+    }
+    return dst;
+}
+
+// 参数除自身外都是同一个值的 phi 换成这个值, 直到不变
+inline void ScalarPromotion::removeTrivialPhis() {
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(auto& item : newPhis) {
+            PhiIR* phi = item.first;
+            if(phi->isDeleted()) continue;
+            Value* dst = getDefVal(phi);
+            Value* same = nullptr;
+            bool trivial = true;
+            for(auto& param : phi->params) {
+                Value* val = resolveVal(valMap, dynamic_cast<TempVal*>(param.second)->getVal());
+                if(val == dst || val == same) continue;
+                if(same) {
+                    trivial = false;
+                    break;
+                }
+                same = val;
+            }
+            if(!trivial || !same) continue;
+            valMap[dst] = same;
+            phi->deleteIR();
+            changed = true;
+        }
+    }
+}
+
+#endif //SYSY2022_BJTU_SCALARPROMOTION_HH
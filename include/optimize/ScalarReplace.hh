@@ -0,0 +1,229 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_SCALARREPLACE_HH
+#define SYSY2022_BJTU_SCALARREPLACE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+// 小的局部数组拆成标量, 之后由 Mem2reg 提升为 SSA 变量; 不改 CFG
+// 数组的地址只能经下标为常数的 GEP(可以多级)到达 load/store 的地址, 其它使用(传参、phi、存进内存)都不拆
+// 每个被访问到的元素一个标量 alloca, 放在原 alloca 处, memset 清零的元素在其后补一个存 0 的 store
+// 下标按定值链求常数: 常量 move 和两边都是常数的加减乘, 多次定值的变量不算
+class ScalarReplace {
+private:
+    struct Array {
+        AllocIR* alloc;
+        bool ok;
+        // 元素偏移 -> 标量
+        std::map<int, Value*> elems;
+    };
+    // GEP 结果所属的数组和相对数组首的元素偏移, array 为 nullptr 表示不是待拆的数组
+    struct Addr {
+        Array* array;
+        int offset;
+        bool known;
+    };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    std::unordered_map<Value*, Instruction*> defIr;
+    std::unordered_map<Value*, int> defCnt;
+    std::unordered_map<Value*, Array> arrays;
+    std::unordered_map<Value*, Addr> addrCache;
+
+    static const int maxLen = 16;
+    static const int maxDepth = 16;
+
+    int arrayCnt = 0;
+    int elemCnt = 0;
+
+    Addr getAddr(Value* val, int depth);
+    bool constIndex(Value* val, int& res, int depth);
+    void split(Array& array);
+public:
+    ScalarReplace(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void execute();
+    int getArrayCnt() { return arrayCnt; }
+    int getElemCnt() { return elemCnt; }
+};
+
+inline void ScalarReplace::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        defIr.clear();
+        defCnt.clear();
+        arrays.clear();
+        addrCache.clear();
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                Value* dst = getDefVal(ir);
+                if(!dst) continue;
+                defIr[dst] = ir;
+                defCnt[dst]++;
+            }
+        }
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                AllocIR* alloc = dynamic_cast<AllocIR*>(ir);
+                if(!alloc || ir->isDeleted() || !alloc->isArray || alloc->arrayLen > maxLen) continue;
+                Value* dst = getDefVal(ir);
+                if(dst->is_Global() || defCnt[dst] != 1) continue;
+                arrays[dst] = {alloc, true, {}};
+            }
+        }
+        if(arrays.empty()) continue;
+
+        // 检查每个使用: GEP 的基址要求本身偏移已知, load/store 的地址要求元素在数组内
+        std::vector<Use*> uses;
+        for(BasicBlock* bb : func->getBB()) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                const std::type_info& t = typeid(*ir);
+                if(t == typeid(PhiIR)) {
+                    for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                        TempVal* tv = dynamic_cast<TempVal*>(param.second);
+                        Addr addr = getAddr(tv ? tv->getVal() : param.second, 0);
+                        if(addr.array) addr.array->ok = false;
+                    }
+                    continue;
+                }
+                bool isMem = t == typeid(LoadIIR) || t == typeid(LoadFIR) || t == typeid(StoreIIR) || t == typeid(StoreFIR);
+                getUseOperands(ir, uses);
+                for(size_t i(0); i < uses.size(); i++) {
+                    Addr addr = getAddr(getUseVal(uses[i]), 0);
+                    if(!addr.array) continue;
+                    if(t == typeid(GEPIR) && i == 0) {
+                        if(!getAddr(getDefVal(ir), 0).known) addr.array->ok = false;
+                    } else if(isMem && i == 0) {
+                        if(!addr.known || addr.offset < 0 || addr.offset >= addr.array->alloc->arrayLen) {
+                            addr.array->ok = false;
+                        } else {
+                            addr.array->elems[addr.offset] = nullptr;
+                        }
+                    } else {
+                        addr.array->ok = false;
+                    }
+                }
+            }
+        }
+        for(auto& item : arrays) {
+            if(item.second.ok) split(item.second);
+        }
+    }
+}
+
+inline ScalarReplace::Addr ScalarReplace::getAddr(Value* val, int depth) {
+    Addr res = {nullptr, 0, false};
+    if(!val || depth > maxDepth) return res;
+    auto arr = arrays.find(val);
+    if(arr != arrays.end()) return {&arr->second, 0, true};
+    auto it = addrCache.find(val);
+    if(it != addrCache.end()) return it->second;
+    auto def = defIr.find(val);
+    if(def == defIr.end() || typeid(*def->second) != typeid(GEPIR)) return res;
+    auto& operands = def->second->getOperands();
+    res = getAddr(getUseVal(operands[1]), depth + 1);
+    if(res.array) {
+        int index = 0;
+        if(defCnt[val] > 1) {
+            res.known = false;
+        } else if(!operands[2]->getVal()) {
+            res.offset += dynamic_cast<GEPIR*>(def->second)->arrayLen;
+        } else if(res.known && constIndex(getUseVal(operands[2]), index, 0)) {
+            res.offset += index;
+        } else {
+            res.known = false;
+        }
+    }
+    return addrCache[val] = res;
+}
+
+inline bool ScalarReplace::constIndex(Value* val, int& res, int depth) {
+    auto def = defIr.find(val);
+    if(!val || depth > maxDepth || def == defIr.end() || defCnt[val] != 1) return false;
+    Instruction* ir = def->second;
+    const std::type_info& t = typeid(*ir);
+    auto& operands = ir->getOperands();
+    auto operand = [&](Use* use, int& c) {
+        TempVal* tv = dynamic_cast<TempVal*>(use->getVal());
+        if(tv && !tv->getVal()) {
+            if(!tv->getType() || !tv->getType()->isInt()) return false;
+            c = tv->getInt();
+            return true;
+        }
+        return constIndex(getUseVal(use), c, depth + 1);
+    };
+    int a, b;
+    if(t == typeid(MoveIR)) {
+        if(!operand(operands[1], a)) return false;
+        res = a;
+        return true;
+    }
+    if(t != typeid(AddIIR) && t != typeid(SubIIR) && t != typeid(MulIIR)) return false;
+    if(!operand(operands[1], a) || !operand(operands[2], b)) return false;
+    res = t == typeid(AddIIR) ? a + b : t == typeid(SubIIR) ? a - b : a * b;
+    return true;
+}
+
+// 原 alloca 换成各元素的标量 alloca 和清零的 store, 访问改用标量, GEP 全部删掉
+inline void ScalarReplace::split(Array& array) {
+    AllocIR* alloc = array.alloc;
+    Value* base = getDefVal(alloc);
+    bool isFloat = typeid(*alloc) == typeid(AllocFIR);
+    std::vector<Instruction*> news;
+    for(auto& elem : array.elems) {
+        Value* var = new VarValue("", base->getType(), false, function->varCnt++);
+        elem.second = var;
+        news.push_back(isFloat ? static_cast<Instruction*>(new AllocFIR(var)) : new AllocIIR(var));
+    }
+    for(auto& elem : array.elems) {
+        if(elem.first < alloc->zeroBegin || elem.first >= alloc->getZeroEnd()) continue;
+        TempVal zero;
+        zero.setType(new Type(TypeID::INT));
+        zero.setInt(0);
+        TempVal* c = castConst(&zero, base->getType()->getContained());
+        news.push_back(isFloat ? static_cast<Instruction*>(new StoreFIR(elem.second, *c)) : new StoreIIR(elem.second, *c));
+    }
+
+    std::vector<Use*> uses;
+    for(BasicBlock* bb : function->getBB()) {
+        auto& irs = bb->getIr();
+        for(size_t i(0); i < irs.size(); i++) {
+            Instruction* ir = irs[i];
+            if(ir->isDeleted()) continue;
+            if(ir == alloc) {
+                // 没有被访问的元素时整个数组直接去掉
+                if(news.empty()) {
+                    ir->deleteIR();
+                    continue;
+                }
+                irs[i] = news[0];
+                irs.insert(irs.begin() + i + 1, news.begin() + 1, news.end());
+                i += news.size() - 1;
+                continue;
+            }
+            const std::type_info& t = typeid(*ir);
+            if(t == typeid(GEPIR)) {
+                if(getAddr(getDefVal(ir), 0).array == &array) ir->deleteIR();
+                continue;
+            }
+            if(t != typeid(LoadIIR) && t != typeid(LoadFIR) && t != typeid(StoreIIR) && t != typeid(StoreFIR)) continue;
+            getUseOperands(ir, uses);
+            Addr addr = getAddr(getUseVal(uses[0]), 0);
+            if(addr.array == &array) setUseVal(uses[0], array.elems[addr.offset]);
+        }
+    }
+    arrayCnt++;
+    elemCnt += array.elems.size();
+}
+
+#endif //SYSY2022_BJTU_SCALARREPLACE_HH
@@ -0,0 +1,504 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_STRENGTHREDUCE_HH
+#define SYSY2022_BJTU_STRENGTHREDUCE_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "LoopInfo.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <tuple>
+
+// 归纳变量强度削弱和线性函数测试替换, 需要前置块、唯一回边块和有效的支配树, 不改 CFG
+// 基本归纳变量: 首块 phi(前置块: init, 回边块: i + c), c 为常数
+// 导出归纳变量: scale * i + off + oc, scale、oc 为常数, off 为循环不变量; 由加、减、乘常数得到
+// GEP 下标是导出归纳变量时, 改为首块中的指针 phi, 每轮在回边块加 4 * scale * c; 同基址同表达式的 GEP 共用一个指针
+// 乘法形式的导出归纳变量同样改为整数 phi 累加; 改写后没有使用的下标计算和归纳变量删除
+// 测试替换: 首块 i < n 或 i <= n 退出, n 和 init 为常数且循环至少执行一次、只从首块退出,
+// 被改写的 GEP 每轮都执行时, 比较改到指针上, 指针不会越过数组附近的范围, 比较不会回绕
+class StrengthReduce {
+private:
+    struct BIV {
+        PhiIR* phi;
+        Value* val;
+        TempVal* init;
+        int step;
+        Instruction* inc;
+    };
+    // scale * biv + off + oc; biv 为 -1 时是循环不变量
+    struct Linear {
+        int biv = -1;
+        long long scale = 0;
+        Value* off = nullptr;
+        long long oc = 0;
+    };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    LoopInfo loopInfo;
+    DefUseTable defUse;
+    std::vector<Use*> uses;
+
+    Loop* loop;
+    std::vector<BIV> bivs;
+    std::unordered_map<Value*, Linear> ivs;
+    // 每个基本归纳变量上新建的指针: (基址, 表达式) -> (指针 phi 的值, 首个被改写的 GEP 所在块)
+    std::map<std::tuple<int, Value*, long long, Value*, long long>, std::pair<Value*, BasicBlock*>> ptrs;
+
+    int ivCnt = 0;
+    int gepCnt = 0;
+    int testCnt = 0;
+
+    bool isSingleDef(Value* val) { return val && val->getNum() >= 0 && val->getNum() < (int) defUse.defBB.size() && defUse.defBB[val->getNum()].first == val; }
+    bool isInvariant(Value* val);
+    bool getLinear(Value* operand, Linear& l);
+    void findBIVs();
+    void findIVs();
+    bool usedOutside(Value* val);
+    void replaceUses(Value* from, Value* to);
+    Value* newVar(Type* type) { return new VarValue("", type, false, function->varCnt++); }
+    Value* emitStart(Linear& l, std::vector<Instruction*>& code);
+    Value* reduce(Linear& l, Value* base, Type* type);
+    void reduceGEPs();
+    void reduceMuls();
+    void replaceTests();
+    void removeDead();
+    void emit(BasicBlock* bb, std::vector<Instruction*>& code);
+    static bool fits(long long x) { return x >= INT32_MIN && x <= INT32_MAX; }
+public:
+    StrengthReduce(IrVisitor* irVisitor) : irVisitor(irVisitor) {;}
+    void execute();
+    int getIVCnt() { return ivCnt; }
+    int getGEPCnt() { return gepCnt; }
+    int getTestCnt() { return testCnt; }
+};
+
+inline void StrengthReduce::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        loopInfo.analyze(func);
+        if(loopInfo.getLoops().empty()) continue;
+        defUse.build(function);
+        for(Loop* l : loopInfo.getLoops()) {
+            if(!l->getPreheader() || !l->getLatch()) continue;
+            this->loop = l;
+            findBIVs();
+            if(bivs.empty()) continue;
+            findIVs();
+            ptrs.clear();
+            reduceGEPs();
+            removeDead();
+            reduceMuls();
+            replaceTests();
+            removeDead();
+        }
+    }
+}
+
+inline bool StrengthReduce::isInvariant(Value* val) {
+    if(!val || val->getNum() < 0 || val->getNum() >= (int) defUse.defBB.size()) return true;
+    auto& entry = defUse.defBB[val->getNum()];
+    if(entry.first == defUse.collide) return false;
+    if(entry.first != val) return true;
+    return !loop->contains(entry.second);
+}
+
+// 首块的 phi, 回边上的值为 phi + 常数
+inline void StrengthReduce::findBIVs() {
+    bivs.clear();
+    BasicBlock* preheader = loop->getPreheader();
+    BasicBlock* latch = loop->getLatch();
+    for(auto ir : loop->header->getIr()) {
+        if(typeid(*ir) != typeid(PhiIR)) break;
+        PhiIR* phi = dynamic_cast<PhiIR*>(ir);
+        Value* val = getDefVal(phi);
+        if(phi->isDeleted() || !isSingleDef(val) || val->getType()->isFloat() || phi->params.size() != 2) continue;
+        auto initIt = phi->params.find(preheader);
+        auto nextIt = phi->params.find(latch);
+        if(initIt == phi->params.end() || nextIt == phi->params.end()) continue;
+        TempVal* init = dynamic_cast<TempVal*>(initIt->second);
+        TempVal* next = dynamic_cast<TempVal*>(nextIt->second);
+        if(!init || !next || !next->getVal() || !isSingleDef(next->getVal())) continue;
+        // 找 next 的定值
+        Instruction* inc = nullptr;
+        for(Instruction* user : defUse.users[val->getNum()]) {
+            if(!user->isDeleted() && user != phi && getDefVal(user) == next->getVal()) inc = user;
+        }
+        if(!inc || !loop->contains(defUse.irBB[inc]) || (typeid(*inc) != typeid(AddIIR) && typeid(*inc) != typeid(SubIIR))) continue;
+        auto& operands = inc->getOperands();
+        TempVal* left = dynamic_cast<TempVal*>(operands[1]->getVal());
+        TempVal* right = dynamic_cast<TempVal*>(operands[2]->getVal());
+        int step;
+        if(typeid(*inc) == typeid(AddIIR) && left->getVal() == val && !right->getVal()) {
+            step = right->getInt();
+        } else if(typeid(*inc) == typeid(AddIIR) && right->getVal() == val && !left->getVal()) {
+            step = left->getInt();
+        } else if(typeid(*inc) == typeid(SubIIR) && left->getVal() == val && !right->getVal() && right->getInt() != INT32_MIN) {
+            step = -right->getInt();
+        } else {
+            continue;
+        }
+        if(step == 0) continue;
+        bivs.push_back({phi, val, init, step, inc});
+    }
+}
+
+// 操作数的线性表达式: 常数、循环不变量或已知的归纳变量
+inline bool StrengthReduce::getLinear(Value* operand, Linear& l) {
+    l = Linear();
+    TempVal* t = dynamic_cast<TempVal*>(operand);
+    Value* val = t ? t->getVal() : operand;
+    if(!val) {
+        if(!t || !t->getType() || !t->isInt()) return false;
+        l.oc = t->getInt();
+        return true;
+    }
+    auto it = ivs.find(val);
+    if(it != ivs.end()) {
+        l = it->second;
+        return true;
+    }
+    if(!isInvariant(val) || val->getType()->isFloat()) return false;
+    l.off = val;
+    return true;
+}
+
+// 不动点迭代求导出归纳变量
+inline void StrengthReduce::findIVs() {
+    ivs.clear();
+    for(size_t i(0); i < bivs.size(); i++) {
+        Linear l;
+        l.biv = i;
+        l.scale = 1;
+        ivs[bivs[i].val] = l;
+    }
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(BasicBlock* bb : loop->bbs) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted()) continue;
+                const std::type_info& t = typeid(*ir);
+                if(t != typeid(AddIIR) && t != typeid(SubIIR) && t != typeid(MulIIR)) continue;
+                Value* dst = getDefVal(ir);
+                if(!isSingleDef(dst) || ivs.count(dst)) continue;
+                Linear a, b, res;
+                if(!getLinear(ir->getOperands()[1]->getVal(), a) || !getLinear(ir->getOperands()[2]->getVal(), b)) continue;
+                if(a.biv >= 0 && b.biv >= 0 && a.biv != b.biv) continue;
+                res.biv = a.biv >= 0 ? a.biv : b.biv;
+                if(res.biv < 0) continue;
+                if(t == typeid(MulIIR)) {
+                    // 一边是常数
+                    if(b.biv >= 0 || b.off) std::swap(a, b);
+                    if(b.biv >= 0 || b.off || a.off) continue;
+                    res.scale = a.scale * b.oc;
+                    res.oc = a.oc * b.oc;
+                } else {
+                    if(a.off && b.off) continue;
+                    if(t == typeid(SubIIR) && b.off) continue;
+                    int sign = t == typeid(SubIIR) ? -1 : 1;
+                    res.scale = a.scale + sign * b.scale;
+                    res.off = a.off ? a.off : b.off;
+                    res.oc = a.oc + sign * b.oc;
+                }
+                if(!fits(res.scale) || !fits(res.oc) || res.scale == 0) continue;
+                ivs[dst] = res;
+                changed = true;
+            }
+        }
+    }
+}
+
+inline bool StrengthReduce::usedOutside(Value* val) {
+    for(Instruction* user : defUse.users[val->getNum()]) {
+        if(!user->isDeleted() && !loop->contains(defUse.irBB[user])) return true;
+    }
+    return false;
+}
+
+// 把使用 from 的地方改为 to, 含 phi 参数
+inline void StrengthReduce::replaceUses(Value* from, Value* to) {
+    std::vector<Instruction*> fromUsers = defUse.users[from->getNum()];
+    for(Instruction* user : fromUsers) {
+        if(user->isDeleted()) continue;
+        if(typeid(*user) == typeid(PhiIR)) {
+            for(auto& param : dynamic_cast<PhiIR*>(user)->params) {
+                TempVal* t = dynamic_cast<TempVal*>(param.second);
+                if(t && t->getVal() == from) t->setVal(to);
+            }
+        } else {
+            getUseOperands(user, uses);
+            for(Use* use : uses) {
+                if(getUseVal(use) == from) setUseVal(use, to);
+            }
+        }
+        defUse.addUser(to, user);
+    }
+}
+
+// 插到块的跳转之前
+inline void StrengthReduce::emit(BasicBlock* bb, std::vector<Instruction*>& code) {
+    for(auto ir : code) defUse.record(ir, bb);
+    auto& irs = bb->getIr();
+    auto pos = irs.end();
+    if(!irs.empty()) {
+        const std::type_info& t = typeid(*irs.back());
+        if(t == typeid(JumpIR) || t == typeid(BranchIR) || t == typeid(ReturnIR)) pos--;
+    }
+    irs.insert(pos, code.begin(), code.end());
+}
+
+// 在前置块里算 scale * init + off + oc, 返回整数变量; 全为常数时返回 nullptr, 常数在 l.oc 中
+inline Value* StrengthReduce::emitStart(Linear& l, std::vector<Instruction*>& code) {
+    BIV& biv = bivs[l.biv];
+    Value* cur = nullptr;
+    long long oc = l.oc;
+    Type* intType = new Type(TypeID::INT);
+    if(biv.init->getVal()) {
+        cur = biv.init->getVal();
+        if(l.scale != 1) {
+            Value* dst = newVar(intType);
+            code.push_back(new MulIIR(*wrapVal(dst), *wrapVal(cur), intConst(l.scale)));
+            cur = dst;
+        }
+    } else {
+        oc += l.scale * biv.init->getInt();
+    }
+    if(l.off) {
+        if(cur) {
+            Value* dst = newVar(intType);
+            code.push_back(new AddIIR(*wrapVal(dst), *wrapVal(cur), *wrapVal(l.off)));
+            cur = dst;
+        } else {
+            cur = l.off;
+        }
+    }
+    if(cur && oc) {
+        Value* dst = newVar(intType);
+        code.push_back(new AddIIR(*wrapVal(dst), *wrapVal(cur), intConst(oc)));
+        cur = dst;
+        oc = 0;
+    }
+    l.oc = oc;
+    return cur;
+}
+
+// 新建归纳变量 phi: base 为 nullptr 时是整数 scale * i + off + oc, 否则是指针 base + 4 * (...)
+inline Value* StrengthReduce::reduce(Linear& l, Value* base, Type* type) {
+    BasicBlock* preheader = loop->getPreheader();
+    BasicBlock* latch = loop->getLatch();
+    long long delta = l.scale * bivs[l.biv].step;
+    if(!fits(delta) || !fits(l.scale * (long long) bivs[l.biv].init->getInt())) return nullptr;
+    // 指针每轮加的是字节偏移 4 * delta, 后端按立即数生成
+    if(base && !fits(4LL * delta)) return nullptr;
+    std::vector<Instruction*> code;
+    Linear start = l;
+    Value* idx = emitStart(start, code);
+    if(!fits(start.oc)) return nullptr;
+    Value* startVal = newVar(type);
+    if(base) {
+        // 栈上数组的常数下标 GEP 在后端只记栈偏移, 不占寄存器, 不能流入 phi, 下标总是放到变量里
+        if(!idx) {
+            idx = newVar(new Type(TypeID::INT));
+            code.push_back(new MoveIR(idx, new TempVal(intConst(start.oc))));
+        }
+        code.push_back(new GEPIR(startVal, base, idx));
+    } else if(idx) {
+        code.push_back(new MoveIR(startVal, wrapVal(idx)));
+    } else {
+        TempVal* c = new TempVal(intConst(start.oc));
+        code.push_back(new MoveIR(startVal, c));
+    }
+    emit(preheader, code);
+
+    Value* cur = newVar(type);
+    Value* next = newVar(type);
+    PhiIR* phi = new PhiIR({}, cur);
+    phi->params[preheader] = wrapVal(startVal);
+    phi->params[latch] = wrapVal(next);
+    auto& irs = loop->header->getIr();
+    irs.insert(irs.begin(), phi);
+    defUse.record(phi, loop->header);
+
+    Instruction* inc = base ? (Instruction*) new GEPIR(next, cur, (int) delta)
+                            : new AddIIR(*wrapVal(next), *wrapVal(cur), intConst(delta));
+    code.assign(1, inc);
+    emit(latch, code);
+    ivCnt++;
+    return cur;
+}
+
+// 下标为导出归纳变量的 GEP 改为指针归纳变量
+inline void StrengthReduce::reduceGEPs() {
+    for(BasicBlock* bb : loop->bbs) {
+        for(size_t i(0); i < bb->getIr().size(); i++) {
+            Instruction* ir = bb->getIr()[i];
+            if(ir->isDeleted() || typeid(*ir) != typeid(GEPIR)) continue;
+            Value* dst = getDefVal(ir);
+            Value* base = getUseVal(ir->getOperands()[1]);
+            Value* idx = getUseVal(ir->getOperands()[2]);
+            if(!idx || !isSingleDef(dst) || !isInvariant(base) || usedOutside(dst)) continue;
+            auto it = ivs.find(idx);
+            if(it == ivs.end()) continue;
+            Linear l = it->second;
+            auto key = std::make_tuple(l.biv, base, l.scale, l.off, l.oc);
+            auto ptrIt = ptrs.find(key);
+            Value* ptr;
+            if(ptrIt != ptrs.end()) {
+                ptr = ptrIt->second.first;
+            } else {
+                ptr = reduce(l, base, dst->getType());
+                if(!ptr) continue;
+                ptrs[key] = {ptr, bb};
+            }
+            replaceUses(dst, ptr);
+            ir->deleteIR();
+            gepCnt++;
+        }
+    }
+}
+
+// 乘法形式的导出归纳变量改为累加
+inline void StrengthReduce::reduceMuls() {
+    for(BasicBlock* bb : loop->bbs) {
+        for(size_t i(0); i < bb->getIr().size(); i++) {
+            Instruction* ir = bb->getIr()[i];
+            if(ir->isDeleted() || typeid(*ir) != typeid(MulIIR)) continue;
+            Value* dst = getDefVal(ir);
+            auto it = ivs.find(dst);
+            if(it == ivs.end() || usedOutside(dst)) continue;
+            Linear l = it->second;
+            if(l.scale == 1 || l.scale == -1) continue;
+            bool used = false;
+            for(Instruction* user : defUse.users[dst->getNum()]) {
+                used = used || !user->isDeleted();
+            }
+            if(!used) continue;
+            Value* cur = reduce(l, nullptr, dst->getType());
+            if(!cur) continue;
+            replaceUses(dst, cur);
+            ir->deleteIR();
+        }
+    }
+}
+
+// 退出条件 i < n / i <= n 改到指针上
+inline void StrengthReduce::replaceTests() {
+    BasicBlock* header = loop->header;
+    if(loop->exitings.size() != 1 || loop->exitings[0] != header) return;
+    auto& irs = header->getIr();
+    if(irs.empty() || typeid(*irs.back()) != typeid(BranchIR)) return;
+    BranchIR* branchIr = dynamic_cast<BranchIR*>(irs.back());
+    if(loop->contains(branchIr->falseTarget) || !loop->contains(branchIr->trueTarget)) return;
+    Value* cond = getUseVal(branchIr->getOperands()[1]);
+    if(!cond || !isSingleDef(cond) || defUse.defBB[cond->getNum()].second != header) return;
+    Instruction* cmp = nullptr;
+    for(auto ir : irs) {
+        if(!ir->isDeleted() && getDefVal(ir) == cond) cmp = ir;
+    }
+    int liveUsers = 0;
+    for(Instruction* user : defUse.users[cond->getNum()]) liveUsers += !user->isDeleted();
+    if(!cmp || liveUsers != 1) return;
+
+    // 统一成 i < bound
+    const std::type_info& t = typeid(*cmp);
+    TempVal* left = dynamic_cast<TempVal*>(cmp->getOperands()[1]->getVal());
+    TempVal* right = dynamic_cast<TempVal*>(cmp->getOperands()[2]->getVal());
+    Value* ivVal;
+    long long bound;
+    if((t == typeid(LTIIR) || t == typeid(LEIIR)) && left->getVal() && !right->getVal()) {
+        ivVal = left->getVal();
+        bound = right->getInt() + (t == typeid(LEIIR));
+    } else if((t == typeid(GTIIR) || t == typeid(GEIIR)) && right->getVal() && !left->getVal()) {
+        ivVal = right->getVal();
+        bound = left->getInt() + (t == typeid(GEIIR));
+    } else {
+        return;
+    }
+    int b = -1;
+    for(size_t i(0); i < bivs.size(); i++) {
+        if(bivs[i].val == ivVal) b = i;
+    }
+    if(b < 0 || bivs[b].step <= 0 || bivs[b].init->getVal() || bivs[b].init->getInt() >= bound) return;
+    // 找一个每轮都执行的已改写指针, 它的所在块支配回边块
+    for(auto& item : ptrs) {
+        if(std::get<0>(item.first) != b || !item.second.second->dominates(loop->getLatch())) continue;
+        Value* base = std::get<1>(item.first);
+        long long scale = std::get<2>(item.first);
+        Value* off = std::get<3>(item.first);
+        long long endIdx = scale * bound + std::get<4>(item.first);
+        if(!fits(endIdx)) continue;
+        std::vector<Instruction*> code;
+        Value* end = newVar(item.second.first->getType());
+        Value* idx = newVar(new Type(TypeID::INT));
+        if(off) {
+            code.push_back(new AddIIR(*wrapVal(idx), *wrapVal(off), intConst(endIdx)));
+        } else {
+            code.push_back(new MoveIR(idx, new TempVal(intConst(endIdx))));
+        }
+        code.push_back(new GEPIR(end, base, idx));
+        emit(loop->getPreheader(), code);
+
+        TempVal res = *wrapVal(cond);
+        Instruction* newCmp = scale > 0 ? (Instruction*) new LTIIR(res, *wrapVal(item.second.first), *wrapVal(end))
+                                        : new GTIIR(res, *wrapVal(item.second.first), *wrapVal(end));
+        *std::find(irs.begin(), irs.end(), cmp) = newCmp;
+        cmp->deleteIR();
+        defUse.record(newCmp, header);
+        testCnt++;
+        return;
+    }
+}
+
+// 删除改写后没有使用的计算(含前置块里新建的初值); 首块 phi 和回边上的自增只互相使用时一起删除
+inline void StrengthReduce::removeDead() {
+    auto isDead = [&](Value* val, Instruction* except) {
+        for(Instruction* user : defUse.users[val->getNum()]) {
+            if(!user->isDeleted() && user != except) return false;
+        }
+        return true;
+    };
+    auto isPure = [](Instruction* ir) {
+        return dynamic_cast<ArithmeticIR*>(ir) || typeid(*ir) == typeid(GEPIR) || typeid(*ir) == typeid(MoveIR);
+    };
+    std::vector<BasicBlock*> bbs = loop->bbs;
+    bbs.push_back(loop->getPreheader());
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(BasicBlock* bb : bbs) {
+            for(auto ir : bb->getIr()) {
+                if(ir->isDeleted() || !isPure(ir)) continue;
+                Value* dst = getDefVal(ir);
+                if(!isSingleDef(dst) || !isDead(dst, nullptr)) continue;
+                ir->deleteIR();
+                changed = true;
+            }
+        }
+        for(auto ir : loop->header->getIr()) {
+            if(typeid(*ir) != typeid(PhiIR)) break;
+            if(ir->isDeleted()) continue;
+            PhiIR* phi = dynamic_cast<PhiIR*>(ir);
+            Value* val = getDefVal(phi);
+            auto it = phi->params.find(loop->getLatch());
+            TempVal* next = it == phi->params.end() ? nullptr : dynamic_cast<TempVal*>(it->second);
+            if(!isSingleDef(val) || !next || !isSingleDef(next->getVal())) continue;
+            Instruction* inc = nullptr;
+            for(Instruction* user : defUse.users[val->getNum()]) {
+                if(!user->isDeleted() && user != phi && getDefVal(user) == next->getVal()) inc = user;
+            }
+            if(!inc || !isPure(inc) || !isDead(val, inc) || !isDead(next->getVal(), phi)) continue;
+            phi->deleteIR();
+            inc->deleteIR();
+            changed = true;
+        }
+    }
+}
+
+#endif //SYSY2022_BJTU_STRENGTHREDUCE_HH
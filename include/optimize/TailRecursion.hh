@@ -0,0 +1,200 @@
+//
+// Created by agent on 26-10-19.
+//
+
+#ifndef SYSY2022_BJTU_TAILRECURSION_HH
+#define SYSY2022_BJTU_TAILRECURSION_HH
+
+#include "IrVisitor.hh"
+#include "Instruction.hh"
+#include "DominateTree.hh"
+#include "IRHelper.hh"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// 尾递归消除, 在 Mem2reg 之后的 SSA 上做
+// 尾调用: 块末尾为 t = call f(...); ret t (void 函数为 call f(...); ret)
+// 累加形式: t = call f(...); r = t op c; ret r, op 为整数加或乘, 所有这种调用点的 op 相同
+// 新建入口块跳到原入口, 原入口为每个形参(和累加值)加 phi, 尾调用改为把实参传给 phi 并跳回原入口;
+// 有累加值时其余的 ret x 改为 ret acc op x
+// 有局部数组的函数不处理, 实参可能指向本帧的数组, 复用帧后会被覆盖
+class TailRecursion {
+private:
+    struct Site {
+        BasicBlock* bb;
+        CallIR* call;
+        Instruction* acc;
+        TempVal* c;
+        Instruction* ret;
+    };
+
+    IrVisitor* irVisitor;
+    Function* function;
+    DominateTree dominateTree;
+    std::vector<Site> sites;
+    const std::type_info* accOp;
+
+    int callCnt = 0;
+    int funcCnt = 0;
+
+    bool findSites();
+    void transform();
+public:
+    TailRecursion(IrVisitor* irVisitor) : irVisitor(irVisitor), dominateTree(irVisitor) {;}
+    void execute();
+    int getCallCnt() { return callCnt; }
+    int getFuncCnt() { return funcCnt; }
+};
+
+inline void TailRecursion::execute() {
+    for(Function* func : irVisitor->getFunctions()) {
+        if(func->getBB().empty()) continue;
+        this->function = func;
+        if(!findSites()) continue;
+        transform();
+        callCnt += sites.size();
+        funcCnt++;
+        func->renumberBB();
+        dominateTree.getIdom(func);
+        dominateTree.getDomFront(func);
+        dominateTree.genDominateTree(func);
+    }
+}
+
+inline bool TailRecursion::findSites() {
+    sites.clear();
+    accOp = nullptr;
+    for(BasicBlock* bb : function->getBB()) {
+        std::vector<Instruction*> live;
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(dynamic_cast<AllocIR*>(ir)) return false;
+            live.push_back(ir);
+        }
+        size_t n = live.size();
+        if(n < 2 || typeid(*live[n - 1]) != typeid(ReturnIR)) continue;
+        ReturnIR* ret = dynamic_cast<ReturnIR*>(live[n - 1]);
+        Value* r = getUseVal(ret->getOperands()[1]);
+        bool isVoid = !r && !ret->useInt && !ret->useFloat;
+        auto selfCall = [&](Instruction* ir) {
+            return typeid(*ir) == typeid(CallIR) && dynamic_cast<CallIR*>(ir)->func == function;
+        };
+        if(selfCall(live[n - 2]) && (isVoid ? !getDefVal(live[n - 2]) : r && getDefVal(live[n - 2]) == r)) {
+            sites.push_back({bb, dynamic_cast<CallIR*>(live[n - 2]), nullptr, nullptr, ret});
+            continue;
+        }
+        // t = call; r = t op c; ret r
+        if(n < 3 || !r || !selfCall(live[n - 3]) || getDefVal(live[n - 2]) != r) continue;
+        const std::type_info& t = typeid(*live[n - 2]);
+        if(t != typeid(AddIIR) && t != typeid(MulIIR)) continue;
+        if(accOp && *accOp != t) return false;
+        Value* callVal = getDefVal(live[n - 3]);
+        TempVal* left = dynamic_cast<TempVal*>(live[n - 2]->getOperands()[1]->getVal());
+        TempVal* right = dynamic_cast<TempVal*>(live[n - 2]->getOperands()[2]->getVal());
+        TempVal* c = left->getVal() == callVal ? right : right->getVal() == callVal ? left : nullptr;
+        if(!callVal || !c || c->getVal() == callVal) continue;
+        accOp = &t;
+        sites.push_back({bb, dynamic_cast<CallIR*>(live[n - 3]), live[n - 2], c, ret});
+    }
+    return !sites.empty() && (!accOp || function->return_type->isInt());
+}
+
+inline void TailRecursion::transform() {
+    auto& bbs = function->getBB();
+    BasicBlock* header = bbs[0];
+    BasicBlock* entry = new NormalBlock(nullptr, function->name, function->bbCnt++);
+    entry->getIr().push_back(new JumpIR(header));
+    bbs.insert(bbs.begin(), entry);
+    std::vector<BasicBlock*> preBBs = header->getPre();
+    entry->addSucc(header);
+
+    // 形参的使用换成 phi
+    std::unordered_map<Value*, Value*> valMap;
+    std::vector<PhiIR*> phis;
+    for(Value* param : function->params) {
+        Value* dst = cloneVar(param, function);
+        valMap[param] = dst;
+        PhiIR* phi = new PhiIR({}, dst);
+        phi->params[entry] = wrapVal(param);
+        phis.push_back(phi);
+    }
+    std::vector<Use*> uses;
+    for(BasicBlock* bb : bbs) {
+        for(auto ir : bb->getIr()) {
+            if(ir->isDeleted()) continue;
+            if(typeid(*ir) == typeid(PhiIR)) {
+                for(auto& param : dynamic_cast<PhiIR*>(ir)->params) {
+                    TempVal* t = dynamic_cast<TempVal*>(param.second);
+                    if(t && t->getVal() && valMap.count(t->getVal())) t->setVal(valMap[t->getVal()]);
+                }
+                continue;
+            }
+            getUseOperands(ir, uses);
+            for(Use* use : uses) {
+                Value* val = getUseVal(use);
+                if(val && valMap.count(val)) setUseVal(use, valMap[val]);
+            }
+        }
+    }
+    Value* acc = nullptr;
+    if(accOp) {
+        acc = new VarValue("", function->return_type, false, function->varCnt++);
+        PhiIR* phi = new PhiIR({}, acc);
+        TempVal* identity = new TempVal();
+        identity->setType(new Type(TypeID::INT));
+        identity->setInt(*accOp == typeid(AddIIR) ? 0 : 1);
+        phi->params[entry] = identity;
+        phis.push_back(phi);
+    }
+    // 原入口已有的前驱(回到入口的循环)上 phi 取自身
+    for(BasicBlock* preBB : preBBs) {
+        for(PhiIR* phi : phis) {
+            phi->params[preBB] = wrapVal(getDefVal(phi));
+        }
+    }
+    header->getIr().insert(header->getIr().begin(), phis.begin(), phis.end());
+
+    // 累加时其余返回改为 ret acc op x
+    if(accOp) {
+        for(BasicBlock* bb : bbs) {
+            auto& irs = bb->getIr();
+            if(irs.empty() || irs.back()->isDeleted() || typeid(*irs.back()) != typeid(ReturnIR)) continue;
+            if(std::any_of(sites.begin(), sites.end(), [&](Site& site) { return site.ret == irs.back(); })) continue;
+            ReturnIR* ret = dynamic_cast<ReturnIR*>(irs.back());
+            Value* v = getUseVal(ret->getOperands()[1]);
+            TempVal* x = v ? wrapVal(v) : new TempVal();
+            if(!v) {
+                x->setType(new Type(TypeID::INT));
+                x->setInt(ret->useInt ? ret->retInt : (int) ret->retFloat);
+            }
+            Value* res = new VarValue("", function->return_type, false, function->varCnt++);
+            irs.back() = newArithmetic(*accOp, *wrapVal(res), *wrapVal(acc), *x);
+            irs.push_back(new ReturnIR(res));
+        }
+    }
+
+    // 尾调用改为传参并跳回原入口
+    for(Site& site : sites) {
+        auto& irs = site.bb->getIr();
+        auto& operands = site.call->getOperands();
+        for(size_t i(0); i < function->params.size(); i++) {
+            phis[i]->params[site.bb] = new TempVal(*dynamic_cast<TempVal*>(operands[i + 1]->getVal()));
+        }
+        irs.erase(std::remove_if(irs.begin(), irs.end(), [&](Instruction* ir) {
+            return ir == site.call || ir == site.acc || ir == site.ret;
+        }), irs.end());
+        if(accOp) {
+            Value* next = acc;
+            if(site.acc) {
+                next = new VarValue("", function->return_type, false, function->varCnt++);
+                irs.push_back(newArithmetic(*accOp, *wrapVal(next), *wrapVal(acc), *site.c));
+            }
+            phis.back()->params[site.bb] = wrapVal(next);
+        }
+        irs.push_back(new JumpIR(header));
+        site.bb->addSucc(header);
+    }
+}
+
+#endif //SYSY2022_BJTU_TAILRECURSION_HH
@@ -7,8 +7,29 @@
 #include "codegen.hh"
 #include "DominateTree.hh"
 #include "Mem2reg.hh"
+#include "TailRecursion.hh"
+#include "Memoize.hh"
+#include "Inliner.hh"
+#include "SCCP.hh"
+#include "InstCombine.hh"
+#include "GVN.hh"
+#include "ScalarReplace.hh"
+#include "LoadElimination.hh"
+#include "DSE.hh"
+#include "PRE.hh"
+#include "ADCE.hh"
+#include "LoopSimplify.hh"
+#include "ScalarPromotion.hh"
+#include "LICM.hh"
+#include "RangeOptimize.hh"
+#include "LoopUnroll.hh"
+#include "StrengthReduce.hh"
+#include "OutOfSSA.hh"
 #include "OptimizeAdaptor.hh"
+#include "IRSerializer.hh"
 #include <sys/resource.h>
+#include <chrono>
+#include <cstdlib>
 
 driver ddriver;
 CompUnit *root;
@@ -32,6 +53,13 @@ int main(int argc, char *argv[]) {
     bool printAST = false;
     bool printIR = false;
     bool optimize_O2 = false;
+    bool printStats = false;
+    bool unrollLoops = false;
+    bool memoize = false;
+    int unrollFactor = 4;
+    int inlineGrowth = 1000;
+    std::string irBinOutput;
+    std::string irBinInput;
      for (int i = 1; i < argc; i++) {
          if (std::string(argv[i]) == "-o") {
              outputFileName = argv[i + 1];
@@ -42,33 +70,333 @@ int main(int argc, char *argv[]) {
              printAST = true;
          } else if (std::string(argv[i]) == "-O2") {
              optimize_O2 = true;
+         } else if (std::string(argv[i]) == "-stats") {
+             printStats = true;
+         } else if (std::string(argv[i]) == "-funroll-loops") {
+             unrollLoops = true;
+         } else if (std::string(argv[i]) == "-fmemoize") {
+             memoize = true;
+         } else if (std::string(argv[i]).rfind("-funroll-factor=", 0) == 0) {
+             unrollFactor = std::atoi(argv[i] + std::string("-funroll-factor=").size());
+         } else if (std::string(argv[i]).rfind("-finline-growth=", 0) == 0) {
+             inlineGrowth = std::atoi(argv[i] + std::string("-finline-growth=").size());
+         } else if (std::string(argv[i]) == "-emit-ir-bin") {
+             irBinOutput = argv[i + 1];
+             i++;
+         } else if (std::string(argv[i]) == "-from-ir-bin") {
+             irBinInput = argv[i + 1];
+             i++;
          } else {
              inputFileName = argv[i];
          }
      }
 
-    root = ddriver.parse(inputFileName);
-    if (printAST) {
-        root->visit(0);
-    }
+    using Clock = std::chrono::steady_clock;
+    auto elapsedMs = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
     IrVisitor irVisitor;
-    try {
-        irVisitor.visit(root);
-    } catch (SyntaxError &e) {
-        std::cerr << "error: " << e.what() << "\n";
-        return EXIT_FAILURE;
+    uint32_t irBinFlags = 0;
+    if (!irBinInput.empty()) {
+        auto start = Clock::now();
+        std::ifstream in(irBinInput, std::ios::binary);
+        if (!in) {
+            std::cerr << "error: cannot open " << irBinInput << "\n";
+            return EXIT_FAILURE;
+        }
+        IRSerializer serializer(irVisitor);
+        try {
+            irBinFlags = serializer.read(in);
+        } catch (IRFormatError &e) {
+            std::cerr << "error: " << irBinInput << ": " << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+        if (printStats) {
+            double ms = elapsedMs(start);
+            std::cerr << "stats: ir-bin load " << serializer.getByteSize() << " bytes, "
+                      << serializer.getIrCnt() << " ir in " << ms << " ms ("
+                      << serializer.getByteSize() / 1048.576 / ms << " MB/s)\n";
+        }
+    } else {
+        auto start = Clock::now();
+        root = ddriver.parse(inputFileName);
+        if (printAST) {
+            root->visit(0);
+        }
+        try {
+            irVisitor.visit(root);
+        } catch (SyntaxError &e) {
+            std::cerr << "error: " << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+        MIRBuilder mirBuilder(irVisitor);
+        mirBuilder.getPreAndSucc();
+        if (printStats) {
+            std::cerr << "stats: frontend (parse + IrVisitor + MIRBuilder) " << elapsedMs(start) << " ms\n";
+        }
     }
-    MIRBuilder mirBuilder(irVisitor);
-    mirBuilder.getPreAndSucc();
-    if (false) {
-        DominateTree dominateTree(&irVisitor);
-        dominateTree.execute();
+    if (!(irBinFlags & IRSerializer::OPTIMIZED)) {
+        if (optimize_O2) {
+            DominateTree dominateTree(&irVisitor);
+            dominateTree.execute();
+
+            auto start = Clock::now();
+            Mem2reg mem2reg(&irVisitor);
+            mem2reg.execute();
+            if (printStats) {
+                std::cerr << "stats: mem2reg " << mem2reg.getPromotedCnt() << " promoted, "
+                          << mem2reg.getPhiCnt() << " phi in " << elapsedMs(start) << " ms\n";
+            }
+
+            if (memoize) {
+                // ahead of tail recursion, which would loop one of the two calls in fib-like functions
+                start = Clock::now();
+                Memoize memo(&irVisitor);
+                memo.execute();
+                if (printStats) {
+                    std::cerr << "stats: memoize " << memo.getFuncCnt() << " of " << memo.getPureCnt()
+                              << " pure functions in " << elapsedMs(start) << " ms\n";
+                }
+            }
+
+            start = Clock::now();
+            TailRecursion tailRecursion(&irVisitor);
+            tailRecursion.execute();
+            if (printStats) {
+                std::cerr << "stats: tail-recursion " << tailRecursion.getCallCnt() << " calls in "
+                          << tailRecursion.getFuncCnt() << " functions in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            Inliner inliner(&irVisitor, inlineGrowth);
+            inliner.execute();
+            if (printStats) {
+                std::cerr << "stats: inline " << inliner.getInlinedCnt() << " calls into "
+                          << inliner.getCallerCnt() << " functions in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            SCCP sccp(&irVisitor);
+            sccp.execute();
+            if (printStats) {
+                std::cerr << "stats: sccp " << sccp.getFoldedCnt() << " folded, " << sccp.getBranchCnt()
+                          << " branches, " << sccp.getRemovedBBCnt() << " blocks removed in "
+                          << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            InstCombine instCombine(&irVisitor);
+            instCombine.execute();
+            if (printStats) {
+                std::cerr << "stats: instcombine";
+                instCombine.printHits(std::cerr);
+                std::cerr << " in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            GVN gvn(&irVisitor);
+            gvn.execute();
+            if (printStats) {
+                std::cerr << "stats: gvn " << gvn.getRemovedCnt() << " removed in " << elapsedMs(start) << " ms\n";
+            }
+
+            // small local arrays indexed by constants become scalars, promoted by a second mem2reg
+            start = Clock::now();
+            ScalarReplace scalarReplace(&irVisitor);
+            scalarReplace.execute();
+            if (scalarReplace.getArrayCnt() > 0) {
+                dominateTree.execute();
+                Mem2reg mem2reg(&irVisitor);
+                mem2reg.execute();
+                SCCP sccp(&irVisitor);
+                sccp.execute();
+            }
+            if (printStats) {
+                std::cerr << "stats: scalar-replace " << scalarReplace.getArrayCnt() << " arrays, "
+                          << scalarReplace.getElemCnt() << " elements in " << elapsedMs(start) << " ms\n";
+            }
 
-        Mem2reg mem2reg(&irVisitor);
-        mem2reg.execute();
+            start = Clock::now();
+            LoadElimination loadElimination(&irVisitor);
+            loadElimination.execute();
+            if (printStats) {
+                std::cerr << "stats: load-elim " << loadElimination.getForwardedCnt() << " forwarded, "
+                          << loadElimination.getRemovedCnt() << " removed in " << elapsedMs(start) << " ms\n";
+            }
 
-        optimizeAdaptor(&irVisitor);
-        moveBackOperand(&irVisitor);
+            start = Clock::now();
+            DSE dse(&irVisitor);
+            dse.execute();
+            if (printStats) {
+                std::cerr << "stats: dse " << dse.getRemovedCnt() << " stores removed, " << dse.getShrunkCnt()
+                          << " memsets shrunk, " << dse.getDroppedCnt() << " dropped in " << elapsedMs(start) << " ms\n";
+            }
+
+            // partially redundant expressions, the dead trees left behind go away in ADCE
+            start = Clock::now();
+            PRE pre(&irVisitor);
+            pre.execute();
+            if (printStats) {
+                std::cerr << "stats: pre " << pre.getExprCnt() << " expressions, " << pre.getInsertedCnt()
+                          << " inserted, " << pre.getRemovedCnt() << " removed in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            ADCE adce(&irVisitor);
+            adce.execute();
+            if (printStats) {
+                std::cerr << "stats: adce " << adce.getRemovedCnt() << " removed, " << adce.getBranchCnt()
+                          << " branches, " << adce.getRemovedBBCnt() << " blocks removed in "
+                          << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            LoopSimplify loopSimplify(&irVisitor);
+            loopSimplify.execute();
+            if (printStats) {
+                std::cerr << "stats: loop-simplify " << loopSimplify.getLoopCnt() << " loops, "
+                          << loopSimplify.getPreheaderCnt() << " preheaders, " << loopSimplify.getLatchCnt()
+                          << " latches inserted in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            ScalarPromotion scalarPromotion(&irVisitor);
+            scalarPromotion.execute();
+            if (printStats) {
+                std::cerr << "stats: scalar-promotion " << scalarPromotion.getPromotedCnt() << " promoted, "
+                          << scalarPromotion.getLoadCnt() << " loads, " << scalarPromotion.getStoreCnt()
+                          << " stores removed in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            LICM licm(&irVisitor);
+            licm.execute();
+            if (printStats) {
+                std::cerr << "stats: licm " << licm.getHoistedCnt() << " hoisted, " << licm.getSunkCnt()
+                          << " sunk in " << elapsedMs(start) << " ms\n";
+            }
+
+            // promoted globals are written back at loop exits and often reloaded right after
+            start = Clock::now();
+            LoadElimination postLoopLoadElimination(&irVisitor);
+            postLoopLoadElimination.execute();
+            if (printStats) {
+                std::cerr << "stats: post-loop load-elim " << postLoopLoadElimination.getForwardedCnt() << " forwarded, "
+                          << postLoopLoadElimination.getRemovedCnt() << " removed in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            RangeOptimize rangeOptimize(&irVisitor);
+            rangeOptimize.execute();
+            if (printStats) {
+                std::cerr << "stats: range " << rangeOptimize.getFoldedCnt() << " folded, "
+                          << rangeOptimize.getMarkedCnt() << " div/mod non-negative in " << elapsedMs(start) << " ms\n";
+            }
+            if (rangeOptimize.getFoldedCnt() > 0) {
+                // fold the branches on decided compares and restore the loop form
+                start = Clock::now();
+                SCCP sccp(&irVisitor);
+                sccp.execute();
+                ADCE adce(&irVisitor);
+                adce.execute();
+                LoopSimplify loopSimplify(&irVisitor);
+                loopSimplify.execute();
+                if (printStats) {
+                    std::cerr << "stats: post-range cleanup " << sccp.getBranchCnt() << " branches, "
+                              << adce.getRemovedCnt() << " removed in " << elapsedMs(start) << " ms\n";
+                }
+            }
+
+            start = Clock::now();
+            LoopUnroll loopUnroll(&irVisitor, unrollLoops, unrollFactor);
+            loopUnroll.execute();
+            if (printStats) {
+                std::cerr << "stats: loop-unroll " << loopUnroll.getFullCnt() << " full, "
+                          << loopUnroll.getPartialCnt() << " partial in " << elapsedMs(start) << " ms\n";
+            }
+            if (loopUnroll.getFullCnt() + loopUnroll.getPartialCnt() > 0) {
+                // fold the unrolled copies and put the new loops back into canonical form
+                start = Clock::now();
+                SCCP sccp(&irVisitor);
+                sccp.execute();
+                GVN gvn(&irVisitor);
+                gvn.execute();
+                ADCE adce(&irVisitor);
+                adce.execute();
+                LoopSimplify loopSimplify(&irVisitor);
+                loopSimplify.execute();
+                if (printStats) {
+                    std::cerr << "stats: post-unroll cleanup " << sccp.getFoldedCnt() << " folded, "
+                              << gvn.getRemovedCnt() << " merged, " << adce.getRemovedCnt() << " removed in "
+                              << elapsedMs(start) << " ms\n";
+                }
+            }
+
+            if (loopUnroll.getFullCnt() > 0) {
+                // fully unrolled loops leave constant indices into small local arrays
+                start = Clock::now();
+                ScalarReplace scalarReplace(&irVisitor);
+                scalarReplace.execute();
+                if (scalarReplace.getArrayCnt() > 0) {
+                    dominateTree.execute();
+                    Mem2reg mem2reg(&irVisitor);
+                    mem2reg.execute();
+                    SCCP sccp(&irVisitor);
+                    sccp.execute();
+                    ADCE adce(&irVisitor);
+                    adce.execute();
+                    LoopSimplify loopSimplify(&irVisitor);
+                    loopSimplify.execute();
+                }
+                if (printStats) {
+                    std::cerr << "stats: post-unroll scalar-replace " << scalarReplace.getArrayCnt() << " arrays, "
+                              << scalarReplace.getElemCnt() << " elements in " << elapsedMs(start) << " ms\n";
+                }
+            }
+
+            start = Clock::now();
+            StrengthReduce strengthReduce(&irVisitor);
+            strengthReduce.execute();
+            if (printStats) {
+                std::cerr << "stats: strength-reduce " << strengthReduce.getIVCnt() << " ivs, "
+                          << strengthReduce.getGEPCnt() << " geps, " << strengthReduce.getTestCnt()
+                          << " tests replaced in " << elapsedMs(start) << " ms\n";
+            }
+
+            // clean up after loop optimizations and turn multiplies by powers of two into shifts
+            start = Clock::now();
+            InstCombine lateInstCombine(&irVisitor, true);
+            lateInstCombine.execute();
+            if (printStats) {
+                std::cerr << "stats: late instcombine";
+                lateInstCombine.printHits(std::cerr);
+                std::cerr << " in " << elapsedMs(start) << " ms\n";
+            }
+
+            start = Clock::now();
+            OutOfSSA outOfSSA(&irVisitor);
+            outOfSSA.execute();
+            if (printStats) {
+                std::cerr << "stats: out-of-ssa " << outOfSSA.getSplitCnt() << " edges split, "
+                          << outOfSSA.getCopyCnt() << " copies, " << outOfSSA.getTempCnt() << " temps in "
+                          << elapsedMs(start) << " ms\n";
+            }
+
+            optimizeAdaptor(&irVisitor);
+            moveBackOperand(&irVisitor);
+        }
+    }
+    if (!irBinOutput.empty()) {
+        auto start = Clock::now();
+        std::ofstream irOut(irBinOutput, std::ios::binary);
+        IRSerializer serializer(irVisitor);
+        serializer.write(irOut, optimize_O2 ? IRSerializer::OPTIMIZED : 0);
+        if (printStats) {
+            double ms = elapsedMs(start);
+            std::cerr << "stats: ir-bin store " << serializer.getByteSize() << " bytes, "
+                      << serializer.getIrCnt() << " ir, " << serializer.getValueCnt() << " values in "
+                      << ms << " ms (" << serializer.getByteSize() / 1048.576 / ms << " MB/s)\n";
+        }
     }
 
     if (printIR) {
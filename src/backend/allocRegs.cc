@@ -60,48 +60,52 @@ int ColoringAlloc::run() {
 void ColoringAlloc::liveAnalysis() {
     std::deque<std::pair<BasicBlock *, GR>> updateI;
     std::deque<std::pair<BasicBlock *, FR>> updateF;
+    function->renumberBB();
+    size_t bbCnt = function->basicBlocks.size();
+    for (auto *sets: {&liveInI, &liveOutI, &defI, &useI}) sets->resize(bbCnt);
+    for (auto *sets: {&liveInF, &liveOutF, &defF, &useF}) sets->resize(bbCnt);
     for (auto block: function->basicBlocks) {
         for (int i = block->getInstrs().size() - 1; i >= 0; i--) {
             Instr *ir = block->getInstrs()[i];
             for (GR gr: ir->getDefG()) {
-                useI[block].erase(gr);
-                defI[block].insert(gr);
+                useI[block->getId()].erase(gr);
+                defI[block->getId()].insert(gr);
                 grs.insert(gr);
             }
             for (GR gr: ir->getUseG()) {
-                defI[block].erase(gr);
-                useI[block].insert(gr);
+                defI[block->getId()].erase(gr);
+                useI[block->getId()].insert(gr);
                 grs.insert(gr);
             }
             for (FR fr: ir->getDefF()) {
-                useF[block].erase(fr);
-                defF[block].insert(fr);
+                useF[block->getId()].erase(fr);
+                defF[block->getId()].insert(fr);
                 frs.insert(fr);
             }
             for (FR fr: ir->getUseF()) {
-                defF[block].erase(fr);
-                useF[block].insert(fr);
+                defF[block->getId()].erase(fr);
+                useF[block->getId()].insert(fr);
                 frs.insert(fr);
             }
         }
-        liveInI = useI;
-        liveInF = useF;
-        for (GR gr: useI[block]) {
+        for (GR gr: useI[block->getId()]) {
             updateI.emplace_back(block, gr);
         }
-        for (FR fr: useF[block]) {
+        for (FR fr: useF[block->getId()]) {
             updateF.emplace_back(block, fr);
         }
     }
+    liveInI = useI;
+    liveInF = useF;
     while (!updateI.empty()) {
         std::pair<BasicBlock *, GR> cur = updateI.front();
         updateI.pop_front();
         for (BasicBlock *prev: cur.first->getPre()) {
-            if (liveOutI[prev].find(cur.second) == liveOutI[prev].end()) {
-                liveOutI[prev].insert(cur.second);
-                if (defI[prev].find(cur.second) == defI[prev].end() &&
-                    liveInI[prev].find(cur.second) == liveInI[prev].end()) {
-                    liveInI[prev].insert(cur.second);
+            if (liveOutI[prev->getId()].find(cur.second) == liveOutI[prev->getId()].end()) {
+                liveOutI[prev->getId()].insert(cur.second);
+                if (defI[prev->getId()].find(cur.second) == defI[prev->getId()].end() &&
+                    liveInI[prev->getId()].find(cur.second) == liveInI[prev->getId()].end()) {
+                    liveInI[prev->getId()].insert(cur.second);
                     updateI.emplace_back(prev, cur.second);
                 }
             }
@@ -111,11 +115,11 @@ void ColoringAlloc::liveAnalysis() {
         std::pair<BasicBlock *, FR> cur = updateF.front();
         updateF.pop_front();
         for (BasicBlock *prev: cur.first->getPre()) {
-            if (liveOutF[prev].find(cur.second) == liveOutF[prev].end()) {
-                liveOutF[prev].insert(cur.second);
-                if (defF[prev].find(cur.second) == defF[prev].end() &&
-                    liveInF[prev].find(cur.second) == liveInF[prev].end()) {
-                    liveInF[prev].insert(cur.second);
+            if (liveOutF[prev->getId()].find(cur.second) == liveOutF[prev->getId()].end()) {
+                liveOutF[prev->getId()].insert(cur.second);
+                if (defF[prev->getId()].find(cur.second) == defF[prev->getId()].end() &&
+                    liveInF[prev->getId()].find(cur.second) == liveInF[prev->getId()].end()) {
+                    liveInF[prev->getId()].insert(cur.second);
                     updateF.emplace_back(prev, cur.second);
                 }
             }
@@ -125,8 +129,8 @@ void ColoringAlloc::liveAnalysis() {
 
 void ColoringAlloc::build() {
     for (BasicBlock *block: function->basicBlocks) {
-        std::set<GR> liveGR = liveOutI[block];
-        std::set<FR> liveFR = liveOutF[block];
+        std::set<GR> liveGR = liveOutI[block->getId()];
+        std::set<FR> liveFR = liveOutF[block->getId()];
         for (int i = block->getInstrs().size() - 1; i >= 0; i--) {
             Instr *instr = block->getInstrs()[i];
             if (typeid(*instr) == typeid(MoveReg)) {
@@ -253,17 +257,17 @@ void ColoringAlloc::makeWorkList() {
 }
 
 bool ColoringAlloc::moveRelatedGR(GR gr) {
-    std::set<Instr *> temp = nodeMovesGR(gr);
+    std::set<Instr *, InstrLess> temp = nodeMovesGR(gr);
     return temp.size() > 0;
 }
 
 bool ColoringAlloc::moveRelatedFR(FR fr) {
-    std::set<Instr *> temp = nodeMovesFR(fr);
+    std::set<Instr *, InstrLess> temp = nodeMovesFR(fr);
     return temp.size() > 0;
 }
 
-std::set<Instr *> ColoringAlloc::nodeMovesGR(GR gr) {
-    std::set<Instr *> ans = moveListGR[gr];
+std::set<Instr *, InstrLess> ColoringAlloc::nodeMovesGR(GR gr) {
+    std::set<Instr *, InstrLess> ans = moveListGR[gr];
     for (auto it = ans.begin(); it != ans.end();) {
         Instr *instr = *it;
         if (activeMovesGR.count(instr) == 0 &&
@@ -276,8 +280,8 @@ std::set<Instr *> ColoringAlloc::nodeMovesGR(GR gr) {
     return ans;
 }
 
-std::set<Instr *> ColoringAlloc::nodeMovesFR(FR fr) {
-    std::set<Instr *> ans = moveListFR[fr];
+std::set<Instr *, InstrLess> ColoringAlloc::nodeMovesFR(FR fr) {
+    std::set<Instr *, InstrLess> ans = moveListFR[fr];
     for (auto it = ans.begin(); it != ans.end();) {
         Instr *instr = *it;
         if (activeMovesFR.count(instr) == 0 &&
@@ -645,7 +649,15 @@ void ColoringAlloc::freezeMovesFR(FR u) {
 }
 
 void ColoringAlloc::selectSpillGR() {
+    // prefer the node with the highest degree that is not a spill temp
     GR m = *spillWorkListGR.begin();
+    int best = -1;
+    for (GR gr: spillWorkListGR) {
+        if (spillTempsGR.count(gr) == 0 && degreeGR[gr] > best) {
+            m = gr;
+            best = degreeGR[gr];
+        }
+    }
     spillWorkListGR.erase(m);
     simplifyWorkListGR.insert(m);
     freezeMovesGR(m);
@@ -653,6 +665,13 @@ void ColoringAlloc::selectSpillGR() {
 
 void ColoringAlloc::selectSpillFR() {
     FR m = *spillWorkListFR.begin();
+    int best = -1;
+    for (FR fr: spillWorkListFR) {
+        if (spillTempsFR.count(fr) == 0 && degreeFR[fr] > best) {
+            m = fr;
+            best = degreeFR[fr];
+        }
+    }
     spillWorkListFR.erase(m);
     simplifyWorkListFR.insert(m);
     freezeMovesFR(m);
@@ -672,6 +691,27 @@ void ColoringAlloc::assignColorsGR() {
                 okColorsGR.erase(colorGR[ww]);
             }
         }
+        if (okColorsGR.empty() && spillTempsGR.count(n) != 0) {
+            // spilling a spill temp again never converges, spill a long-lived neighbor
+            // whose color no other neighbor uses instead
+            std::map<int, int> colorUse;
+            for (GR w: adjListGR[n]) {
+                GR ww = getAliasGR(w);
+                if (coloredNodesGR.count(ww) != 0 || preColoredGR.count(ww) != 0) {
+                    colorUse[colorGR[ww]]++;
+                }
+            }
+            for (GR w: adjListGR[n]) {
+                GR ww = getAliasGR(w);
+                if (coloredNodesGR.count(ww) != 0 && preColoredGR.count(ww) == 0 && spillTempsGR.count(ww) == 0 &&
+                    colorUse[colorGR[ww]] == 1) {
+                    coloredNodesGR.erase(ww);
+                    spillWorkListGR.insert(ww);
+                    okColorsGR.insert(colorGR[ww]);
+                    break;
+                }
+            }
+        }
         if (okColorsGR.empty()) {
             spillWorkListGR.insert(n);
         } else {
@@ -726,10 +766,13 @@ void ColoringAlloc::rewriteProgramGR() {
         for (auto it = block->getInstrs().begin();it != block->getInstrs().end();it++) {
             Instr* instr = *it;
             int new_load_cnt = 0;
+            // a register both read and written by one instruction keeps the reloaded temp
+            std::map<GR, GR> loaded;
             for (GR gr:instr->getUseG()) {
-                if (spillWorkListGR.count(gr) != 0) {
+                if (spillWorkListGR.count(gr) != 0 && loaded.count(gr) == 0) {
                     GR new_gr = GR::allocateReg();
                     newTemps.insert(new_gr);
+                    loaded[gr] = new_gr;
                     it = block->getInstrs().insert(it, new Load(new_gr, GR(13), spillMappingGR[gr]));
                     instr->setNewGR(gr, new_gr,true);
                     new_load_cnt++;
@@ -740,7 +783,7 @@ void ColoringAlloc::rewriteProgramGR() {
             int new_store_cnt = 0;
             for (GR gr:instr->getDefG()) {
                 if (spillWorkListGR.count(gr) != 0) {
-                    GR new_gr = GR::allocateReg();
+                    GR new_gr = loaded.count(gr) != 0 ? loaded[gr] : GR::allocateReg();
                     newTemps.insert(new_gr);
                     it = block->getInstrs().insert(it+1, new Store(new_gr, GR(13), spillMappingGR[gr]));
                     instr->setNewGR(gr, new_gr, false);
@@ -765,6 +808,7 @@ void ColoringAlloc::rewriteProgramGR() {
 //            }
 //        }
 //    }
+    spillTempsGR.insert(newTemps.begin(), newTemps.end());
 //    std::cerr << "new load: " << load << "\n";
 //    std::cerr << "new store " << store << "\n";
 //    std::cerr << "exit rewrite\n";
@@ -858,6 +902,7 @@ void ColoringAlloc::rewriteProgramFR() {
     for (FR fr:newTemps) {
         frs.insert(fr);
     }
+    spillTempsFR.insert(newTemps.begin(), newTemps.end());
     frs.clear();
     frIG.clear();
     liveInF.clear();
@@ -75,14 +75,91 @@ uint32_t floatToInt(float value) {
     return data.intVal;
 }
 GR Codegen::getConstantGR(int x, BasicBlock* block, std::vector<Instr*>& vec) {
-    if (!constantIntMapping[block].count(x)) {
+    if (!constantIntMapping[block->getId()].count(x)) {
         GR gr = GR::allocateReg();
         for (Instr *instr: setIntValue(gr, x)) {
             vec.push_back(instr);
         }
-        constantIntMapping[block][x] = gr;
+        constantIntMapping[block->getId()][x] = gr;
+    }
+    return constantIntMapping[block->getId()][x];
+}
+
+// Granlund-Montgomery / Hacker's Delight magic number for signed division by d >= 2:
+// n / d == (hi32(n * magic) [+ n]) >> shift, plus one when n is negative
+void Codegen::signedMagic(int d, int& magic, int& shift) {
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = d;
+    uint32_t anc = two31 - 1 - two31 % ad;
+    int p = 31;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    magic = static_cast<int>(q2 + 1);
+    shift = p - 32;
+}
+
+// nonNegative: src is known to be >= 0, so the rounding fix-ups for negative dividends are dropped
+void Codegen::divByConst(GR dst, GR src, int d, BasicBlock* block, std::vector<Instr*>& vec, bool nonNegative) {
+    uint32_t ad = d < 0 ? -static_cast<uint32_t>(d) : d;
+    if (ad == 1) {
+        if (d > 0) vec.push_back(new MoveReg(dst, src));
+        else vec.push_back(new RsubImm(dst, src, 0));
+        return;
+    }
+    GR q = GR::allocateReg();
+    GR res = d > 0 ? dst : q;
+    if ((ad & (ad - 1)) == 0) {
+        // round toward zero: add 2^k - 1 to negative dividends before the shift
+        int k = __builtin_ctz(ad);
+        if (nonNegative) {
+            vec.push_back(new LSImmInstr(LSImmInstr::ASR, res, src, k));
+        } else if (k == 1) {
+            vec.push_back(new GRegRegInstr(GRegRegInstr::Add, q, src, src, GRegRegInstr::LSR, 31));
+        } else {
+            vec.push_back(new LSImmInstr(LSImmInstr::ASR, q, src, 31));
+            vec.push_back(new GRegRegInstr(GRegRegInstr::Add, q, src, q, GRegRegInstr::LSR, 32 - k));
+        }
+        if (!nonNegative) vec.push_back(new LSImmInstr(LSImmInstr::ASR, res, q, k));
+    } else {
+        int magic, shift;
+        signedMagic(ad, magic, shift);
+        vec.push_back(new SMMUL(q, src, getConstantGR(magic, block, vec)));
+        if (magic < 0) {
+            vec.push_back(new GRegRegInstr(GRegRegInstr::Add, q, q, src));
+        }
+        if (nonNegative) {
+            if (shift > 0) {
+                vec.push_back(new LSImmInstr(LSImmInstr::ASR, res, q, shift));
+            } else if (res != q) {
+                vec.push_back(new MoveReg(res, q));
+            }
+        } else {
+            if (shift > 0) {
+                vec.push_back(new LSImmInstr(LSImmInstr::ASR, q, q, shift));
+            }
+            vec.push_back(new GRegRegInstr(GRegRegInstr::Add, res, q, src, GRegRegInstr::LSR, 31));
+        }
+    }
+    if (d < 0) {
+        vec.push_back(new RsubImm(dst, q, 0));
     }
-    return constantIntMapping[block][x];
 }
 void Codegen::generateFloatConst() {
     for (std::pair<float, std::string> pair: floatConstMapping) {
@@ -132,28 +209,6 @@ void Codegen::generateProgramCode() {
     for (auto itt = irVisitor.functions.rbegin(); itt != irVisitor.functions.rend(); itt++) {
         Function *function = *itt;
         if (function->basicBlocks.empty()) continue;
-        //cope with phi
-        {
-            for (BasicBlock *block: function->basicBlocks) {
-                for (Instruction* ir:block->getIr()) {
-                    if (typeid(*ir) == typeid(PhiIR)) {
-                        PhiIR* phiIr = dynamic_cast<PhiIR*>(ir);
-                        for (std::pair<BasicBlock*, Value*> pair:phiIr->params) {
-                            BasicBlock* pre = pair.first;
-                            Value* src = pair.second;
-                            auto it = pre->getIr().end();
-                            if (typeid(**it) == typeid(JumpIR)) {
-                                pre->getIr().insert(it - 1,new MoveIR(phiIr->dst, src));
-                            } else if (typeid(**it) == typeid(BranchIR)) {
-                                pre->getIr().insert(it - 2,new MoveIR(phiIr->dst, src));
-                            } else {
-                                pre->getIr().push_back(new MoveIR(phiIr,src));
-                            }
-                        }
-                    }
-                }
-            }
-        }
         function->stackSize = translateFunction(function);
         ColoringAlloc coloringAlloc(function);
         int spill_size = coloringAlloc.run() * 4;
@@ -504,6 +559,8 @@ void Codegen::generateProgramCode() {
 
 int Codegen::translateFunction(Function *function) {
     stackMapping.clear();
+    function->renumberBB();
+    constantIntMapping.assign(function->basicBlocks.size(), {});
     int stackSize = 0;
     GR::reg_num = 16;
     FR::reg_num = 32;
@@ -545,23 +602,37 @@ int Codegen::translateFunction(Function *function) {
         int gr_cnt = 0;
         int fr_cnt = 0;
         int cnt = 0;
+        // stack-passed params are addressed by a negative offset fixed up after the push,
+        // the first one would get offset 0 in an empty frame
+        if (stackSize == 0) {
+            for (Value *param: function->params) {
+                if (param->getType()->isFloat() ? fr_cnt++ >= 32 : gr_cnt++ >= 4) {
+                    stackSize = 4;
+                    break;
+                }
+            }
+            gr_cnt = 0;
+            fr_cnt = 0;
+        }
         for (int i = 0; i < function->params.size(); i++) {
             if (!function->params[i]->getType()->isFloat()) {
                 if (gr_cnt < 4) {
-                    gRegMapping[function->params[i]] = GR(gr_cnt);
+                    // copy out of the argument register, r0-r3 are clobbered by calls
+                    function->basicBlocks[0]->pushInstr(new MoveReg(getGR(function->params[i]), GR(gr_cnt)));
                 } else {
                     //push {}  -> stackSize + cnt * 4 + pushSize
                     // eg :push {r4,r5} int f(int a,int b,int c,int d,int e)
                     // e -> [sp, # (16 + 8)]
-                    stackMapping[function->params[i]] = -(stackSize + cnt * 4);
+                    // load into its own register at entry, like the register-passed params
+                    function->basicBlocks[0]->pushInstr(new Load(getGR(function->params[i]), GR(13), -(stackSize + cnt * 4)));
                     cnt++;
                 }
                 gr_cnt++;
             } else {
                 if (fr_cnt < 32) {
-                    fRegMapping[function->params[i]] = FR(fr_cnt);
+                    function->basicBlocks[0]->pushInstr(new VMoveReg(getFR(function->params[i]), FR(fr_cnt)));
                 } else {
-                    stackMapping[function->params[i]] = -(stackSize + cnt * 4);
+                    function->basicBlocks[0]->pushInstr(new VLoad(getFR(function->params[i]), GR(13), -(stackSize + cnt * 4)));
                     cnt++;
                 }
                 fr_cnt++;
@@ -587,16 +658,28 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         assert(dst != nullptr);
         assert(src != nullptr);
         std::vector<Instr*> vec;
-        if (dst->getType()->isInt()) {
+        if (!dst->getType()->isFloat()) {
             if (!src->getVal()) {
                 if (is_legal_immediate(src->getInt())) {
                     vec.push_back(new MovImm(getGR(dst), src->getInt()));
                 } else {
                     getConstantGR(src->getInt(),block,vec);
-                    vec.push_back(new MoveReg(getGR(dst), constantIntMapping[block][src->getInt()]));
+                    vec.push_back(new MoveReg(getGR(dst), constantIntMapping[block->getId()][src->getInt()]));
+                }
+            } else if (stackMapping.count(src->getVal()) != 0 && stackMapping[src->getVal()] >= 0) {
+                // address of a local array, e.g. a pointer phi after tail recursion elimination
+                if (is_legal_load_store_offset(stackMapping[src->getVal()]) &&
+                    is_legal_immediate(stackMapping[src->getVal()])) {
+                    vec.push_back(new GRegImmInstr(GRegImmInstr::Add, getGR(dst), GR(13), stackMapping[src->getVal()]));
+                } else {
+                    std::vector<Instr *> v = setIntValue(GR(12), stackMapping[src->getVal()]);
+                    for (Instr *instr: v) {
+                        vec.push_back(instr);
+                    }
+                    vec.push_back(new GRegRegInstr(GRegRegInstr::Add, getGR(dst), GR(13), GR(12)));
                 }
             } else {
-                vec.push_back(new MoveReg(getGR(dst), getGR(src)));
+                vec.push_back(new MoveReg(getGR(dst), getGR(src->getVal())));
             }
         } else {
             if (!src->getVal()) {
@@ -606,7 +689,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new VLoad(d, GR(12), 0));
                 vec.push_back(new VMoveReg(getFR(dst),d));
             } else {
-                vec.push_back(new VMoveReg(getFR(dst), getFR(src)));
+                vec.push_back(new VMoveReg(getFR(dst), getFR(src->getVal())));
             }
         }
         return vec;
@@ -614,18 +697,19 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
     if (typeid(*ir) == typeid(AllocIIR)) {
         AllocIIR *allocIir = dynamic_cast<AllocIIR *>(ir);
         std::vector<Instr *> vec;
-        if (allocIir->isArray) {
-            if (is_legal_immediate(stackMapping[allocIir->v]) &&
-                is_legal_load_store_offset(stackMapping[allocIir->v])) {
-                vec.push_back(new GRegImmInstr(GRegImmInstr::Add, GR(0), GR(13), stackMapping[allocIir->v]));
+        // only the range not overwritten before use is cleared
+        if (allocIir->isArray && allocIir->getZeroEnd() > allocIir->zeroBegin) {
+            int offset = stackMapping[allocIir->v] + allocIir->zeroBegin * 4;
+            if (is_legal_immediate(offset) && is_legal_load_store_offset(offset)) {
+                vec.push_back(new GRegImmInstr(GRegImmInstr::Add, GR(0), GR(13), offset));
             } else {
-                std::vector<Instr *> v = setIntValue(GR(12), stackMapping[allocIir->v]);
+                std::vector<Instr *> v = setIntValue(GR(12), offset);
                 for (Instr *instr: v) {
                     vec.push_back(instr);
                 }
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Add, GR(0), GR(13), GR(12)));
             }
-            for (Instr *instr: setIntValue(GR(1), allocIir->arrayLen * 4)) {
+            for (Instr *instr: setIntValue(GR(1), (allocIir->getZeroEnd() - allocIir->zeroBegin) * 4)) {
                 vec.push_back(instr);
             }
             vec.push_back(new Bl(".memset"));
@@ -635,18 +719,19 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
     if (typeid(*ir) == typeid(AllocFIR)) {
         AllocFIR *allocIir = dynamic_cast<AllocFIR *>(ir);
         std::vector<Instr *> vec;
-        if (allocIir->isArray) {
-            if (is_legal_immediate(stackMapping[allocIir->v]) &&
-                is_legal_load_store_offset(stackMapping[allocIir->v])) {
-                vec.push_back(new GRegImmInstr(GRegImmInstr::Add, GR(0), GR(13), stackMapping[allocIir->v]));
+        // only the range not overwritten before use is cleared
+        if (allocIir->isArray && allocIir->getZeroEnd() > allocIir->zeroBegin) {
+            int offset = stackMapping[allocIir->v] + allocIir->zeroBegin * 4;
+            if (is_legal_immediate(offset) && is_legal_load_store_offset(offset)) {
+                vec.push_back(new GRegImmInstr(GRegImmInstr::Add, GR(0), GR(13), offset));
             } else {
-                std::vector<Instr *> v = setIntValue(GR(12), stackMapping[allocIir->v]);
+                std::vector<Instr *> v = setIntValue(GR(12), offset);
                 for (Instr *instr: v) {
                     vec.push_back(instr);
                 }
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Add, GR(0), GR(13), GR(12)));
             }
-            for (Instr *instr: setIntValue(GR(1), allocIir->arrayLen * 4)) {
+            for (Instr *instr: setIntValue(GR(1), (allocIir->getZeroEnd() - allocIir->zeroBegin) * 4)) {
                 vec.push_back(instr);
             }
             vec.push_back(new Bl(".memset"));
@@ -792,12 +877,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(instr);
             }
         } else {
-            if (gRegMapping.count(storeIr->src.getVal()) != 0) {
-                src = getGR(storeIr->src.getVal());
-            } else {
-                stackMapping[storeIr->dst] = stackMapping[storeIr->src.getVal()];
-                return vec;
-            }
+            src = getGR(storeIr->src.getVal());
         }
         if (storeIr->dst->is_Global()) {
             Value *v = new VarValue();
@@ -837,12 +917,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
             vec.push_back(new MoveTFromSymbol(GR(12), getFloatAddr(storeIr->src.getFloat())));
             vec.push_back(new VLoad(src, GR(12), 0));
         } else {
-            if (fRegMapping.count(storeIr->src.getVal()) != 0) {
-                src = getFR(storeIr->src.getVal());
-            } else {
-                stackMapping[storeIr->dst] = stackMapping[storeIr->src.getVal()];
-                return vec;
-            }
+            src = getFR(storeIr->src.getVal());
         }
         if (storeIr->dst->is_Global()) {
             Value *v = new VarValue();
@@ -874,20 +949,31 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         std::vector<Instr *> vec;
         UnaryIR *unaryIr = dynamic_cast<UnaryIR *>(ir);
         if (unaryIr->res.isInt()) {
-            GR src = gRegMapping[unaryIr->v.getVal()];
-            gRegMapping[unaryIr->res.getVal()] = src;
+            GR dst = getGR(unaryIr->res.getVal());
+            if (!unaryIr->v.getVal()) {
+                int x = unaryIr->v.isFloat() ? (int) unaryIr->v.getFloat() : unaryIr->v.getInt();
+                return setIntValue(dst, unaryIr->op == OP::NEG ? -x : !x);
+            }
+            GR src = getGR(unaryIr->v.getVal());
             if (unaryIr->op == OP::NEG) {
-                vec.push_back(new RsubImm(gRegMapping[unaryIr->res.getVal()], gRegMapping[unaryIr->res.getVal()], 0));
+                vec.push_back(new RsubImm(dst, src, 0));
             } else {
                 vec.push_back(new CmpImm(src, 0));
-                vec.push_back(new MovImm(src, 0));
-                vec.push_back(new MovImm(src, 1, EQU));
+                vec.push_back(new MovImm(dst, 0));
+                vec.push_back(new MovImm(dst, 1, EQU));
             }
         } else {
-            FR src = fRegMapping[unaryIr->v.getVal()];
+            FR src;
+            if (!unaryIr->v.getVal()) {
+                src = FR::allocateReg();
+                vec.push_back(new MoveWFromSymbol(GR(12), getFloatAddr(unaryIr->v.getFloat())));
+                vec.push_back(new MoveTFromSymbol(GR(12), getFloatAddr(unaryIr->v.getFloat())));
+                vec.push_back(new VLoad(src, GR(12), 0));
+            } else {
+                src = getFR(unaryIr->v.getVal());
+            }
             if (unaryIr->op == OP::NEG) {
-                fRegMapping[unaryIr->res.getVal()] = src;
-                vec.push_back(new VNeg(src, src));
+                vec.push_back(new VNeg(getFR(unaryIr->res.getVal()), src));
             } else {
                 vec.push_back(new VCmpe(src, 0));
                 vec.push_back(new VMrs());
@@ -908,7 +994,8 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         CastFloat2IntIR *ir2 = dynamic_cast<CastFloat2IntIR *>(ir);
         FR src = getFR(ir2->v2);
         GR dst = getGR(ir2->v1);
-        return {new VcvtSF(src, src), new VMovGF(dst, src)};
+        FR tmp = FR::allocateReg();
+        return {new VcvtSF(tmp, src), new VMovGF(dst, tmp)};
     }
 
     if (typeid(*ir) == typeid(AddIIR)) {
@@ -929,7 +1016,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Add,
                                                getGR(addIir->res.getVal()),
                                                getGR(addIir->left.getVal()),
-                                               constantIntMapping[block][addIir->right.getInt()]));
+                                               constantIntMapping[block->getId()][addIir->right.getInt()]));
             }
         } else {
             vec.push_back(new GRegRegInstr(GRegRegInstr::Add, getGR(addIir->res.getVal()), getGR(addIir->left.getVal()),
@@ -950,7 +1037,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Sub,
                                                getGR(subIir->res.getVal()),
                                                getGR(subIir->left.getVal()),
-                                               constantIntMapping[block][subIir->right.getInt()]));
+                                               constantIntMapping[block->getId()][subIir->right.getInt()]));
             }
         } else if (!subIir->left.getVal()) {
             if (is_legal_immediate(subIir->left.getInt())) {
@@ -959,7 +1046,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 getConstantGR(subIir->left.getInt(),block,vec);
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Sub,
                                                getGR(subIir->res.getVal()),
-                                               constantIntMapping[block][subIir->left.getInt()],
+                                               constantIntMapping[block->getId()][subIir->left.getInt()],
                                                getGR(subIir->right.getVal())));
             }
         } else {
@@ -1043,7 +1130,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Mul,
                                                getGR(mulIir->res.getVal()),
                                                getGR(mulIir->left.getVal()),
-                                               constantIntMapping[block][mulIir->right.getInt()]));
+                                               constantIntMapping[block->getId()][mulIir->right.getInt()]));
             }
         } else {
             vec.push_back(new GRegRegInstr(GRegRegInstr::Mul, getGR(mulIir->res.getVal()), getGR(mulIir->left.getVal()),
@@ -1056,35 +1143,22 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         DivIIR* divIir = dynamic_cast<DivIIR*>(ir);
         if (!divIir->right.getVal()) {
             int v = divIir->right.getInt();
-            int i = 0;
-            for (i = 0; i < 32; ++i) {
-                int x = 1;
-                int y = x << i;
-                if (y == v) {
-                    vec.push_back(new MoveReg(getGR(divIir->res.getVal()),
-                                              getGR(divIir->left.getVal())));
-                    vec.push_back(new CmpImm(getGR(divIir->res.getVal()),0));
-                    vec.push_back(new GRegImmInstr(GRegImmInstr::Add,
-                                                   getGR(divIir->res.getVal()),
-                                                   getGR(divIir->res.getVal()),
-                                                   1,COND::LT));
-                    vec.push_back(new MoveReg(getGR(divIir->res.getVal()), getGR(divIir->res.getVal()), i));
-                    break;
-                }
-            }
-            if (i == 32) {
+            GR left_gr = divIir->left.getVal() ? getGR(divIir->left.getVal()) : getConstantGR(divIir->left.getInt(), block, vec);
+            if (v != 0 && v != INT32_MIN) {
+                divByConst(getGR(divIir->res.getVal()), left_gr, v, block, vec, divIir->nonNegative);
+            } else {
                 getConstantGR(divIir->right.getInt(),block,vec);
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Div,
                                                getGR(divIir->res.getVal()),
-                                               getGR(divIir->left.getVal()),
-                                               constantIntMapping[block][divIir->right.getInt()]));
+                                               left_gr,
+                                               constantIntMapping[block->getId()][divIir->right.getInt()]));
             }
         } else if (!divIir->left.getVal()){
             if (!divIir->left.getVal()) {
                 getConstantGR(divIir->left.getInt(),block,vec);
                 vec.push_back(new GRegRegInstr(GRegRegInstr::Div,
                                                getGR(divIir->res.getVal()),
-                                               constantIntMapping[block][divIir->left.getInt()],
+                                               constantIntMapping[block->getId()][divIir->left.getInt()],
                                                getGR(divIir->right.getVal())));
             }
         } else {
@@ -1106,6 +1180,35 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         if (modIr->right.getVal()) {
             right_gr = getGR(modIr->right.getVal());
         } else {
+            // n % d == n % -d, and n - (n / d) * d with the quotient from the magic-number sequence
+            int v = modIr->right.getInt();
+            uint32_t av = v < 0 ? -static_cast<uint32_t>(v) : v;
+            if (av == 1) {
+                vec.push_back(new MovImm(res_gr, 0));
+                return vec;
+            }
+            if (v != 0 && v != INT32_MIN && modIr->nonNegative && (av & (av - 1)) == 0) {
+                // non-negative n % 2^k keeps the low k bits
+                int k = __builtin_ctz(av);
+                if (is_legal_immediate(av - 1)) {
+                    vec.push_back(new GRegImmInstr(GRegImmInstr::And, res_gr, left_gr, av - 1));
+                } else {
+                    vec.push_back(new LSImmInstr(LSImmInstr::LSL, res_gr, left_gr, 32 - k));
+                    vec.push_back(new LSImmInstr(LSImmInstr::LSR, res_gr, res_gr, 32 - k));
+                }
+                return vec;
+            }
+            if (v != 0 && v != INT32_MIN) {
+                GR q = GR::allocateReg();
+                divByConst(q, left_gr, av, block, vec, modIr->nonNegative);
+                if ((av & (av - 1)) == 0) {
+                    vec.push_back(new GRegRegInstr(GRegRegInstr::Sub, res_gr, left_gr, q, GRegRegInstr::LSL,
+                                                   __builtin_ctz(av)));
+                } else {
+                    vec.push_back(new MLS(res_gr, q, getConstantGR(av, block, vec), left_gr));
+                }
+                return vec;
+            }
             right_gr = getConstantGR(modIr->right.getInt(),block,vec);
         }
         vec.push_back(new GRegRegInstr(GRegRegInstr::Div,res_gr,left_gr,right_gr));
@@ -1113,6 +1216,13 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         vec.push_back(new GRegRegInstr(GRegRegInstr::Sub,res_gr,left_gr,res_gr));
         return vec;
     }
+    if (typeid(*ir) == typeid(ShlIR)) {
+        ShlIR* shlIr = dynamic_cast<ShlIR*>(ir);
+        std::vector<Instr*> vec;
+        GR left_gr = shlIr->left.getVal() ? getGR(shlIr->left.getVal()) : getConstantGR(shlIr->left.getInt(), block, vec);
+        vec.push_back(new LSImmInstr(LSImmInstr::LSL, getGR(shlIr->res.getVal()), left_gr, shlIr->right.getInt()));
+        return vec;
+    }
     if (typeid(*ir) == typeid(LTIIR)) {
         LTIIR* ir2 = dynamic_cast<LTIIR*>(ir);
         std::vector<Instr*> vec;
@@ -1133,7 +1243,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new Cmp(getGR(ir2->right.getVal()),left_gr));
             }
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
-            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, GE));
+            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, GT));
         } else {
             vec.push_back(new Cmp(getGR(ir2->left.getVal()), getGR(ir2->right.getVal())));
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
@@ -1161,7 +1271,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new Cmp(getGR(ir2->right.getVal()),left_gr));
             }
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
-            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, GT));
+            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, GE));
         } else {
             vec.push_back(new Cmp(getGR(ir2->left.getVal()), getGR(ir2->right.getVal())));
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
@@ -1189,7 +1299,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new Cmp(getGR(ir2->right.getVal()),left_gr));
             }
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
-            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, LE));
+            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, LT));
         } else {
             vec.push_back(new Cmp(getGR(ir2->left.getVal()), getGR(ir2->right.getVal())));
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
@@ -1217,7 +1327,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                 vec.push_back(new Cmp(getGR(ir2->right.getVal()),left_gr));
             }
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
-            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, LT));
+            vec.push_back(new MovImm(getGR(ir2->res.getVal()), 1, LE));
         } else {
             vec.push_back(new Cmp(getGR(ir2->left.getVal()), getGR(ir2->right.getVal())));
             vec.push_back(new MovImm(getGR(ir2->res.getVal()), 0));
@@ -1408,28 +1518,32 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
             }
             if (!v.isFloat()) {
                 if (gr_cnt >= 4) {
+                    GR argReg;
                     if (!v.getVal()) {
-                        v.setVal(new VarValue());
-                        std::vector<Instr *> vv = setIntValue(getGR(v.getVal()), v.getInt());
+                        argReg = getGR(new VarValue());
+                        std::vector<Instr *> vv = setIntValue(argReg, v.getInt());
                         for (Instr *instr: vv) {
                             tempVec.push_back(instr);
                         }
-                    } else if (gRegMapping.count(v.getVal()) == 0) {
+                    } else if (stackMapping.count(v.getVal()) != 0 && stackMapping[v.getVal()] >= 0) {
+                        // address of a local array
+                        argReg = getGR(new VarValue());
                         if (is_legal_load_store_offset(stackMapping[v.getVal()]) &&
                             is_legal_immediate(stackMapping[v.getVal()])) {
-                            tempVec.push_back(new GRegImmInstr(GRegImmInstr::Add, getGR(v.getVal()), GR(13),
+                            tempVec.push_back(new GRegImmInstr(GRegImmInstr::Add, argReg, GR(13),
                                                                stackMapping[v.getVal()]));
                         } else {
                             std::vector<Instr *> vv = setIntValue(GR(12), stackMapping[v.getVal()]);
                             for (Instr *instr: vv) {
                                 tempVec.push_back(instr);
                             }
-                            tempVec.push_back(new GRegRegInstr(GRegRegInstr::Add, getGR(v.getVal()), GR(13), GR(12)));
+                            tempVec.push_back(new GRegRegInstr(GRegRegInstr::Add, argReg, GR(13), GR(12)));
                         }
+                    } else {
+                        argReg = getGR(v.getVal());
                     }
-                    stackMapping[v.getVal()] = cnt * 4;
+                    tempVec.push_back(new Store(argReg, GR(13), cnt * 4));
                     cnt++;
-                    tempVec.push_back(new Store(getGR(v.getVal()), GR(13), stackMapping[v.getVal()]));
                 } else {
                     if (!v.getVal()) {
                         v.setVal(new VarValue());
@@ -1443,9 +1557,8 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                             }
                         }
                     } else {
-                        if (gRegMapping.count(v.getVal()) != 0) {
+                        if (stackMapping.count(v.getVal()) == 0 || stackMapping[v.getVal()] < 0) {
                             tempVec.push_back(new MoveReg(GR(gr_cnt), getGR(v.getVal())));
-                            gRegMapping[v.getVal()] = gr_cnt;
                         } else {
                             if (is_legal_load_store_offset(stackMapping[v.getVal()]) &&
                                 is_legal_immediate(stackMapping[v.getVal()])) {
@@ -1470,9 +1583,8 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                         tempVec.push_back(new MoveTFromSymbol(GR(12), getFloatAddr(v.getFloat())));
                         tempVec.push_back(new VLoad(getFR(v.getVal()), GR(12), 0));
                     }
-                    stackMapping[v.getVal()] = cnt * 4;
+                    tempVec.push_back(new VStore(getFR(v.getVal()), GR(13), cnt * 4));
                     cnt++;
-                    tempVec.push_back(new VStore(getFR(v.getVal()), GR(13), stackMapping[v.getVal()]));
                 } else {
                     if (!v.getVal()) {
                         v.setVal(new VarValue());
@@ -1482,7 +1594,6 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
                         tempVec.push_back(new VLoad(getFR(v.getVal()), GR(12), 0));
                     } else {
                         tempVec.push_back(new VMoveReg(FR(fr_cnt), getFR(v.getVal())));
-                        fRegMapping[v.getVal()] = fr_cnt;
                     }
                 }
                 fr_cnt++;
@@ -1510,7 +1621,7 @@ std::vector<Instr *> Codegen::translateInstr(Instruction *ir, BasicBlock* block)
         ReturnIR *returnIr = dynamic_cast<ReturnIR *>(ir);
         std::vector<Instr *> vec;
         if (returnIr->useInt) {
-            vec.push_back(new MovImm(GR(0), returnIr->retInt));
+            vec = setIntValue(GR(0), returnIr->retInt);
         } else if (returnIr->useFloat) {
             vec.push_back(new MoveWFromSymbol(GR(12), getFloatAddr(returnIr->retFloat)));
             vec.push_back(new MoveTFromSymbol(GR(12), getFloatAddr(returnIr->retFloat)));
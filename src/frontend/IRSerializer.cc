@@ -0,0 +1,805 @@
+//
+// Created by agent on 26-10-19.
+//
+#include "IRSerializer.hh"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <typeinfo>
+
+namespace {
+enum ValueKind : uint8_t {
+    VK_VAR,
+    VK_CONST,
+    VK_TEMP,
+};
+
+enum Opcode : uint8_t {
+    OPC_MOVE,
+    OPC_ALLOCI,
+    OPC_ALLOCF,
+    OPC_LOADI,
+    OPC_LOADF,
+    OPC_STOREI,
+    OPC_STOREF,
+    OPC_I2F,
+    OPC_F2I,
+    OPC_ADDI, OPC_ADDF, OPC_SUBI, OPC_SUBF, OPC_MULI, OPC_MULF, OPC_DIVI, OPC_DIVF, OPC_MOD,
+    OPC_LTI, OPC_LTF, OPC_LEI, OPC_LEF, OPC_GTI, OPC_GTF, OPC_GEI, OPC_GEF,
+    OPC_EQUI, OPC_EQUF, OPC_NEI, OPC_NEF,
+    OPC_UNARY,
+    OPC_BREAK,
+    OPC_CONTINUE,
+    OPC_RETURN,
+    OPC_JUMP,
+    OPC_BRANCH,
+    OPC_GEP,
+    OPC_CALL,
+    OPC_PHI,
+    OPC_SHL,
+};
+
+// TempVal field mask
+const uint8_t TV_VAL = 1, TV_TYPE = 2, TV_INT = 4, TV_FLOAT = 8, TV_STRING = 16;
+
+void putVarint(std::string& buf, uint32_t x) {
+    while (x >= 0x80) {
+        buf.push_back(static_cast<char>(x | 0x80));
+        x >>= 7;
+    }
+    buf.push_back(static_cast<char>(x));
+}
+
+void putSVarint(std::string& buf, int32_t x) {
+    putVarint(buf, (static_cast<uint32_t>(x) << 1) ^ static_cast<uint32_t>(x >> 31));
+}
+
+void putFloat(std::string& buf, float x) {
+    char bytes[4];
+    memcpy(bytes, &x, 4);
+    buf.append(bytes, 4);
+}
+
+Opcode getOpcode(Instruction* ir) {
+    const std::type_info& t = typeid(*ir);
+    if (t == typeid(MoveIR)) return OPC_MOVE;
+    if (t == typeid(AllocIIR)) return OPC_ALLOCI;
+    if (t == typeid(AllocFIR)) return OPC_ALLOCF;
+    if (t == typeid(LoadIIR)) return OPC_LOADI;
+    if (t == typeid(LoadFIR)) return OPC_LOADF;
+    if (t == typeid(StoreIIR)) return OPC_STOREI;
+    if (t == typeid(StoreFIR)) return OPC_STOREF;
+    if (t == typeid(CastInt2FloatIR)) return OPC_I2F;
+    if (t == typeid(CastFloat2IntIR)) return OPC_F2I;
+    if (t == typeid(AddIIR)) return OPC_ADDI;
+    if (t == typeid(AddFIR)) return OPC_ADDF;
+    if (t == typeid(SubIIR)) return OPC_SUBI;
+    if (t == typeid(SubFIR)) return OPC_SUBF;
+    if (t == typeid(MulIIR)) return OPC_MULI;
+    if (t == typeid(MulFIR)) return OPC_MULF;
+    if (t == typeid(DivIIR)) return OPC_DIVI;
+    if (t == typeid(DivFIR)) return OPC_DIVF;
+    if (t == typeid(ModIR)) return OPC_MOD;
+    if (t == typeid(LTIIR)) return OPC_LTI;
+    if (t == typeid(LTFIR)) return OPC_LTF;
+    if (t == typeid(LEIIR)) return OPC_LEI;
+    if (t == typeid(LEFIR)) return OPC_LEF;
+    if (t == typeid(GTIIR)) return OPC_GTI;
+    if (t == typeid(GTFIR)) return OPC_GTF;
+    if (t == typeid(GEIIR)) return OPC_GEI;
+    if (t == typeid(GEFIR)) return OPC_GEF;
+    if (t == typeid(EQUIIR)) return OPC_EQUI;
+    if (t == typeid(EQUFIR)) return OPC_EQUF;
+    if (t == typeid(NEIIR)) return OPC_NEI;
+    if (t == typeid(NEFIR)) return OPC_NEF;
+    if (t == typeid(UnaryIR)) return OPC_UNARY;
+    if (t == typeid(BreakIR)) return OPC_BREAK;
+    if (t == typeid(ContinueIR)) return OPC_CONTINUE;
+    if (t == typeid(ReturnIR)) return OPC_RETURN;
+    if (t == typeid(JumpIR)) return OPC_JUMP;
+    if (t == typeid(BranchIR)) return OPC_BRANCH;
+    if (t == typeid(GEPIR)) return OPC_GEP;
+    if (t == typeid(CallIR)) return OPC_CALL;
+    if (t == typeid(PhiIR)) return OPC_PHI;
+    if (t == typeid(ShlIR)) return OPC_SHL;
+    throw IRFormatError(std::string("unsupported instruction: ") + t.name());
+}
+
+ArithmeticIR* newArithmetic(Opcode opc, TempVal res, TempVal left, TempVal right) {
+    switch (opc) {
+        case OPC_ADDI: return new AddIIR(res, left, right);
+        case OPC_ADDF: return new AddFIR(res, left, right);
+        case OPC_SUBI: return new SubIIR(res, left, right);
+        case OPC_SUBF: return new SubFIR(res, left, right);
+        case OPC_MULI: return new MulIIR(res, left, right);
+        case OPC_MULF: return new MulFIR(res, left, right);
+        case OPC_DIVI: return new DivIIR(res, left, right);
+        case OPC_DIVF: return new DivFIR(res, left, right);
+        case OPC_MOD: return new ModIR(res, left, right);
+        case OPC_LTI: return new LTIIR(res, left, right);
+        case OPC_LTF: return new LTFIR(res, left, right);
+        case OPC_LEI: return new LEIIR(res, left, right);
+        case OPC_LEF: return new LEFIR(res, left, right);
+        case OPC_GTI: return new GTIIR(res, left, right);
+        case OPC_GTF: return new GTFIR(res, left, right);
+        case OPC_GEI: return new GEIIR(res, left, right);
+        case OPC_GEF: return new GEFIR(res, left, right);
+        case OPC_EQUI: return new EQUIIR(res, left, right);
+        case OPC_EQUF: return new EQUFIR(res, left, right);
+        case OPC_NEI: return new NEIIR(res, left, right);
+        case OPC_NEF: return new NEFIR(res, left, right);
+        case OPC_SHL: return new ShlIR(res, left, right);
+        default: return nullptr;
+    }
+}
+}
+
+uint32_t IRSerializer::getValueId(Value* v) {
+    if (!v) return 0;
+    auto it = valueIds.find(v);
+    if (it != valueIds.end()) return it->second;
+    values.push_back(v);
+    valueIds[v] = values.size();
+    return values.size();
+}
+
+uint32_t IRSerializer::getTypeId(Type* t) {
+    if (!t) return 0;
+    auto it = typeIds.find(t);
+    if (it != typeIds.end()) return it->second;
+    // contained types get smaller ids so the reader can build them first
+    if (t->isPointer()) getTypeId(t->getContained());
+    types.push_back(t);
+    typeIds[t] = types.size();
+    return types.size();
+}
+
+uint32_t IRSerializer::getStringId(const std::string& s) {
+    auto it = stringIds.find(s);
+    if (it != stringIds.end()) return it->second;
+    strings.push_back(s);
+    stringIds[s] = strings.size() - 1;
+    return strings.size() - 1;
+}
+
+uint32_t IRSerializer::getBlockId(BasicBlock* bb) {
+    if (!bb) return 0;
+    auto it = blockIds.find(bb);
+    if (it != blockIds.end()) return it->second;
+    // jump targets may still point at the CondBlock a NormalBlock was rebuilt from
+    auto nameIt = blockNameIds.find(bb->name);
+    if (nameIt != blockNameIds.end()) return nameIt->second;
+    throw IRFormatError("jump target outside of function: " + bb->name);
+}
+
+void IRSerializer::writeTempVal(std::string& buf, TempVal& t) {
+    uint8_t mask = 0;
+    if (t.getVal()) mask |= TV_VAL;
+    if (t.getType()) mask |= TV_TYPE;
+    if (t.getInt() != 0) mask |= TV_INT;
+    if (t.getFloat() != 0 || std::signbit(t.getFloat())) mask |= TV_FLOAT;
+    if (!t.getString().empty()) mask |= TV_STRING;
+    buf.push_back(static_cast<char>(mask));
+    if (mask & TV_VAL) putVarint(buf, getValueId(t.getVal()));
+    if (mask & TV_TYPE) putVarint(buf, getTypeId(t.getType()));
+    if (mask & TV_INT) putSVarint(buf, t.getInt());
+    if (mask & TV_FLOAT) putFloat(buf, t.getFloat());
+    if (mask & TV_STRING) putVarint(buf, getStringId(t.getString()));
+}
+
+void IRSerializer::writeValue(std::string& buf, Value* v) {
+    if (typeid(*v) == typeid(TempVal)) {
+        buf.push_back(VK_TEMP);
+        writeTempVal(buf, *dynamic_cast<TempVal*>(v));
+        return;
+    }
+    ConstValue* constValue = dynamic_cast<ConstValue*>(v);
+    buf.push_back(constValue ? VK_CONST : VK_VAR);
+    putVarint(buf, getStringId(v->getName()));
+    putSVarint(buf, v->getNum());
+    putVarint(buf, getTypeId(v->getType()));
+    buf.push_back(static_cast<char>((v->is_Global() ? 1 : 0) | (v->is_Array() ? 2 : 0)));
+    std::vector<int> dims = v->getArrayDims();
+    putVarint(buf, dims.size());
+    for (int dim : dims) putSVarint(buf, dim);
+    putSVarint(buf, v->is_Array() ? v->getArrayLen() : 0);
+    if (!constValue) return;
+    if (constValue->is_Array()) {
+        std::vector<int> intList = constValue->getIntValList();
+        std::vector<float> floatList = constValue->getFloatValList();
+        putVarint(buf, intList.size());
+        for (int x : intList) putSVarint(buf, x);
+        putVarint(buf, floatList.size());
+        for (float x : floatList) putFloat(buf, x);
+    } else if (constValue->getType()->isInt()) {
+        putSVarint(buf, constValue->getIntVal());
+    } else {
+        putFloat(buf, constValue->getFloatVal());
+    }
+}
+
+void IRSerializer::writeInstruction(std::string& buf, Instruction* ir) {
+    Opcode opc = getOpcode(ir);
+    buf.push_back(static_cast<char>(opc));
+    // bit 1 marks a division or modulo with a non-negative dividend
+    ArithmeticIR* flagged = dynamic_cast<ArithmeticIR*>(ir);
+    bool nonNegative = flagged && flagged->nonNegative;
+    buf.push_back(static_cast<char>((ir->isDeleted() ? 1 : 0) | (nonNegative ? 2 : 0)));
+    irCnt++;
+    switch (opc) {
+        case OPC_MOVE: {
+            MoveIR* moveIr = dynamic_cast<MoveIR*>(ir);
+            putVarint(buf, getValueId(moveIr->dst));
+            putVarint(buf, getValueId(moveIr->src));
+            break;
+        }
+        case OPC_ALLOCI:
+        case OPC_ALLOCF: {
+            AllocIR* allocIr = dynamic_cast<AllocIR*>(ir);
+            putVarint(buf, getValueId(allocIr->v));
+            // bit 1 marks a memset range narrowed by dead store elimination
+            bool partial = allocIr->isArray && !allocIr->zeroesAll();
+            buf.push_back(static_cast<char>((allocIr->isArray ? 1 : 0) | (partial ? 2 : 0)));
+            putSVarint(buf, allocIr->arrayLen);
+            if (partial) {
+                putSVarint(buf, allocIr->zeroBegin);
+                putSVarint(buf, allocIr->getZeroEnd());
+            }
+            break;
+        }
+        case OPC_LOADI:
+        case OPC_LOADF: {
+            LoadIR* loadIr = dynamic_cast<LoadIR*>(ir);
+            putVarint(buf, getValueId(loadIr->v1));
+            putVarint(buf, getValueId(loadIr->v2));
+            break;
+        }
+        case OPC_STOREI:
+        case OPC_STOREF: {
+            StoreIR* storeIr = dynamic_cast<StoreIR*>(ir);
+            putVarint(buf, getValueId(storeIr->dst));
+            writeTempVal(buf, storeIr->src);
+            break;
+        }
+        case OPC_I2F: {
+            CastInt2FloatIR* castIr = dynamic_cast<CastInt2FloatIR*>(ir);
+            putVarint(buf, getValueId(castIr->v1));
+            putVarint(buf, getValueId(castIr->v2));
+            break;
+        }
+        case OPC_F2I: {
+            CastFloat2IntIR* castIr = dynamic_cast<CastFloat2IntIR*>(ir);
+            putVarint(buf, getValueId(castIr->v1));
+            putVarint(buf, getValueId(castIr->v2));
+            break;
+        }
+        case OPC_UNARY: {
+            UnaryIR* unaryIr = dynamic_cast<UnaryIR*>(ir);
+            writeTempVal(buf, unaryIr->res);
+            writeTempVal(buf, unaryIr->v);
+            buf.push_back(static_cast<char>(unaryIr->op == OP::NEG ? 0 : 1));
+            break;
+        }
+        case OPC_BREAK:
+        case OPC_CONTINUE:
+            break;
+        case OPC_RETURN: {
+            ReturnIR* returnIr = dynamic_cast<ReturnIR*>(ir);
+            buf.push_back(static_cast<char>((returnIr->useInt ? 1 : 0) | (returnIr->useFloat ? 2 : 0)));
+            putVarint(buf, getValueId(returnIr->v));
+            if (returnIr->useInt) putSVarint(buf, returnIr->retInt);
+            if (returnIr->useFloat) putFloat(buf, returnIr->retFloat);
+            break;
+        }
+        case OPC_JUMP:
+            putVarint(buf, getBlockId(dynamic_cast<JumpIR*>(ir)->target));
+            break;
+        case OPC_BRANCH: {
+            BranchIR* branchIr = dynamic_cast<BranchIR*>(ir);
+            putVarint(buf, getBlockId(branchIr->trueTarget));
+            putVarint(buf, getBlockId(branchIr->falseTarget));
+            putVarint(buf, getValueId(branchIr->cond));
+            break;
+        }
+        case OPC_GEP: {
+            GEPIR* gepIr = dynamic_cast<GEPIR*>(ir);
+            putVarint(buf, getValueId(gepIr->v1));
+            putVarint(buf, getValueId(gepIr->v2));
+            putVarint(buf, getValueId(gepIr->v3));
+            if (!gepIr->v3) putSVarint(buf, gepIr->arrayLen);
+            break;
+        }
+        case OPC_CALL: {
+            CallIR* callIr = dynamic_cast<CallIR*>(ir);
+            putVarint(buf, funcIds.at(callIr->func));
+            putVarint(buf, getValueId(callIr->returnVal));
+            putVarint(buf, callIr->args.size());
+            for (TempVal& arg : callIr->args) writeTempVal(buf, arg);
+            break;
+        }
+        case OPC_PHI: {
+            PhiIR* phiIr = dynamic_cast<PhiIR*>(ir);
+            putVarint(buf, getValueId(phiIr->dst));
+            // params is keyed by block address, write them in block id order so the image is reproducible
+            std::vector<std::pair<uint32_t, Value*>> params;
+            for (auto& param : phiIr->params) params.push_back({getBlockId(param.first), param.second});
+            std::sort(params.begin(), params.end(),
+                      [](const std::pair<uint32_t, Value*>& a, const std::pair<uint32_t, Value*>& b) {
+                          return a.first < b.first;
+                      });
+            putVarint(buf, params.size());
+            for (auto& param : params) {
+                putVarint(buf, param.first);
+                putVarint(buf, getValueId(param.second));
+            }
+            break;
+        }
+        default: {
+            ArithmeticIR* arIr = dynamic_cast<ArithmeticIR*>(ir);
+            writeTempVal(buf, arIr->res);
+            writeTempVal(buf, arIr->left);
+            writeTempVal(buf, arIr->right);
+            break;
+        }
+    }
+}
+
+void IRSerializer::writeBlock(std::string& buf, BasicBlock* bb) {
+    putVarint(buf, bb->getPre().size());
+    for (BasicBlock* pre : bb->getPre()) putVarint(buf, getBlockId(pre));
+    putVarint(buf, bb->getSucc().size());
+    for (BasicBlock* succ : bb->getSucc()) putVarint(buf, getBlockId(succ));
+    putVarint(buf, bb->ir.size());
+    for (Instruction* ir : bb->ir) writeInstruction(buf, ir);
+}
+
+void IRSerializer::write(std::ostream& out, uint32_t flags) {
+    values.clear();
+    valueIds.clear();
+    types.clear();
+    typeIds.clear();
+    strings.clear();
+    stringIds.clear();
+    funcIds.clear();
+    irCnt = 0;
+
+    std::string body;
+    std::vector<Function*>& functions = irVisitor.functions;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        funcIds[functions[i]] = i;
+    }
+    putVarint(body, irVisitor.globalVars.size());
+    for (Value* v : irVisitor.globalVars) putVarint(body, getValueId(v));
+    // function headers first, calls may refer to functions defined later
+    putVarint(body, functions.size());
+    for (Function* func : functions) {
+        putVarint(body, getStringId(func->name));
+        putVarint(body, getTypeId(func->return_type));
+        body.push_back(static_cast<char>(func->variant_params ? 1 : 0));
+        putSVarint(body, func->bbCnt);
+        putSVarint(body, func->varCnt);
+        putVarint(body, func->params.size());
+        for (Value* param : func->params) putVarint(body, getValueId(param));
+        putVarint(body, func->allocaVars.size());
+        for (Value* v : func->allocaVars) putVarint(body, getValueId(v));
+        putVarint(body, func->basicBlocks.size());
+        for (BasicBlock* bb : func->basicBlocks) putVarint(body, getStringId(bb->name));
+    }
+    for (Function* func : functions) {
+        blockIds.clear();
+        blockNameIds.clear();
+        for (size_t i = 0; i < func->basicBlocks.size(); ++i) {
+            blockIds[func->basicBlocks[i]] = i + 1;
+            blockNameIds[func->basicBlocks[i]->name] = i + 1;
+        }
+        for (BasicBlock* bb : func->basicBlocks) writeBlock(body, bb);
+    }
+    blockIds.clear();
+    blockNameIds.clear();
+    blockIds[irVisitor.entry] = 1;
+    putVarint(body, getStringId(irVisitor.entry->name));
+    writeBlock(body, irVisitor.entry);
+
+    // value records may pull in further values (TempVal -> val), so size grows while writing
+    std::string valueBuf;
+    for (size_t i = 0; i < values.size(); ++i) {
+        writeValue(valueBuf, values[i]);
+    }
+    std::string typeBuf;
+    size_t typeCnt = types.size();
+    for (size_t i = 0; i < typeCnt; ++i) {
+        Type* t = types[i];
+        TypeID tid = t->isInt() ? INT : t->isFloat() ? FLOAT : t->isString() ? STRING : t->isVoid() ? VOID : POINTER;
+        putVarint(typeBuf, tid);
+        putVarint(typeBuf, tid == POINTER ? getTypeId(t->getContained()) : 0);
+    }
+    std::string stringBuf;
+    for (const std::string& s : strings) {
+        putVarint(stringBuf, s.size());
+        stringBuf += s;
+    }
+
+    std::string header;
+    putVarint(header, MAGIC);
+    putVarint(header, VERSION);
+    putVarint(header, flags);
+    putVarint(header, strings.size());
+    putVarint(header, types.size());
+    putVarint(header, values.size());
+    out.write(header.data(), header.size());
+    out.write(stringBuf.data(), stringBuf.size());
+    out.write(typeBuf.data(), typeBuf.size());
+    out.write(valueBuf.data(), valueBuf.size());
+    out.write(body.data(), body.size());
+    byteSize = header.size() + stringBuf.size() + typeBuf.size() + valueBuf.size() + body.size();
+}
+
+uint8_t IRSerializer::readByte() {
+    if (cur >= end) throw IRFormatError("unexpected end of IR image");
+    return *cur++;
+}
+
+uint32_t IRSerializer::readVarint() {
+    uint32_t x = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b = readByte();
+        x |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return x;
+    }
+    throw IRFormatError("malformed varint in IR image");
+}
+
+int32_t IRSerializer::readSVarint() {
+    uint32_t x = readVarint();
+    return static_cast<int32_t>((x >> 1) ^ (~(x & 1) + 1));
+}
+
+float IRSerializer::readFloat() {
+    if (end - cur < 4) throw IRFormatError("unexpected end of IR image");
+    float x;
+    memcpy(&x, cur, 4);
+    cur += 4;
+    return x;
+}
+
+uint32_t IRSerializer::readCount() {
+    // every counted element takes at least one byte, so a count beyond the rest of the image is corrupt
+    uint32_t n = readVarint();
+    if (n > static_cast<size_t>(end - cur)) throw IRFormatError("element count exceeds IR image size");
+    return n;
+}
+
+Value* IRSerializer::readOptValueRef() {
+    uint32_t id = readVarint();
+    if (id == 0) return nullptr;
+    if (id > loadedValues.size()) throw IRFormatError("value id out of range");
+    return loadedValues[id - 1];
+}
+
+Value* IRSerializer::readValueRef() {
+    Value* v = readOptValueRef();
+    if (!v) throw IRFormatError("missing value reference");
+    return v;
+}
+
+Type* IRSerializer::readTypeRef() {
+    uint32_t id = readVarint();
+    if (id == 0) throw IRFormatError("missing type reference");
+    if (id > loadedTypes.size()) throw IRFormatError("type id out of range");
+    return loadedTypes[id - 1];
+}
+
+const std::string& IRSerializer::readStringRef() {
+    uint32_t id = readVarint();
+    if (id >= loadedStrings.size()) throw IRFormatError("string id out of range");
+    return loadedStrings[id];
+}
+
+BasicBlock* IRSerializer::readBlockRef() {
+    uint32_t id = readVarint();
+    if (id == 0) throw IRFormatError("missing block reference");
+    if (id > loadedBlocks.size()) throw IRFormatError("block id out of range");
+    return loadedBlocks[id - 1];
+}
+
+TempVal IRSerializer::readTempVal() {
+    TempVal t;
+    uint8_t mask = readByte();
+    if (mask & TV_VAL) t.setVal(readValueRef());
+    if (mask & TV_TYPE) t.setType(readTypeRef());
+    if (mask & TV_INT) t.setInt(readSVarint());
+    if (mask & TV_FLOAT) t.setFloat(readFloat());
+    if (mask & TV_STRING) t.setString(readStringRef());
+    // isInt()/isFloat() on operands dereference the type
+    if (!t.getType()) throw IRFormatError("untyped operand in IR image");
+    return t;
+}
+
+void IRSerializer::readValues() {
+    // TempVal records can point forward, so objects are created before their fields are read
+    const uint8_t* start = cur;
+    for (Value*& v : loadedValues) {
+        uint8_t kind = readByte();
+        if (kind == VK_TEMP) {
+            v = new TempVal();
+            uint8_t mask = readByte();
+            if (mask & TV_VAL) readVarint();
+            if (mask & TV_TYPE) readVarint();
+            if (mask & TV_INT) readVarint();
+            if (mask & TV_FLOAT) readFloat();
+            if (mask & TV_STRING) readVarint();
+            continue;
+        }
+        if (kind != VK_VAR && kind != VK_CONST) throw IRFormatError("unknown value kind");
+        const std::string& name = readStringRef();
+        int num = readSVarint();
+        Type* type = readTypeRef();
+        uint8_t flags = readByte();
+        if (kind == VK_CONST && !(flags & 2) && !type->isInt() && !type->isFloat()) {
+            throw IRFormatError("constant scalar is neither int nor float");
+        }
+        if (kind == VK_VAR) {
+            v = new VarValue(name, type, flags & 1, num, true);
+        } else {
+            v = new ConstValue(name, type, flags & 1, num);
+        }
+        v->setNum(num);
+        v->setArray(flags & 2);
+        std::vector<int> dims(readCount());
+        for (int& dim : dims) dim = readSVarint();
+        v->setArrayDims(dims);
+        v->setArrayLen(readSVarint());
+        if (kind == VK_VAR) continue;
+        ConstValue* constValue = dynamic_cast<ConstValue*>(v);
+        if (constValue->is_Array()) {
+            for (uint32_t n = readCount(); n > 0; n--) constValue->push(static_cast<int>(readSVarint()));
+            for (uint32_t n = readCount(); n > 0; n--) constValue->push(readFloat());
+        } else if (type->isInt()) {
+            constValue->setInt(readSVarint());
+        } else {
+            constValue->setFloat(readFloat());
+        }
+    }
+    const uint8_t* stop = cur;
+    cur = start;
+    for (Value* v : loadedValues) {
+        uint8_t kind = readByte();
+        if (kind == VK_TEMP) {
+            *dynamic_cast<TempVal*>(v) = readTempVal();
+        } else {
+            // skip, already complete
+            readStringRef();
+            readSVarint();
+            readTypeRef();
+            uint8_t flags = readByte();
+            for (uint32_t n = readVarint(); n > 0; n--) readSVarint();
+            readSVarint();
+            if (kind == VK_CONST) {
+                if (flags & 2) {
+                    for (uint32_t n = readVarint(); n > 0; n--) readSVarint();
+                    for (uint32_t n = readVarint(); n > 0; n--) readFloat();
+                } else if (v->getType()->isInt()) {
+                    readSVarint();
+                } else {
+                    readFloat();
+                }
+            }
+        }
+    }
+    if (cur != stop) throw IRFormatError("corrupted value table");
+}
+
+Instruction* IRSerializer::readInstruction() {
+    Opcode opc = static_cast<Opcode>(readByte());
+    uint8_t irFlags = readByte();
+    bool deleted = irFlags & 1;
+    Instruction* ir = nullptr;
+    irCnt++;
+    switch (opc) {
+        case OPC_MOVE: {
+            Value* dst = readValueRef();
+            Value* src = readValueRef();
+            ir = new MoveIR(dst, src);
+            break;
+        }
+        case OPC_ALLOCI:
+        case OPC_ALLOCF: {
+            Value* v = readValueRef();
+            uint8_t flags = readByte();
+            bool isArray = flags & 1;
+            int arrayLen = readSVarint();
+            AllocIR* allocIr;
+            if (opc == OPC_ALLOCI) {
+                allocIr = isArray ? static_cast<AllocIR*>(new AllocIIR(v, arrayLen)) : new AllocIIR(v);
+            } else {
+                allocIr = isArray ? static_cast<AllocIR*>(new AllocFIR(v, arrayLen)) : new AllocFIR(v);
+            }
+            allocIr->arrayLen = arrayLen;
+            if (flags & 2) {
+                allocIr->zeroBegin = readSVarint();
+                allocIr->zeroEnd = readSVarint();
+            }
+            ir = allocIr;
+            break;
+        }
+        case OPC_LOADI:
+        case OPC_LOADF: {
+            Value* v1 = readValueRef();
+            Value* v2 = readValueRef();
+            ir = opc == OPC_LOADI ? static_cast<Instruction*>(new LoadIIR(v1, v2)) : new LoadFIR(v1, v2);
+            break;
+        }
+        case OPC_STOREI:
+        case OPC_STOREF: {
+            Value* dst = readValueRef();
+            TempVal src = readTempVal();
+            // constant sources are retyped from the pointee of dst
+            if (!src.getVal() && !(dst->getType() && dst->getType()->isPointer())) {
+                throw IRFormatError("store of a constant through a non-pointer");
+            }
+            StoreIR* storeIr = opc == OPC_STOREI ? static_cast<StoreIR*>(new StoreIIR(dst, src)) : new StoreFIR(dst, src);
+            storeIr->src = src;
+            ir = storeIr;
+            break;
+        }
+        case OPC_I2F:
+        case OPC_F2I: {
+            Value* v1 = readValueRef();
+            Value* v2 = readValueRef();
+            ir = opc == OPC_I2F ? static_cast<Instruction*>(new CastInt2FloatIR(v1, v2)) : new CastFloat2IntIR(v1, v2);
+            break;
+        }
+        case OPC_UNARY: {
+            TempVal res = readTempVal();
+            TempVal v = readTempVal();
+            ir = new UnaryIR(res, v, readByte() == 0 ? OP::NEG : OP::NOT);
+            break;
+        }
+        case OPC_BREAK:
+            ir = new BreakIR();
+            break;
+        case OPC_CONTINUE:
+            ir = new ContinueIR();
+            break;
+        case OPC_RETURN: {
+            uint8_t flags = readByte();
+            Value* v = readOptValueRef();
+            ReturnIR* returnIr;
+            if (flags & 1) {
+                returnIr = new ReturnIR(static_cast<int>(readSVarint()));
+            } else if (flags & 2) {
+                returnIr = new ReturnIR(readFloat());
+            } else {
+                returnIr = new ReturnIR(v);
+            }
+            ir = returnIr;
+            break;
+        }
+        case OPC_JUMP:
+            ir = new JumpIR(readBlockRef());
+            break;
+        case OPC_BRANCH: {
+            BasicBlock* trueTarget = readBlockRef();
+            BasicBlock* falseTarget = readBlockRef();
+            ir = new BranchIR(trueTarget, falseTarget, readValueRef());
+            break;
+        }
+        case OPC_GEP: {
+            Value* v1 = readValueRef();
+            Value* v2 = readValueRef();
+            Value* v3 = readOptValueRef();
+            if (v3) {
+                ir = new GEPIR(v1, v2, v3);
+            } else {
+                ir = new GEPIR(v1, v2, static_cast<int>(readSVarint()));
+            }
+            break;
+        }
+        case OPC_CALL: {
+            uint32_t funcId = readVarint();
+            if (funcId >= loadedFuncs.size()) throw IRFormatError("function id out of range");
+            Value* returnVal = readOptValueRef();
+            std::vector<TempVal> args(readCount());
+            for (TempVal& arg : args) arg = readTempVal();
+            ir = returnVal ? new CallIR(loadedFuncs[funcId], args, returnVal) : new CallIR(loadedFuncs[funcId], args);
+            break;
+        }
+        case OPC_PHI: {
+            Value* dst = readValueRef();
+            PhiIR* phiIr = new PhiIR({}, dst);
+            for (uint32_t n = readCount(); n > 0; n--) {
+                BasicBlock* bb = readBlockRef();
+                phiIr->params[bb] = readValueRef();
+            }
+            ir = phiIr;
+            break;
+        }
+        default: {
+            TempVal res = readTempVal();
+            TempVal left = readTempVal();
+            TempVal right = readTempVal();
+            ArithmeticIR* arIr = newArithmetic(opc, res, left, right);
+            if (!arIr) throw IRFormatError("unknown opcode in IR image");
+            // constructors may retype constant operands, keep the stored form exactly
+            arIr->left = left;
+            arIr->right = right;
+            arIr->nonNegative = irFlags & 2;
+            ir = arIr;
+            break;
+        }
+    }
+    if (deleted) ir->deleteIR();
+    return ir;
+}
+
+void IRSerializer::readBlock(BasicBlock* bb) {
+    for (uint32_t n = readCount(); n > 0; n--) bb->pushPre(readBlockRef());
+    for (uint32_t n = readCount(); n > 0; n--) bb->pushSucc(readBlockRef());
+    for (uint32_t n = readCount(); n > 0; n--) bb->pushIr(readInstruction());
+}
+
+uint32_t IRSerializer::read(std::istream& in) {
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    cur = reinterpret_cast<const uint8_t*>(data.data());
+    end = cur + data.size();
+    byteSize = data.size();
+    irCnt = 0;
+
+    if (readVarint() != MAGIC) throw IRFormatError("not a SysY IR image");
+    uint32_t version = readVarint();
+    if (version != VERSION) {
+        throw IRFormatError("unsupported IR image version " + std::to_string(version));
+    }
+    uint32_t flags = readVarint();
+    loadedStrings.assign(readCount(), "");
+    loadedTypes.assign(readCount(), nullptr);
+    loadedValues.assign(readCount(), nullptr);
+    for (std::string& s : loadedStrings) {
+        uint32_t len = readVarint();
+        if (static_cast<size_t>(end - cur) < len) throw IRFormatError("unexpected end of IR image");
+        s.assign(reinterpret_cast<const char*>(cur), len);
+        cur += len;
+    }
+    for (size_t i = 0; i < loadedTypes.size(); ++i) {
+        TypeID tid = static_cast<TypeID>(readVarint());
+        uint32_t contained = readVarint();
+        if (tid > POINTER) throw IRFormatError("unknown type id");
+        if (contained > i) throw IRFormatError("type id out of range");
+        if ((tid == POINTER) != (contained != 0)) throw IRFormatError("malformed pointer type");
+        loadedTypes[i] = contained ? new Type(tid, loadedTypes[contained - 1]) : new Type(tid);
+    }
+    readValues();
+
+    std::vector<Value*> globalVars(readCount());
+    for (Value*& v : globalVars) v = readValueRef();
+    loadedFuncs.assign(readCount(), nullptr);
+    std::vector<std::vector<BasicBlock*>> funcBlocks(loadedFuncs.size());
+    for (size_t i = 0; i < loadedFuncs.size(); ++i) {
+        const std::string& name = readStringRef();
+        Type* returnType = readTypeRef();
+        Function* func = new Function(name, returnType);
+        func->variant_params = readByte() & 1;
+        func->bbCnt = readSVarint();
+        func->varCnt = readSVarint();
+        for (uint32_t n = readCount(); n > 0; n--) func->params.push_back(readValueRef());
+        for (uint32_t n = readCount(); n > 0; n--) func->allocaVars.insert(readValueRef());
+        for (uint32_t n = readCount(); n > 0; n--) func->pushBB(new NormalBlock(readStringRef()));
+        loadedFuncs[i] = func;
+    }
+    for (Function* func : loadedFuncs) {
+        func->renumberBB();
+        loadedBlocks = func->basicBlocks;
+        for (BasicBlock* bb : func->basicBlocks) readBlock(bb);
+    }
+    BasicBlock* entry = new NormalBlock(readStringRef());
+    loadedBlocks = {entry};
+    readBlock(entry);
+    if (cur != end) throw IRFormatError("trailing bytes in IR image");
+
+    irVisitor.globalVars = globalVars;
+    irVisitor.functions = loadedFuncs;
+    irVisitor.entry = entry;
+    cur = end = nullptr;
+    return flags;
+}
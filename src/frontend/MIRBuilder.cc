@@ -126,6 +126,8 @@ void MIRBuilder::getPreAndSucc(){
             functions[i]->basicBlocks.back()->ir.push_back(new ReturnIR(nullptr));
         }
         functions[i]->basicBlocks = refresh(functions[i]->basicBlocks, NULL);
+        resolveTargets(functions[i]);
+        functions[i]->rebuildCFG();
     }
     removeDuplicate();
     //std::cout<<"end pre and succ:"<<std::endl;
@@ -197,10 +199,6 @@ std::vector<BasicBlock*> MIRBuilder::refresh(std::vector<BasicBlock*> bbs, Basic
                 next = nextBB;
             }
             NormalBlock* nb = toNormal(next);
-            if(nb){
-                nb->pushPre(dynamic_cast<NormalBlock*>(bbs[i]));
-                dynamic_cast<NormalBlock*>(bbs[i])->pushSucc(nb);
-            }
 
             //  solve return sentence
             dynamic_cast<NormalBlock*>(bbs[i])->ir.push_back(new JumpIR(nb));
@@ -222,65 +220,40 @@ NormalBlock* MIRBuilder::toNormal(BasicBlock* bb){
     if(bb == NULL){
         return NULL;
     }
-    std::string func_name = bb->name;
-    std::string num = func_name.substr(func_name.find("::BB")+4);
-    func_name = func_name.substr(0, func_name.find(':'));
-
-    NormalBlock* nb = new NormalBlock(nullptr, func_name, atoi(num.c_str()));
-
     if(typeid(*bb) == typeid(NormalBlock)){
         return dynamic_cast<NormalBlock*>(bb);
-    } else{                                         //CondBlock
-        if(getCondToNormal(dynamic_cast<CondBlock*>(bb))){
-            nb = getCondToNormal(dynamic_cast<CondBlock*>(bb));
-        }
-        nb->ir = bb->ir;
-
-        std::vector<NormalBlock*> reversed = reversedSucc[dynamic_cast<CondBlock*>(bb)];
-        if(reversed.size() != 0){         //  check reversed station
-            for(int i = 0; i < reversed.size(); i++){
-                reversed[i]->pushSucc(nb);
-                nb->pushPre(reversed[i]);
-            }
-        }
-
-        putCondToNormal(dynamic_cast<CondBlock*>(bb), nb);
+    }
+    //CondBlock: one NormalBlock per CondBlock, edges are rebuilt from the terminators later
+    CondBlock* cb = dynamic_cast<CondBlock*>(bb);
+    NormalBlock* nb = getCondToNormal(cb);
+    if(!nb){
+        nb = new NormalBlock(cb->name);
+        putCondToNormal(cb, nb);
+    }
+    nb->ir = cb->ir;        // may be called before relatedCond finished the CondBlock, copy again
+    return nb;
+}
 
-        BasicBlock* succ = dynamic_cast<CondBlock*>(bb)->trueBB;            //solve trueBB
-        if(succ){
-            if(typeid(*succ) == typeid(CondBlock)){
-                if(getCondToNormal(dynamic_cast<CondBlock*>(succ))){
-                    succ = getCondToNormal(dynamic_cast<CondBlock*>(succ));
-                    dynamic_cast<NormalBlock*>(succ)->pushPre(nb);
-                    nb->pushSucc(dynamic_cast<NormalBlock*>(succ));
-                } else{
-                    reversedSucc[dynamic_cast<CondBlock*>(succ)].push_back(nb);
-                }
-            } else{
-                dynamic_cast<NormalBlock*>(succ)->pushPre(nb);
-                nb->pushSucc(dynamic_cast<NormalBlock*>(succ));
-            }
+// jumps built by relatedCond still point to CondBlocks, retarget them to the NormalBlocks
+void MIRBuilder::resolveTargets(Function* function){
+    auto resolve = [this](BasicBlock* target) -> BasicBlock* {
+        if(target && typeid(*target) == typeid(CondBlock)){
+            return toNormal(target);
         }
-
-        succ = dynamic_cast<CondBlock*>(bb)->falseBB;                       //solve falseBB
-        if(succ){
-            if(typeid(*succ) == typeid(CondBlock)){
-                if(getCondToNormal(dynamic_cast<CondBlock*>(succ))){
-                    succ = getCondToNormal(dynamic_cast<CondBlock*>(succ));
-                    dynamic_cast<NormalBlock*>(succ)->pushPre(nb);
-                    nb->pushSucc(dynamic_cast<NormalBlock*>(succ));
-                } else{
-                    reversedSucc[dynamic_cast<CondBlock*>(succ)].push_back(nb);
-                }
-            } else{
-                dynamic_cast<NormalBlock*>(succ)->pushPre(nb);
-                nb->pushSucc(dynamic_cast<NormalBlock*>(succ));
+        return target;
+    };
+    for(BasicBlock* bb : function->basicBlocks){
+        for(Instruction* ir : bb->ir){
+            if(typeid(*ir) == typeid(JumpIR)){
+                JumpIR* jumpIr = dynamic_cast<JumpIR*>(ir);
+                jumpIr->target = resolve(jumpIr->target);
+            } else if(typeid(*ir) == typeid(BranchIR)){
+                BranchIR* branchIr = dynamic_cast<BranchIR*>(ir);
+                branchIr->trueTarget = resolve(branchIr->trueTarget);
+                branchIr->falseTarget = resolve(branchIr->falseTarget);
             }
         }
-
-//        std::cout<<nb->name<<std::endl;
     }
-    return nb;
 }
 
 void MIRBuilder::print(std::ostream& out){
@@ -299,30 +272,26 @@ void MIRBuilder::putCondToNormal(CondBlock* cb, NormalBlock* nb){
 
 void MIRBuilder::removeDuplicate(){
     for(size_t i = 0; i < irVisitor.functions.size(); i++){
-        std::vector<BasicBlock*> bbs = irVisitor.functions[i]->basicBlocks;
+        std::vector<BasicBlock*>& bbs = irVisitor.functions[i]->basicBlocks;
         if (bbs.empty()) continue;
-        //std::cout<<bbs.size()<<std::endl;
         for(size_t j = bbs.size() - 1; j > 0 ; j--){
-            NormalBlock* nowNB = dynamic_cast<NormalBlock*>(bbs[j]);
-            if(nowNB->getPre().size() == 1){
-                NormalBlock* preNB = dynamic_cast<NormalBlock*>(*nowNB->getPre().begin());
-                if(preNB->getSucc().size() == 1){
-                    preNB->setSucc(nowNB->getSucc());
-                    preNB->ir.pop_back();
-                    preNB->ir.insert(preNB->ir.end(), nowNB->ir.begin(), nowNB->ir.end());
-                    for (auto succNB:nowNB->getSucc()) {
-                        std::vector<BasicBlock*> preBBs(succNB->getPre());
-                        preBBs.erase(find(preBBs.begin(), preBBs.end(), nowNB));
-                        preBBs.push_back(preNB);
-                        succNB->setPre(preBBs);
-                    }
-                    bbs[j] = preNB;
-                    bbs.erase(bbs.begin()+j);
-                }
+            BasicBlock* nowNB = bbs[j];
+            if(nowNB->getPre().size() != 1) continue;
+            BasicBlock* preNB = nowNB->getPre().front();
+            if(preNB == nowNB || preNB->getSucc().size() != 1 || preNB->ir.empty()) continue;
+            const std::type_info& last = typeid(*preNB->ir.back());
+            if(last != typeid(JumpIR) && last != typeid(BranchIR)) continue;
+            preNB->ir.pop_back();
+            preNB->ir.insert(preNB->ir.end(), nowNB->ir.begin(), nowNB->ir.end());
+            preNB->setSucc(nowNB->getSucc());
+            for (BasicBlock* succNB : nowNB->getSucc()) {
+                std::vector<BasicBlock*>& preBBs = succNB->getPre();
+                *std::find(preBBs.begin(), preBBs.end(), nowNB) = preNB;
             }
+            bbs.erase(bbs.begin()+j);
         }
         for (size_t j = 0;j < bbs.size() - 1;j++) {
-            NormalBlock* nowNB = dynamic_cast<NormalBlock*>(bbs[j]);
+            BasicBlock* nowNB = bbs[j];
             if (nowNB->ir.empty()) continue;
             if (typeid(*(nowNB->ir.back())) == typeid(BranchIR)) {
                 BranchIR* branchIr = dynamic_cast<BranchIR*>(nowNB->ir.back());
@@ -332,12 +301,12 @@ void MIRBuilder::removeDuplicate(){
                 }
             }
             if (typeid(*(nowNB->ir.back())) == typeid(JumpIR)) {
-                if (dynamic_cast<JumpIR*>(nowNB->ir.back())->target->name == bbs[j+1]->name){
+                if (dynamic_cast<JumpIR*>(nowNB->ir.back())->target == bbs[j+1]){
                     nowNB->ir.pop_back();
                 }
             }
         }
-        irVisitor.functions[i]->basicBlocks = bbs;
+        irVisitor.functions[i]->rebuildCFG();
     }
 }
 //end by lin 7.3
\ No newline at end of file
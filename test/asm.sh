@@ -0,0 +1,40 @@
+#!/bin/bash
+# Compiles every program in test/asm at -O2 and checks the assembly against the
+# "// CHECK-NOT: <text>" lines of the source: none of the texts may appear.
+# Needs only the compiler, no ARM toolchain.
+#
+#   test/asm.sh [extra -O2 flags...]
+#
+# COMPILER  the compiler binary            (default: build/compiler)
+
+cd "$(dirname "$0")/.." || exit 1
+COMPILER=${COMPILER:-build/compiler}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+pass=0
+fail=0
+for src in test/asm/*.sy; do
+    name=$(basename "$src" .sy)
+    asm=$TMP/$name.s
+    if ! "$COMPILER" "$src" -o "$asm" -O2 "$@" > /dev/null; then
+        echo "FAIL $name (build)"
+        fail=$((fail + 1))
+        continue
+    fi
+    ok=1
+    while IFS= read -r text; do
+        if grep -qF -- "$text" "$asm"; then
+            echo "FAIL $name: found \"$text\""
+            grep -nF -- "$text" "$asm" | head -n 5
+            ok=0
+        fi
+    done < <(sed -n 's@^// CHECK-NOT: @@p' "$src")
+    if [ $ok = 1 ]; then
+        pass=$((pass + 1))
+    else
+        fail=$((fail + 1))
+    fi
+done
+echo "$pass passed, $fail failed"
+[ $fail -eq 0 ]
@@ -0,0 +1,39 @@
+#!/bin/bash
+# Compiles every program in test/functional at -O0 and -O2 while saving the IR
+# image, compiles the image again with -from-ir-bin and checks that both
+# assembly files are identical. Needs only the compiler, no ARM toolchain.
+#
+#   test/roundtrip.sh [extra -O2 flags...]
+#
+# COMPILER  the compiler binary            (default: build/compiler)
+
+cd "$(dirname "$0")/.." || exit 1
+COMPILER=${COMPILER:-build/compiler}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+pass=0
+fail=0
+for src in test/functional/*.sy; do
+    name=$(basename "$src" .sy)
+    for level in O0 O2; do
+        flags=()
+        [ $level = O2 ] && flags=(-O2 "$@")
+        image=$TMP/$name.$level.bin
+        if ! "$COMPILER" "$src" -o "$TMP/direct.s" -emit-ir-bin "$image" "${flags[@]}" > /dev/null ||
+           ! "$COMPILER" -from-ir-bin "$image" -o "$TMP/reload.s" "${flags[@]}" > /dev/null; then
+            echo "FAIL $name -$level (build)"
+            fail=$((fail + 1))
+            continue
+        fi
+        if cmp -s "$TMP/direct.s" "$TMP/reload.s"; then
+            pass=$((pass + 1))
+        else
+            echo "FAIL $name -$level"
+            diff "$TMP/direct.s" "$TMP/reload.s" | head -n 10
+            fail=$((fail + 1))
+        fi
+    done
+done
+echo "$pass passed, $fail failed"
+[ $fail -eq 0 ]
@@ -0,0 +1,54 @@
+#!/bin/bash
+# Compiles every program in test/functional at -O0 and -O2, runs it and compares
+# stdout followed by the exit code with the .out file next to it.
+#
+#   test/run.sh [extra -O2 flags...]
+#
+# COMPILER  the compiler binary            (default: build/compiler)
+# CC        assembler and linker for ARM   (default: arm-linux-gnueabihf-gcc)
+# RUN       how to start an ARM binary     (default: qemu-arm, empty on an ARM board)
+
+cd "$(dirname "$0")/.." || exit 1
+COMPILER=${COMPILER:-build/compiler}
+CC=${CC:-arm-linux-gnueabihf-gcc}
+RUN=${RUN-qemu-arm}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$CC" -c -O2 -march=armv7-a -mfpu=vfpv4 -mfloat-abi=hard test/sylib.c -o "$TMP/sylib.o" || exit 1
+
+pass=0
+fail=0
+for src in test/functional/*.sy; do
+    name=$(basename "$src" .sy)
+    input=test/functional/$name.in
+    [ -f "$input" ] || input=/dev/null
+    for level in O0 O2; do
+        flags=()
+        [ $level = O2 ] && flags=(-O2 "$@")
+        asm=$TMP/$name.$level.s
+        bin=$TMP/$name.$level
+        if ! "$COMPILER" "$src" -o "$asm" "${flags[@]}" > /dev/null ||
+           ! "$CC" -static -march=armv7-a -mfpu=vfpv4 -mfloat-abi=hard "$asm" "$TMP/sylib.o" -o "$bin"; then
+            echo "FAIL $name -$level (build)"
+            fail=$((fail + 1))
+            continue
+        fi
+        timeout 10 $RUN "$bin" < "$input" > "$TMP/out"
+        ret=$?
+        # same layout as the .out files: output, a newline if it lacks one, then the exit code
+        if [ -s "$TMP/out" ] && [ -n "$(tail -c 1 "$TMP/out")" ]; then
+            echo >> "$TMP/out"
+        fi
+        echo $ret >> "$TMP/out"
+        if cmp -s "$TMP/out" "test/functional/$name.out"; then
+            pass=$((pass + 1))
+        else
+            echo "FAIL $name -$level"
+            diff "$TMP/out" "test/functional/$name.out" | head -n 10
+            fail=$((fail + 1))
+        fi
+    done
+done
+echo "$pass passed, $fail failed"
+[ $fail -eq 0 ]
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "sylib.h"
+
+// input, a missing number reads as 0 and the end of input as -1 for getch
+
+int getint(void) {
+    int t = 0;
+    if (scanf("%d", &t) != 1) return 0;
+    return t;
+}
+
+int getch(void) {
+    return getchar();
+}
+
+float getfloat(void) {
+    float t = 0;
+    if (scanf("%a", &t) != 1) return 0;
+    return t;
+}
+
+int getarray(int a[]) {
+    int n = getint();
+    for (int i = 0; i < n; i++) a[i] = getint();
+    return n;
+}
+
+int getfarray(float a[]) {
+    int n = getint();
+    for (int i = 0; i < n; i++) a[i] = getfloat();
+    return n;
+}
+
+// output
+
+void putint(int a) {
+    printf("%d", a);
+}
+
+void putch(int a) {
+    printf("%c", a);
+}
+
+void putfloat(float a) {
+    printf("%a", a);
+}
+
+void putarray(int n, int a[]) {
+    printf("%d:", n);
+    for (int i = 0; i < n; i++) printf(" %d", a[i]);
+    printf("\n");
+}
+
+void putfarray(int n, float a[]) {
+    printf("%d:", n);
+    for (int i = 0; i < n; i++) printf(" %a", a[i]);
+    printf("\n");
+}
+
+void putf(char a[], ...) {
+    va_list args;
+    va_start(args, a);
+    vfprintf(stdout, a, args);
+    va_end(args);
+}
+
+// timing is not measured, the tests only compare output
+
+void _sysy_starttime(int lineno) {
+    (void) lineno;
+}
+
+void _sysy_stoptime(int lineno) {
+    (void) lineno;
+}
@@ -0,0 +1,31 @@
+#ifndef SYSY_SYLIB_H
+#define SYSY_SYLIB_H
+
+// SysY runtime used when linking the generated assembly for test/run.sh
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int getint(void);
+int getch(void);
+float getfloat(void);
+int getarray(int a[]);
+int getfarray(float a[]);
+void putint(int a);
+void putch(int a);
+void putfloat(float a);
+void putarray(int n, int a[]);
+void putfarray(int n, float a[]);
+void putf(char a[], ...);
+void _sysy_starttime(int lineno);
+void _sysy_stoptime(int lineno);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define starttime() _sysy_starttime(__LINE__)
+#define stoptime() _sysy_stoptime(__LINE__)
+
+#endif